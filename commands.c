@@ -28,6 +28,14 @@ cmd_scrollback_up(struct terminal *term, int rows)
     int view_sb_rel =
         grid_row_abs_to_sb_precalc_sb_start(grid, sb_start, view);
 
+    /* Reflow old scrollback (after a resize) on demand */
+    while (rows > view_sb_rel && grid_reflow_is_pending(grid)) {
+        term_reflow_pending(term, rows - view_sb_rel + term->rows);
+
+        sb_start = grid_sb_start_ignore_uninitialized(grid, term->rows);
+        view_sb_rel = grid_row_abs_to_sb_precalc_sb_start(grid, sb_start, view);
+    }
+
     rows = min(rows, view_sb_rel);
     if (rows == 0)
         return;
@@ -3,66 +3,263 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#define LOG_MODULE "composed"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
 #include "debug.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define MIN_SLOTS 64
+#define MIN_GC_THRESHOLD 4096
+
+static size_t
+slot_for(const struct composed_table *table, uint32_t key)
+{
+    /* Keys are hashes already, but colliding keys are bumped by one;
+     * spread them out, to avoid long probe sequences */
+    return (key * 2654435761u) & (table->size - 1);
+}
+
+static void
+rehash(struct composed_table *table, size_t new_size)
+{
+    xassert(new_size >= MIN_SLOTS);
+    xassert((new_size & (new_size - 1)) == 0);
+    xassert(table->count < new_size);
+
+    struct composed **old_slots = table->slots;
+    const size_t old_size = table->size;
+
+    table->slots = xcalloc(new_size, sizeof(table->slots[0]));
+    table->size = new_size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        struct composed *node = old_slots[i];
+        if (node == NULL)
+            continue;
+
+        size_t idx = slot_for(table, node->key);
+        while (table->slots[idx] != NULL)
+            idx = (idx + 1) & (new_size - 1);
+        table->slots[idx] = node;
+    }
+
+    free(old_slots);
+}
+
+static void
+reset_glyphs(struct composed *node)
+{
+    for (size_t i = 0; i < ALEN(node->grapheme); i++) {
+        atomic_store_explicit(&node->grapheme[i], NULL, memory_order_relaxed);
+        free(atomic_load_explicit(&node->glyphs[i], memory_order_relaxed));
+        atomic_store_explicit(&node->glyphs[i], NULL, memory_order_relaxed);
+    }
+}
+
+static void
+free_node(struct composed *node)
+{
+    reset_glyphs(node);
+    free(node->chars);
+    free(node);
+}
+
+void
+composed_init(struct composed_table *table)
+{
+    *table = (struct composed_table){.gc_threshold = MIN_GC_THRESHOLD};
+}
+
+void
+composed_free(struct composed_table *table)
+{
+    composed_log_statistics(table);
+
+    for (size_t i = 0; i < table->size; i++) {
+        struct composed *node = table->slots[i];
+        if (node == NULL)
+            continue;
+
+        free_node(node);
+    }
+
+    free(table->slots);
+    composed_init(table);
+}
 
 struct composed *
-composed_lookup(struct composed *root, uint32_t key)
+composed_lookup(const struct composed_table *table, uint32_t key)
 {
-    struct composed *node = root;
+    if (table->size == 0)
+        return NULL;
+
+    const size_t mask = table->size - 1;
+
+    for (size_t idx = slot_for(table, key);; idx = (idx + 1) & mask) {
+        struct composed *node = table->slots[idx];
 
-    while (node != NULL) {
-        if (key == node->key)
+        if (node == NULL)
+            return NULL;
+        if (node->key == key)
             return node;
+    }
+}
+
+void
+composed_insert(struct composed_table *table, struct composed *node)
+{
+    xassert(composed_lookup(table, node->key) == NULL);
 
-        node = key < node->key ? node->left : node->right;
+    /* Keep the load factor below 1/2 */
+    if ((table->count + 1) * 2 > table->size)
+        rehash(table, max(table->size * 2, MIN_SLOTS));
+
+    const size_t mask = table->size - 1;
+
+    size_t idx = slot_for(table, node->key);
+    while (table->slots[idx] != NULL)
+        idx = (idx + 1) & mask;
+
+    node->marked = false;
+    for (size_t i = 0; i < ALEN(node->grapheme); i++) {
+        atomic_init(&node->grapheme[i], NULL);
+        atomic_init(&node->glyphs[i], NULL);
     }
 
-    return NULL;
+    table->slots[idx] = node;
+    table->count++;
 }
 
 void
-composed_insert(struct composed **root, struct composed *node)
+composed_reset_glyphs(struct composed_table *table)
 {
-    node->left = node->right = NULL;
-
-    if (*root == NULL) {
-        *root = node;
-        return;
+    for (size_t i = 0; i < table->size; i++) {
+        struct composed *node = table->slots[i];
+        if (node != NULL)
+            reset_glyphs(node);
     }
+}
+
+void
+composed_mark(struct composed_table *table, uint32_t key)
+{
+    struct composed *node = composed_lookup(table, key);
+    if (node != NULL)
+        node->marked = true;
+}
 
-    uint32_t key = node->key;
+size_t
+composed_sweep(struct composed_table *table)
+{
+    size_t freed = 0;
 
-    struct composed *prev = NULL;
-    struct composed *n = *root;
+    for (size_t i = 0; i < table->size; i++) {
+        struct composed *node = table->slots[i];
+        if (node == NULL)
+            continue;
 
-    while (n != NULL) {
-        xassert(n->key != node->key);
+        if (node->marked) {
+            node->marked = false;
+            continue;
+        }
 
-        prev = n;
-        n = key < n->key ? n->left : n->right;
+        free_node(node);
+        table->slots[i] = NULL;
+        freed++;
     }
 
-    xassert(prev != NULL);
-    xassert(n == NULL);
+    xassert(freed <= table->count);
+    table->count -= freed;
 
-    if (key < prev->key) {
-        xassert(prev->left == NULL);
-        prev->left = node;
-    } else {
-        xassert(prev->right == NULL);
-        prev->right = node;
+    /*
+     * Removing entries breaks probe sequences; re-insert everything
+     * that's left, shrinking the table if it's mostly empty.
+     */
+    if (freed > 0) {
+        size_t new_size = max(table->size, MIN_SLOTS);
+        while (new_size > MIN_SLOTS && table->count * 8 < new_size)
+            new_size /= 2;
+        rehash(table, new_size);
     }
+
+    table->gc_threshold = max(table->count * 2, MIN_GC_THRESHOLD);
+    return freed;
 }
 
 void
-composed_free(struct composed *root)
+composed_log_statistics(const struct composed_table *table)
 {
-    if (root == NULL)
+#if defined(_DEBUG)
+    if (table->lookups == 0)
         return;
 
-    composed_free(root->left);
-    composed_free(root->right);
+    LOG_INFO("composed characters: %zu (%zu slots), "
+             "hit rate: %.1f%% (%llu/%llu)",
+             table->count, table->size,
+             100. * table->hits / table->lookups,
+             (unsigned long long)table->hits,
+             (unsigned long long)table->lookups);
+#endif
+}
+
+static struct composed * UNUSED
+new_node(uint32_t key)
+{
+    struct composed *node = xmalloc(sizeof(*node));
+    *node = (struct composed){
+        .chars = xmalloc(2 * sizeof(node->chars[0])),
+        .key = key,
+        .count = 2,
+        .width = 1,
+    };
+    node->chars[0] = U'e';
+    node->chars[1] = 0x301;
+    return node;
+}
+
+UNITTEST
+{
+    struct composed_table table;
+    composed_init(&table);
+
+    xassert(composed_lookup(&table, 0) == NULL);
+
+    /* Consecutive keys, like the ones produced by collisions */
+    for (uint32_t key = 1000; key < 3000; key++)
+        composed_insert(&table, new_node(key));
+
+    xassert(table.count == 2000);
+    xassert(table.size >= 4000);
+
+    for (uint32_t key = 1000; key < 3000; key++) {
+        const struct composed *node = composed_lookup(&table, key);
+        xassert(node != NULL);
+        xassert(node->key == key);
+    }
+
+    xassert(composed_lookup(&table, 999) == NULL);
+    xassert(composed_lookup(&table, 3000) == NULL);
+
+    /* Keep every 4th entry */
+    for (uint32_t key = 1000; key < 3000; key += 4)
+        composed_mark(&table, key);
+
+    xassert(composed_sweep(&table) == 1500);
+    xassert(table.count == 500);
+    xassert(table.size < 4000);
+
+    for (uint32_t key = 1000; key < 3000; key++) {
+        const struct composed *node = composed_lookup(&table, key);
+        xassert((node != NULL) == (key % 4 == 0));
+    }
+
+    /* Nothing marked - everything is freed */
+    xassert(composed_sweep(&table) == 500);
+    xassert(table.count == 0);
+    xassert(composed_lookup(&table, 1000) == NULL);
 
-    free(root->chars);
-    free(root);
+    composed_free(&table);
 }
@@ -1,18 +1,63 @@
 #pragma once
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <uchar.h>
 
+struct fcft_glyph;
+struct fcft_grapheme;
+
 struct composed {
     char32_t *chars;
-    struct composed *left;
-    struct composed *right;
     uint32_t key;
     uint8_t count;
     uint8_t width;
+    bool marked;  /* Garbage collection; see composed_sweep() */
+
+    /*
+     * Render cache, per font (indexed like term->fonts). Filled
+     * lazily by the render threads; must be reset, with
+     * composed_reset_glyphs(), when the fonts change.
+     *
+     * 'grapheme' is the shaped cluster, and 'glyphs' the individual
+     * glyphs for each character in 'chars', used when the cluster
+     * isn't shaped.
+     */
+    _Atomic(const struct fcft_grapheme *) grapheme[4];
+    _Atomic(const struct fcft_glyph **) glyphs[4];
+};
+
+/*
+ * Open addressing (linear probing) hash table, mapping keys (cell
+ * values, minus CELL_COMB_CHARS_LO) to composed characters.
+ *
+ * Entries are never removed individually. Instead, unreferenced
+ * entries are garbage collected: all keys still referenced are marked
+ * with composed_mark(), after which composed_sweep() frees everything
+ * that wasn't marked.
+ */
+struct composed_table {
+    struct composed **slots;
+    size_t size;          /* Number of slots; zero, or a power of two */
+    size_t count;         /* Number of composed characters */
+    size_t gc_threshold;  /* Garbage collect when 'count' reaches this */
+
+    /* Statistics, for interning lookups (i.e. not for rendering) */
+    uint64_t lookups;
+    uint64_t hits;
 };
 
-struct composed *composed_lookup(struct composed *root, uint32_t key);
-void composed_insert(struct composed **root, struct composed *node);
+void composed_init(struct composed_table *table);
+void composed_free(struct composed_table *table);
+
+struct composed *composed_lookup(const struct composed_table *table, uint32_t key);
+void composed_insert(struct composed_table *table, struct composed *node);
+
+void composed_reset_glyphs(struct composed_table *table);
+
+void composed_mark(struct composed_table *table, uint32_t key);
+size_t composed_sweep(struct composed_table *table);
 
-void composed_free(struct composed *root);
+void composed_log_statistics(const struct composed_table *table);
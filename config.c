@@ -22,6 +22,7 @@
 #include "log.h"
 #include "char32.h"
 #include "debug.h"
+#include "default-colors.h"
 #include "input.h"
 #include "key-binding.h"
 #include "macros.h"
@@ -30,62 +31,8 @@
 #include "xmalloc.h"
 #include "xsnprintf.h"
 
-static const uint32_t default_foreground = 0xffffff;
-static const uint32_t default_background = 0x242424;
-
 static const size_t min_csd_border_width = 5;
 
-#define cube6(r, g) \
-    r|g|0x00, r|g|0x5f, r|g|0x87, r|g|0xaf, r|g|0xd7, r|g|0xff
-
-#define cube36(r) \
-    cube6(r, 0x0000), \
-    cube6(r, 0x5f00), \
-    cube6(r, 0x8700), \
-    cube6(r, 0xaf00), \
-    cube6(r, 0xd700), \
-    cube6(r, 0xff00)
-
-static const uint32_t default_color_table[256] = {
-    // Regular
-    0x242424,
-    0xf62b5a,
-    0x47b413,
-    0xe3c401,
-    0x24acd4,
-    0xf2affd,
-    0x13c299,
-    0xe6e6e6,
-
-    // Bright
-    0x616161,
-    0xff4d51,
-    0x35d450,
-    0xe9e836,
-    0x5dc5f8,
-    0xfeabf2,
-    0x24dfc4,
-    0xffffff,
-
-    // 6x6x6 RGB cube
-    // (color channels = i ? i*40+55 : 0, where i = 0..5)
-    cube36(0x000000),
-    cube36(0x5f0000),
-    cube36(0x870000),
-    cube36(0xaf0000),
-    cube36(0xd70000),
-    cube36(0xff0000),
-
-    // 24 shades of gray
-    // (color channels = i*10+8, where i = 0..23)
-    0x080808, 0x121212, 0x1c1c1c, 0x262626,
-    0x303030, 0x3a3a3a, 0x444444, 0x4e4e4e,
-    0x585858, 0x626262, 0x6c6c6c, 0x767676,
-    0x808080, 0x8a8a8a, 0x949494, 0x9e9e9e,
-    0xa8a8a8, 0xb2b2b2, 0xbcbcbc, 0xc6c6c6,
-    0xd0d0d0, 0xdadada, 0xe4e4e4, 0xeeeeee
-};
-
 static const char *const binding_action_map[] = {
     [BIND_ACTION_NONE] = NULL,
     [BIND_ACTION_NOOP] = "noop",
@@ -1167,6 +1114,9 @@ parse_section_scrollback(struct context *ctx)
     else if (streq(key, "multiplier"))
         return value_to_float(ctx, &conf->scrollback.multiplier);
 
+    else if (streq(key, "spill"))
+        return value_to_bool(ctx, &conf->scrollback.spill);
+
     else {
         LOG_CONTEXTUAL_ERR("not a valid option: %s", key);
         return false;
@@ -2599,6 +2549,20 @@ parse_section_tweak(struct context *ctx)
         return true;
     }
 
+    else if (streq(key, "pty-parse-budget")) {
+        uint32_t ns;
+        if (!value_to_uint32(ctx, 10, &ns))
+            return false;
+
+        if (ns > 16666666) {
+            LOG_CONTEXTUAL_ERR("budget must not exceed 16666666ns");
+            return false;
+        }
+
+        conf->tweak.pty_parse_budget_ns = ns;
+        return true;
+    }
+
     else if (streq(key, "max-shm-pool-size-mb")) {
         uint32_t mb;
         if (!value_to_uint32(ctx, 10, &mb))
@@ -2620,6 +2584,24 @@ parse_section_tweak(struct context *ctx)
     else if (streq(key, "sixel"))
         return value_to_bool(ctx, &conf->tweak.sixel);
 
+    else if (streq(key, "pty-reader-thread"))
+        return value_to_bool(ctx, &conf->tweak.pty_reader_thread);
+
+    else if (streq(key, "scrollback-compress-after"))
+        return value_to_uint32(ctx, 10, &conf->tweak.scrollback_compress_after);
+
+    else if (streq(key, "pty-record")) {
+        if (!value_to_str(ctx, &conf->tweak.pty_record))
+            return false;
+
+        if (conf->tweak.pty_record[0] == '\0') {
+            free(conf->tweak.pty_record);
+            conf->tweak.pty_record = NULL;
+        }
+
+        return true;
+    }
+
     else if (streq(key, "bold-text-in-bright-amount"))
         return value_to_float(ctx, &conf->bold_in_bright.amount);
 
@@ -3141,6 +3123,7 @@ config_load(struct config *conf, const char *conf_path,
                 .text = xc32dup(U""),
             },
             .multiplier = 3.,
+            .spill = false,
         },
         .colors = {
             .fg = default_foreground,
@@ -3215,6 +3198,7 @@ config_load(struct config *conf, const char *conf_path,
             .grapheme_width_method = GRAPHEME_WIDTH_DOUBLE,
             .delayed_render_lower_ns = 500000,         /* 0.5ms */
             .delayed_render_upper_ns = 16666666 / 2,   /* half a frame period (60Hz) */
+            .pty_parse_budget_ns = 0,                  /* adaptive */
             .max_shm_pool_size = 512 * 1024 * 1024,
             .render_timer = RENDER_TIMER_NONE,
             .damage_whole_window = false,
@@ -3222,6 +3206,9 @@ config_load(struct config *conf, const char *conf_path,
             .box_drawing_solid_shades = true,
             .font_monospace_warn = true,
             .sixel = true,
+            .pty_reader_thread = false,
+            .scrollback_compress_after = 10,
+            .pty_record = NULL,
         },
 
         .touch = {
@@ -3538,6 +3525,8 @@ config_clone(const struct config *old)
 
     conf->utmp_helper_path =
         old->utmp_helper_path != NULL ? xstrdup(old->utmp_helper_path) : NULL;
+    conf->tweak.pty_record =
+        old->tweak.pty_record != NULL ? xstrdup(old->tweak.pty_record) : NULL;
 
     conf->notifications.length = 0;
     conf->notifications.head = conf->notifications.tail = 0;
@@ -3613,6 +3602,7 @@ config_free(struct config *conf)
     }
 
     free(conf->utmp_helper_path);
+    free(conf->tweak.pty_record);
     user_notifications_free(&conf->notifications);
 }
 
@@ -197,6 +197,7 @@ struct config {
             char32_t *text;
         } indicator;
         float multiplier;
+        bool spill;
     } scrollback;
 
     struct {
@@ -367,11 +368,15 @@ struct config {
         bool damage_whole_window;
         uint32_t delayed_render_lower_ns;
         uint32_t delayed_render_upper_ns;
+        uint32_t pty_parse_budget_ns;  /* 0 = adaptive */
         off_t max_shm_pool_size;
         float box_drawing_base_thickness;
         bool box_drawing_solid_shades;
         bool font_monospace_warn;
         bool sixel;
+        bool pty_reader_thread;
+        uint32_t scrollback_compress_after;  /* Screens; 0 = disabled */
+        char *pty_record;  /* Path prefix, NULL = disabled */
     } tweak;
 
     struct {
@@ -536,10 +536,6 @@ decset_decrst(struct terminal *term, unsigned param, bool enable)
             tll_free(term->alt.scroll_damage);
             term_damage_view(term);
         }
-
-        term->bits_affecting_ascii_printer.sixels =
-            tll_length(term->grid->sixel_images) > 0;
-        term_update_ascii_printer(term);
         break;
 
     case 1070:
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * foot's default colors. Used by config.c, and by the benchmark,
+ * which renders without loading a configuration.
+ */
+
+static const uint32_t default_foreground = 0xffffff;
+static const uint32_t default_background = 0x242424;
+
+#define cube6(r, g) \
+    r|g|0x00, r|g|0x5f, r|g|0x87, r|g|0xaf, r|g|0xd7, r|g|0xff
+
+#define cube36(r) \
+    cube6(r, 0x0000), \
+    cube6(r, 0x5f00), \
+    cube6(r, 0x8700), \
+    cube6(r, 0xaf00), \
+    cube6(r, 0xd700), \
+    cube6(r, 0xff00)
+
+static const uint32_t default_color_table[256] = {
+    // Regular
+    0x242424,
+    0xf62b5a,
+    0x47b413,
+    0xe3c401,
+    0x24acd4,
+    0xf2affd,
+    0x13c299,
+    0xe6e6e6,
+
+    // Bright
+    0x616161,
+    0xff4d51,
+    0x35d450,
+    0xe9e836,
+    0x5dc5f8,
+    0xfeabf2,
+    0x24dfc4,
+    0xffffff,
+
+    // 6x6x6 RGB cube
+    // (color channels = i ? i*40+55 : 0, where i = 0..5)
+    cube36(0x000000),
+    cube36(0x5f0000),
+    cube36(0x870000),
+    cube36(0xaf0000),
+    cube36(0xd70000),
+    cube36(0xff0000),
+
+    // 24 shades of gray
+    // (color channels = i*10+8, where i = 0..23)
+    0x080808, 0x121212, 0x1c1c1c, 0x262626,
+    0x303030, 0x3a3a3a, 0x444444, 0x4e4e4e,
+    0x585858, 0x626262, 0x6c6c6c, 0x767676,
+    0x808080, 0x8a8a8a, 0x949494, 0x9e9e9e,
+    0xa8a8a8, 0xb2b2b2, 0xbcbcbc, 0xc6c6c6,
+    0xd0d0d0, 0xdadada, 0xe4e4e4, 0xeeeeee
+};
+
+#undef cube36
+#undef cube6
@@ -5,6 +5,9 @@
 #define LOG_ENABLE_DBG 0
 #include "log.h"
 #include "char32.h"
+#include "grid.h"
+#include "scrollback-spill.h"
+#include "xmalloc.h"
 
 struct extraction_context {
     char32_t *buf;
@@ -155,6 +158,14 @@ out:
 bool
 extract_one(const struct terminal *term, const struct row *row,
             const struct cell *cell, int col, void *context)
+{
+    return extract_one_composed(term, row, cell, col, NULL, context);
+}
+
+bool
+extract_one_composed(const struct terminal *term, const struct row *row,
+                     const struct cell *cell, int col,
+                     const struct composed *composed, void *context)
 {
     struct extraction_context *ctx = context;
 
@@ -232,8 +243,10 @@ extract_one(const struct terminal *term, const struct row *row,
 
     if (cell->wc >= CELL_COMB_CHARS_LO && cell->wc <= CELL_COMB_CHARS_HI)
     {
-        const struct composed *composed = composed_lookup(
-            term->composed, cell->wc - CELL_COMB_CHARS_LO);
+        if (composed == NULL) {
+            composed = composed_lookup(
+                &term->composed, cell->wc - CELL_COMB_CHARS_LO);
+        }
 
         if (!ensure_size(ctx, composed->count))
             goto err;
@@ -269,3 +282,63 @@ err:
     ctx->failed = true;
     return false;
 }
+
+UNITTEST
+{
+    /*
+     * Composed characters only referenced by spilled rows are garbage
+     * collected; extracting the spilled rows must still work
+     */
+    struct terminal term = {.rows = 2, .cols = 4};
+    term.normal = (struct grid){
+        .num_rows = 4,
+        .num_cols = term.cols,
+        .rows = xcalloc(4, sizeof(term.normal.rows[0])),
+    };
+    term.grid = &term.normal;
+
+    for (int r = 0; r < term.rows; r++)
+        term.normal.rows[r] = grid_row_alloc(term.cols, true);
+
+    composed_init(&term.composed);
+
+    struct composed *node = xmalloc(sizeof(*node));
+    *node = (struct composed){
+        .chars = xmalloc(2 * sizeof(node->chars[0])),
+        .key = 0x42,
+        .count = 2,
+        .width = 1,
+    };
+    node->chars[0] = U'e';
+    node->chars[1] = 0x301;
+    composed_insert(&term.composed, node);
+
+    term.scrollback_spill = scrollback_spill_init(&term.composed);
+    if (term.scrollback_spill == NULL)
+        goto out;
+
+    struct row *row = grid_row_alloc(term.cols, true);
+    row->cells[0].wc = CELL_COMB_CHARS_LO + 0x42;
+    row->linebreak = true;
+    scrollback_spill_row(term.scrollback_spill, row, term.cols);
+    grid_row_free(row);
+
+    term_composed_gc(&term);
+    xassert(composed_lookup(&term.composed, 0x42) == NULL);
+
+    char *text;
+    size_t len;
+    xassert(term_scrollback_to_text(&term, &text, &len));
+    xassert(len >= 3);
+    xassert(memcmp(text, "e\xcc\x81", 3) == 0);
+    free(text);
+
+    scrollback_spill_destroy(term.scrollback_spill);
+
+out:
+    composed_free(&term.composed);
+
+    for (int r = 0; r < term.rows; r++)
+        grid_row_free(term.normal.rows[r]);
+    free(term.normal.rows);
+}
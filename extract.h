@@ -15,6 +15,16 @@ bool extract_one(
     const struct terminal *term, const struct row *row, const struct cell *cell,
     int col, void *context);
 
+/*
+ * Like extract_one(), but for cells outside the terminal's grid
+ * (e.g. spilled scrollback), whose composed characters aren't in the
+ * terminal's composed table. 'composed' is the cell's composed
+ * character; when NULL, it's looked up in the terminal's table.
+ */
+bool extract_one_composed(
+    const struct terminal *term, const struct row *row, const struct cell *cell,
+    int col, const struct composed *composed, void *context);
+
 bool extract_finish(
     struct extraction_context *context, char **text, size_t *len);
 bool extract_finish_wide(
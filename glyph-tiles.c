@@ -0,0 +1,442 @@
+#include "glyph-tiles.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+ #include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+#define LOG_MODULE "glyph-tiles"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "debug.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define SLOT_COUNT 2048
+#define MAX_TILES (SLOT_COUNT / 2)
+
+struct glyph_tile {
+    const struct fcft_glyph *glyph;
+    uint32_t fg;
+    uint32_t bg;
+    uint32_t pixels[];  /* cell_width * cell_height */
+};
+
+struct glyph_tile_cache {
+    int width;
+    int height;
+    atomic_size_t count;
+    _Atomic(struct glyph_tile *) slots[SLOT_COUNT];
+};
+
+struct glyph_tile_cache *
+glyph_tiles_init(void)
+{
+    struct glyph_tile_cache *cache = xmalloc(sizeof(*cache));
+    cache->width = cache->height = 0;
+    atomic_init(&cache->count, 0);
+
+    for (size_t i = 0; i < SLOT_COUNT; i++)
+        atomic_init(&cache->slots[i], NULL);
+
+    return cache;
+}
+
+void
+glyph_tiles_destroy(struct glyph_tile_cache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    glyph_tiles_reset(cache);
+    free(cache);
+}
+
+void
+glyph_tiles_reset(struct glyph_tile_cache *cache)
+{
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        free(atomic_load_explicit(&cache->slots[i], memory_order_relaxed));
+        atomic_store_explicit(&cache->slots[i], NULL, memory_order_relaxed);
+    }
+
+    atomic_store(&cache->count, 0);
+
+    /* Disabled until the next glyph_tiles_frame_begin() */
+    cache->width = cache->height = 0;
+}
+
+void
+glyph_tiles_frame_begin(
+    struct glyph_tile_cache *cache, int cell_width, int cell_height)
+{
+    if (cache->width != cell_width || cache->height != cell_height ||
+        atomic_load(&cache->count) >= MAX_TILES)
+    {
+        LOG_DBG("resetting: cell size changed, or cache full");
+        glyph_tiles_reset(cache);
+        cache->width = cell_width;
+        cache->height = cell_height;
+    }
+}
+
+/* x * y / 255, rounded; same as pixman's MUL_UN8() */
+static inline uint8_t
+mul_un8(uint8_t x, uint8_t y)
+{
+    const uint16_t t = x * y + 0x80;
+    return (t + (t >> 8)) >> 8;
+}
+
+/*
+ * Blends 'fg' onto 'bg', with coverage from an a8 mask, for 'count'
+ * pixels: dst = fg * mask + bg * (1 - mask). Both colors are opaque,
+ * which makes this equivalent to a PIXMAN_OP_OVER composite, of a
+ * solid fill through the mask, onto a background filled pixel.
+ */
+static void
+blend_row(uint32_t *dst, const uint8_t *mask, int count,
+          uint32_t fg, uint32_t bg)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    {
+        const __m256i fg16 = _mm256_cvtepu8_epi16(_mm_set1_epi32(fg));
+        const __m256i bg16 = _mm256_cvtepu8_epi16(_mm_set1_epi32(bg));
+        const __m256i c255 = _mm256_set1_epi16(0xff);
+        const __m256i c80 = _mm256_set1_epi16(0x80);
+
+        for (; i + 8 <= count; i += 8) {
+            __m128i m = _mm_loadl_epi64((const __m128i *)&mask[i]);
+            m = _mm_unpacklo_epi8(m, m);
+
+            /* Each mask byte, repeated for all four channels */
+            __m256i res[2];
+            for (size_t j = 0; j < 2; j++) {
+                const __m256i m16 = _mm256_cvtepu8_epi16(
+                    j == 0 ? _mm_unpacklo_epi16(m, m) : _mm_unpackhi_epi16(m, m));
+
+                __m256i a = _mm256_add_epi16(_mm256_mullo_epi16(fg16, m16), c80);
+                __m256i b = _mm256_add_epi16(
+                    _mm256_mullo_epi16(bg16, _mm256_sub_epi16(c255, m16)), c80);
+
+                a = _mm256_srli_epi16(_mm256_add_epi16(a, _mm256_srli_epi16(a, 8)), 8);
+                b = _mm256_srli_epi16(_mm256_add_epi16(b, _mm256_srli_epi16(b, 8)), 8);
+                res[j] = _mm256_add_epi16(a, b);
+            }
+
+            /* Packing works on 128-bit lanes; restore pixel order */
+            const __m256i packed = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(res[0], res[1]), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i *)&dst[i], packed);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i fg16 = _mm_unpacklo_epi8(_mm_set1_epi32(fg), zero);
+        const __m128i bg16 = _mm_unpacklo_epi8(_mm_set1_epi32(bg), zero);
+        const __m128i c255 = _mm_set1_epi16(0xff);
+        const __m128i c80 = _mm_set1_epi16(0x80);
+
+        for (; i + 4 <= count; i += 4) {
+            uint32_t m4;
+            memcpy(&m4, &mask[i], sizeof(m4));
+
+            /* Each mask byte, repeated for all four channels */
+            __m128i m = _mm_cvtsi32_si128(m4);
+            m = _mm_unpacklo_epi8(m, m);
+            m = _mm_unpacklo_epi16(m, m);
+
+            __m128i res[2];
+            for (size_t j = 0; j < 2; j++) {
+                const __m128i m16 = j == 0
+                    ? _mm_unpacklo_epi8(m, zero) : _mm_unpackhi_epi8(m, zero);
+
+                __m128i a = _mm_add_epi16(_mm_mullo_epi16(fg16, m16), c80);
+                __m128i b = _mm_add_epi16(
+                    _mm_mullo_epi16(bg16, _mm_sub_epi16(c255, m16)), c80);
+
+                a = _mm_srli_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 8)), 8);
+                b = _mm_srli_epi16(_mm_add_epi16(b, _mm_srli_epi16(b, 8)), 8);
+                res[j] = _mm_add_epi16(a, b);
+            }
+
+            _mm_storeu_si128(
+                (__m128i *)&dst[i], _mm_packus_epi16(res[0], res[1]));
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    {
+        static const uint8_t expand[16] = {
+            0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+        };
+
+        const uint8x16_t idx = vld1q_u8(expand);
+        const uint8x16_t fg8 = vreinterpretq_u8_u32(vdupq_n_u32(fg));
+        const uint8x16_t bg8 = vreinterpretq_u8_u32(vdupq_n_u32(bg));
+
+        for (; i + 4 <= count; i += 4) {
+            uint32_t m4;
+            memcpy(&m4, &mask[i], sizeof(m4));
+
+            /* Each mask byte, repeated for all four channels */
+            const uint8x16_t m = vqtbl1q_u8(
+                vreinterpretq_u8_u32(vdupq_n_u32(m4)), idx);
+            const uint8x16_t inv = vmvnq_u8(m);
+
+            /* x * y / 255, rounded; (t + ((t + 0x80) >> 8) + 0x80) >> 8 */
+            const uint16x8_t a_lo = vmull_u8(vget_low_u8(fg8), vget_low_u8(m));
+            const uint16x8_t a_hi = vmull_u8(vget_high_u8(fg8), vget_high_u8(m));
+            const uint16x8_t b_lo = vmull_u8(vget_low_u8(bg8), vget_low_u8(inv));
+            const uint16x8_t b_hi = vmull_u8(vget_high_u8(bg8), vget_high_u8(inv));
+
+            const uint8x16_t a = vcombine_u8(
+                vraddhn_u16(a_lo, vrshrq_n_u16(a_lo, 8)),
+                vraddhn_u16(a_hi, vrshrq_n_u16(a_hi, 8)));
+            const uint8x16_t b = vcombine_u8(
+                vraddhn_u16(b_lo, vrshrq_n_u16(b_lo, 8)),
+                vraddhn_u16(b_hi, vrshrq_n_u16(b_hi, 8)));
+
+            vst1q_u8((uint8_t *)&dst[i], vaddq_u8(a, b));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        const uint8_t m = mask[i];
+        uint32_t pixel = 0;
+
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint8_t c =
+                mul_un8(fg >> shift, m) + mul_un8(bg >> shift, 255 - m);
+            pixel |= (uint32_t)c << shift;
+        }
+
+        dst[i] = pixel;
+    }
+}
+
+/* Renders a cell into 'dst', whose stride is in pixels */
+static void
+render_tile(uint32_t *dst, int stride, int width, int height,
+            const struct fcft_glyph *glyph, int glyph_x, int glyph_y,
+            uint32_t fg, uint32_t bg)
+{
+    const uint8_t *mask = (const uint8_t *)pixman_image_get_data(glyph->pix);
+    const int mask_stride = pixman_image_get_stride(glyph->pix);
+
+    /* Part of the tile covered by the glyph */
+    const int x0 = max(glyph_x, 0);
+    const int x1 = min(glyph_x + glyph->width, width);
+
+    for (int y = 0; y < height; y++) {
+        uint32_t *row = &dst[y * stride];
+        const int mask_y = y - glyph_y;
+
+        if (mask_y < 0 || mask_y >= glyph->height || x0 >= x1) {
+            for (int x = 0; x < width; x++)
+                row[x] = bg;
+            continue;
+        }
+
+        for (int x = 0; x < x0; x++)
+            row[x] = bg;
+
+        blend_row(&row[x0], &mask[mask_y * mask_stride + x0 - glyph_x],
+                  x1 - x0, fg, bg);
+
+        for (int x = x1; x < width; x++)
+            row[x] = bg;
+    }
+}
+
+static size_t
+slot_for(const struct fcft_glyph *glyph, uint32_t fg, uint32_t bg)
+{
+    uint64_t h = (uintptr_t)glyph;
+    h ^= (uint64_t)fg * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t)bg * 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 29;
+    return h & (SLOT_COUNT - 1);
+}
+
+bool
+glyph_tiles_render(
+    struct glyph_tile_cache *cache, pixman_image_t *dst, int x, int y,
+    const struct fcft_glyph *glyph, int glyph_x, int glyph_y,
+    uint32_t fg, uint32_t bg)
+{
+    const int width = cache->width;
+    const int height = cache->height;
+
+    if (width == 0 || pixman_image_get_format(glyph->pix) != PIXMAN_a8)
+        return false;
+
+    xassert(pixman_image_get_format(dst) == PIXMAN_a8r8g8b8 ||
+            pixman_image_get_format(dst) == PIXMAN_x8r8g8b8);
+    xassert(fg >> 24 == 0xff);
+    xassert(bg >> 24 == 0xff);
+
+    if (x < 0 || y < 0 ||
+        x + width > pixman_image_get_width(dst) ||
+        y + height > pixman_image_get_height(dst))
+    {
+        return false;
+    }
+
+    const int stride = pixman_image_get_stride(dst) / sizeof(uint32_t);
+    uint32_t *cell = &pixman_image_get_data(dst)[y * stride + x];
+
+    /*
+     * Lookup. Tiles are never removed while rendering, so we can stop
+     * at the first empty slot.
+     */
+    size_t idx = slot_for(glyph, fg, bg);
+    struct glyph_tile *tile = NULL;
+
+    for (size_t probes = 0; probes < SLOT_COUNT; probes++) {
+        struct glyph_tile *t = atomic_load_explicit(
+            &cache->slots[idx], memory_order_acquire);
+
+        if (t == NULL) {
+            if (atomic_load_explicit(&cache->count, memory_order_relaxed) >= MAX_TILES)
+                break;
+
+            /* Miss; render a new tile, and try to insert it */
+            if (tile == NULL) {
+                tile = xmalloc(
+                    sizeof(*tile) + width * height * sizeof(tile->pixels[0]));
+                tile->glyph = glyph;
+                tile->fg = fg;
+                tile->bg = bg;
+                render_tile(tile->pixels, width, width, height,
+                            glyph, glyph_x, glyph_y, fg, bg);
+            }
+
+            struct glyph_tile *expected = NULL;
+            if (atomic_compare_exchange_strong_explicit(
+                    &cache->slots[idx], &expected, tile,
+                    memory_order_release, memory_order_acquire))
+            {
+                atomic_fetch_add_explicit(&cache->count, 1, memory_order_relaxed);
+                t = tile;
+                tile = NULL;
+            } else {
+                /* Another thread got here first; check its tile */
+                t = expected;
+            }
+        }
+
+        if (t->glyph == glyph && t->fg == fg && t->bg == bg) {
+            for (int r = 0; r < height; r++) {
+                memcpy(&cell[r * stride], &t->pixels[r * width],
+                       width * sizeof(t->pixels[0]));
+            }
+
+            free(tile);
+            return true;
+        }
+
+        idx = (idx + 1) & (SLOT_COUNT - 1);
+    }
+
+    /* Cache is full */
+    if (tile != NULL) {
+        for (int r = 0; r < height; r++) {
+            memcpy(&cell[r * stride], &tile->pixels[r * width],
+                   width * sizeof(tile->pixels[0]));
+        }
+        free(tile);
+    } else {
+        render_tile(cell, stride, width, height, glyph, glyph_x, glyph_y, fg, bg);
+    }
+
+    return true;
+}
+
+UNITTEST
+{
+    /* SIMD kernels vs. the scalar reference, for all mask values */
+    uint8_t mask[256 + 3];
+    for (size_t i = 0; i < ALEN(mask); i++)
+        mask[i] = i;
+
+    const uint32_t fg = 0xff20c0f0;
+    const uint32_t bg = 0xff804001;
+
+    uint32_t pixels[ALEN(mask)];
+    blend_row(pixels, mask, ALEN(mask), fg, bg);
+
+    for (size_t i = 0; i < ALEN(mask); i++) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint8_t m = mask[i];
+            const uint8_t expected =
+                mul_un8(fg >> shift, m) + mul_un8(bg >> shift, 255 - m);
+            xassert(((pixels[i] >> shift) & 0xff) == expected);
+        }
+    }
+
+    /* Full coverage is fg, no coverage is bg */
+    xassert(pixels[0] == bg);
+    xassert(pixels[255] == fg);
+}
+
+UNITTEST
+{
+    struct glyph_tile_cache *cache = glyph_tiles_init();
+    glyph_tiles_frame_begin(cache, 8, 16);
+
+    /* 10x4 glyph; hangs over the cell's left and right edges */
+    uint32_t mask_data[4 * 3] = {0};
+    memset(mask_data, 0xff, sizeof(mask_data));
+    pixman_image_t *mask = pixman_image_create_bits_no_clear(
+        PIXMAN_a8, 10, 4, mask_data, 12);
+
+    const struct fcft_glyph glyph = {
+        .pix = mask,
+        .width = 10,
+        .height = 4,
+        .cols = 1,
+    };
+
+    uint32_t dst_data[16 * 32] = {0};
+    pixman_image_t *dst = pixman_image_create_bits_no_clear(
+        PIXMAN_x8r8g8b8, 16, 32, dst_data, 16 * sizeof(uint32_t));
+
+    for (int i = 0; i < 2; i++) {
+        xassert(glyph_tiles_render(
+                    cache, dst, 8, 16, &glyph, -1, 10, 0xffffffff, 0xff000000));
+        xassert(atomic_load(&cache->count) == 1);
+
+        for (int y = 0; y < 32; y++) {
+            for (int x = 0; x < 16; x++) {
+                uint32_t expected = 0;
+                if (x >= 8 && y >= 16)
+                    expected = (y >= 26 && y < 30) ? 0xffffffff : 0xff000000;
+                xassert(dst_data[y * 16 + x] == expected);
+            }
+        }
+    }
+
+    /* Doesn't fit */
+    xassert(!glyph_tiles_render(
+                cache, dst, 9, 16, &glyph, 0, 0, 0xffffffff, 0xff000000));
+
+    /* Cell size change drops all tiles */
+    glyph_tiles_frame_begin(cache, 8, 15);
+    xassert(atomic_load(&cache->count) == 0);
+
+    pixman_image_unref(dst);
+    pixman_image_unref(mask);
+    glyph_tiles_destroy(cache);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pixman.h>
+#include <fcft/fcft.h>
+
+/*
+ * Cache of fully rendered cells: an opaque background, with an a8
+ * (grayscale antialiased) glyph blended on top, in a solid
+ * foreground color.
+ *
+ * Tiles are keyed on (glyph, fg, bg). Glyph pointers are only valid as
+ * long as the fonts they came from, and the glyph's position in the
+ * tile depends on the font metrics; the cache *must* be reset whenever
+ * the fonts change.
+ *
+ * Lookups and insertions are lock free, and safe to do from multiple
+ * render threads at the same time. Everything else must only be done
+ * from the main thread, while no rendering is in progress.
+ */
+struct glyph_tile_cache;
+
+struct glyph_tile_cache *glyph_tiles_init(void);
+void glyph_tiles_destroy(struct glyph_tile_cache *cache);
+
+/* Discards all tiles */
+void glyph_tiles_reset(struct glyph_tile_cache *cache);
+
+/*
+ * Must be called before each frame. Discards all tiles if the cell
+ * size has changed, or if the cache is full.
+ */
+void glyph_tiles_frame_begin(
+    struct glyph_tile_cache *cache, int cell_width, int cell_height);
+
+/*
+ * Renders a cell at x,y in 'dst' (which must be an 8-bit per channel
+ * ARGB32 image). 'glyph_x' and 'glyph_y' is the glyph's position,
+ * relative to the cell's top left corner. Colors are a8r8g8b8, and
+ * must be opaque.
+ *
+ * Returns false, without rendering anything, if the cell can't be
+ * rendered from a tile (e.g. the glyph isn't an a8 mask).
+ */
+bool glyph_tiles_render(
+    struct glyph_tile_cache *cache, pixman_image_t *dst, int x, int y,
+    const struct fcft_glyph *glyph, int glyph_x, int glyph_y,
+    uint32_t fg, uint32_t bg);
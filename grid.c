@@ -9,6 +9,7 @@
 #include "log.h"
 #include "debug.h"
 #include "macros.h"
+#include "scrollback-spill.h"
 #include "sixel.h"
 #include "stride.h"
 #include "util.h"
@@ -16,6 +17,13 @@
 
 #define TIME_REFLOW 0
 
+/* Compressed cells; see grid_row_pack() */
+struct row_packed {
+    uint32_t cols;
+    uint32_t size;
+    uint8_t data[];
+};
+
 /*
  * "sb" (scrollback relative) coordinates
  *
@@ -279,6 +287,8 @@ grid_snapshot(const struct grid *grid)
     clone->rows = xcalloc(grid->num_rows, sizeof(clone->rows[0]));
     memset(&clone->scroll_damage, 0, sizeof(clone->scroll_damage));
     memset(&clone->sixel_images, 0, sizeof(clone->sixel_images));
+    clone->sixel_rows = NULL;
+    memset(&clone->reflow_pending, 0, sizeof(clone->reflow_pending));
 
     tll_foreach(grid->scroll_damage, it)
         tll_push_back(clone->scroll_damage, it->item);
@@ -292,13 +302,22 @@ grid_snapshot(const struct grid *grid)
         struct row *clone_row = xmalloc(sizeof(*row));
         clone->rows[r] = clone_row;
 
-        clone_row->cells = xmalloc(grid->num_cols * sizeof(clone_row->cells[0]));
         clone_row->linebreak = row->linebreak;
         clone_row->dirty = row->dirty;
+        clone_row->all_dirty = row->all_dirty;
         clone_row->shell_integration = row->shell_integration;
 
-        for (int c = 0; c < grid->num_cols; c++)
-            clone_row->cells[c] = row->cells[c];
+        if (row->packed != NULL) {
+            clone_row->cells = NULL;
+            clone_row->packed = xmemdup(
+                row->packed, sizeof(*row->packed) + row->packed->size);
+        } else {
+            clone_row->cells = xmalloc(grid->num_cols * sizeof(clone_row->cells[0]));
+            clone_row->packed = NULL;
+
+            for (int c = 0; c < grid->num_cols; c++)
+                clone_row->cells[c] = row->cells[c];
+        }
 
         const struct row_data *extra = row->extra;
 
@@ -409,6 +428,9 @@ grid_free(struct grid *grid)
         tll_remove(grid->sixel_images, it);
     }
 
+    grid_sixel_rows_invalidate(grid);
+    grid_reflow_pending_discard(grid, NULL);
+
     free(grid->rows);
     tll_free(grid->scroll_damage);
 }
@@ -429,23 +451,138 @@ grid_swap_row(struct grid *grid, int row_a, int row_b)
     grid->rows[real_b] = a;
 }
 
+/*
+ * Recycled cell arrays
+ *
+ * Packing, and unpacking, cold scrollback rows frees, and allocates,
+ * one cell array per row. With a full scrollback, that happens for
+ * every new line of output. A grid's arrays are all the same size (the
+ * grid width), so we keep a bunch of them around, instead of going
+ * through malloc() each time.
+ *
+ * Arrays are cached per width, for a handful of widths; in server
+ * mode, windows of different widths share the cache. When a new width
+ * is needed, the least recently used width is dropped.
+ *
+ * Not thread safe. Rows are only allocated, packed and unpacked by
+ * the main thread (render threads only ever see unpacked rows).
+ */
+#define CELL_CACHE_WIDTHS 8
+#define CELL_CACHE_SIZE 32   /* Arrays, per width */
+
+struct cell_cache_bucket {
+    int cols;
+    size_t count;
+    uint64_t last_used;
+    struct cell *arrays[CELL_CACHE_SIZE];
+};
+
+static struct {
+    struct cell_cache_bucket buckets[CELL_CACHE_WIDTHS];
+    uint64_t clock;
+
+    /* Scratch buffer for packing rows; see pack_buf_reserve() */
+    uint8_t *pack_buf;
+    size_t pack_buf_size;
+} cell_cache;
+
+static struct cell_cache_bucket *
+cell_cache_lookup(int cols)
+{
+    for (size_t i = 0; i < CELL_CACHE_WIDTHS; i++) {
+        struct cell_cache_bucket *bucket = &cell_cache.buckets[i];
+        if (bucket->cols == cols)
+            return bucket;
+    }
+    return NULL;
+}
+
+static void
+cell_cache_bucket_flush(struct cell_cache_bucket *bucket)
+{
+    for (size_t i = 0; i < bucket->count; i++)
+        free(bucket->arrays[i]);
+    bucket->count = 0;
+}
+
+static struct cell *
+cells_alloc(int cols)
+{
+    struct cell_cache_bucket *bucket = cell_cache_lookup(cols);
+    if (bucket != NULL && bucket->count > 0) {
+        bucket->last_used = ++cell_cache.clock;
+        return bucket->arrays[--bucket->count];
+    }
+
+    return xmalloc(cols * sizeof(struct cell));
+}
+
+static void
+cells_free(struct cell *cells, int cols)
+{
+    if (cells == NULL)
+        return;
+
+    struct cell_cache_bucket *bucket = cell_cache_lookup(cols);
+
+    if (unlikely(bucket == NULL)) {
+        /* Use an empty bucket, or evict the least recently used one */
+        bucket = &cell_cache.buckets[0];
+        for (size_t i = 0; i < CELL_CACHE_WIDTHS; i++) {
+            struct cell_cache_bucket *b = &cell_cache.buckets[i];
+            if (b->count == 0) {
+                bucket = b;
+                break;
+            }
+            if (b->last_used < bucket->last_used)
+                bucket = b;
+        }
+
+        cell_cache_bucket_flush(bucket);
+        bucket->cols = cols;
+    }
+
+    bucket->last_used = ++cell_cache.clock;
+
+    if (bucket->count < CELL_CACHE_SIZE)
+        bucket->arrays[bucket->count++] = cells;
+    else
+        free(cells);
+}
+
+void
+grid_cell_cache_flush(void)
+{
+    for (size_t i = 0; i < CELL_CACHE_WIDTHS; i++) {
+        cell_cache_bucket_flush(&cell_cache.buckets[i]);
+        cell_cache.buckets[i].cols = 0;
+    }
+
+    free(cell_cache.pack_buf);
+    cell_cache.pack_buf = NULL;
+    cell_cache.pack_buf_size = 0;
+}
+
 struct row *
 grid_row_alloc(int cols, bool initialize)
 {
     struct row *row = xmalloc(sizeof(*row));
     row->dirty = false;
+    row->all_dirty = false;
     row->linebreak = false;
     row->extra = NULL;
+    row->packed = NULL;
     row->shell_integration.prompt_marker = false;
     row->shell_integration.cmd_start = -1;
     row->shell_integration.cmd_end = -1;
 
+    row->cells = cells_alloc(cols);
+
     if (initialize) {
-        row->cells = xcalloc(cols, sizeof(row->cells[0]));
+        memset(row->cells, 0, cols * sizeof(row->cells[0]));
         for (size_t c = 0; c < cols; c++)
             row->cells[c].attrs.clean = 1;
-    } else
-        row->cells = xmalloc(cols * sizeof(row->cells[0]));
+    }
 
     return row;
 }
@@ -459,9 +596,506 @@ grid_row_free(struct row *row)
     grid_row_reset_extra(row);
     free(row->extra);
     free(row->cells);
+    free(row->packed);
     free(row);
 }
 
+/*
+ * Packed rows
+ *
+ * Each distinct set of attributes used by the row is stored once, in
+ * a palette at the beginning of the row:
+ *
+ *   count:      varint, number of palette entries
+ *   palette:    'count' * sizeof(struct attributes) bytes
+ *
+ * followed by the cells, encoded as a sequence of runs, each run
+ * sharing the same attributes:
+ *
+ *   header:     varint, (cell count << 1) | fill
+ *   attributes: varint, palette index
+ *   characters: one varint if 'fill' (repeated 'cell count' times),
+ *               otherwise one varint per cell
+ *
+ * Since most scrollback rows are ASCII text with default attributes,
+ * followed by empty cells, a typical row packs into roughly one byte
+ * per character, plus a couple of runs. Rows switching back and forth
+ * between a handful of attributes (e.g. syntax highlighted code) cost
+ * a byte per attribute change, rather than a full set of attributes.
+ */
+
+static size_t
+varint_put(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+static uint32_t
+varint_get(const uint8_t **p)
+{
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
+
+static inline struct attributes
+pack_attrs(struct attributes attrs)
+{
+    /* Packed rows are never in view; the 'clean' bit is meaningless */
+    attrs.clean = 0;
+    return attrs;
+}
+
+static inline bool
+attrs_equal(struct attributes a, struct attributes b)
+{
+    a = pack_attrs(a);
+    b = pack_attrs(b);
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static inline bool
+cells_equal(const struct cell *a, const struct cell *b)
+{
+    return a->wc == b->wc && attrs_equal(a->attrs, b->attrs);
+}
+
+static size_t
+identical_cells(const struct cell *cells, int cols, int start, int max_count)
+{
+    int end = start + 1;
+    while (end < cols && end - start < max_count &&
+           cells_equal(&cells[end], &cells[start]))
+    {
+        end++;
+    }
+    return end - start;
+}
+
+#define PACK_MIN_FILL 4
+
+size_t
+grid_cells_encode_max_size(int cols)
+{
+    /* Worst case: every cell in a run of its own, with attributes
+     * of its own */
+    return 5 + cols * (sizeof(struct attributes) + 5 + 5 + 5);
+}
+
+/*
+ * Rows with more attributes than this (e.g. truecolor gradients) look
+ * up attributes in a hash table, rather than searching the palette
+ */
+#define PACK_PALETTE_LINEAR_MAX 8
+
+static inline uint32_t
+attrs_hash(struct attributes attrs, uint32_t mask)
+{
+    static_assert(sizeof(attrs) == sizeof(uint64_t), "attributes size");
+    uint64_t v;
+    memcpy(&v, &attrs, sizeof(v));
+    return (v * 0x9e3779b97f4a7c15ull) >> 32 & mask;
+}
+
+static inline size_t
+pack_hash_size(int cols)
+{
+    size_t size = 16;
+    while (size < 2 * (size_t)cols)
+        size *= 2;
+    return size;
+}
+
+static inline size_t
+align8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/*
+ * Returns the scratch buffer used when packing rows, large enough for
+ * a row of 'cols' columns. It holds (in that order) the encoded row,
+ * and grid_cells_encode()'s attribute palette, each cell's palette
+ * index, and a hash table over the palette.
+ */
+static uint8_t *
+pack_buf_reserve(int cols)
+{
+    const size_t size =
+        align8(grid_cells_encode_max_size(cols)) +
+        cols * sizeof(struct attributes) +
+        cols * sizeof(uint32_t) +
+        pack_hash_size(cols) * sizeof(uint32_t);
+
+    if (cell_cache.pack_buf_size < size) {
+        free(cell_cache.pack_buf);
+        cell_cache.pack_buf = xmalloc(size);
+        cell_cache.pack_buf_size = size;
+    }
+
+    return cell_cache.pack_buf;
+}
+
+size_t
+grid_cells_encode(const struct cell *cells, int cols, uint8_t *buf)
+{
+    /*
+     * Attribute palette, and each cell's index into it. 'buf' may be
+     * the beginning of the pack buffer; the scratch arrays follow the
+     * space reserved for the encoded row.
+     */
+    uint8_t *scratch =
+        pack_buf_reserve(cols) + align8(grid_cells_encode_max_size(cols));
+
+    struct attributes *palette = (struct attributes *)scratch;
+    uint32_t *attr_idx = (uint32_t *)&palette[cols];
+    uint32_t *hash = &attr_idx[cols];   /* palette index + 1; 0 if free */
+    const uint32_t hash_mask = pack_hash_size(cols) - 1;
+    uint32_t palette_count = 0;
+
+    for (int c = 0; c < cols; c++) {
+        if (c > 0 && attrs_equal(cells[c].attrs, cells[c - 1].attrs)) {
+            attr_idx[c] = attr_idx[c - 1];
+            continue;
+        }
+
+        const struct attributes attrs = pack_attrs(cells[c].attrs);
+        uint32_t i = 0;
+
+        if (palette_count <= PACK_PALETTE_LINEAR_MAX) {
+            /* Rows rarely use more than a handful of attributes */
+            while (i < palette_count &&
+                   memcmp(&palette[i], &attrs, sizeof(attrs)) != 0)
+            {
+                i++;
+            }
+
+            if (i == palette_count) {
+                palette[palette_count++] = attrs;
+
+                if (palette_count > PACK_PALETTE_LINEAR_MAX) {
+                    /* Switch to the hash table */
+                    memset(hash, 0, (hash_mask + 1) * sizeof(hash[0]));
+                    for (uint32_t j = 0; j < palette_count; j++) {
+                        uint32_t h = attrs_hash(palette[j], hash_mask);
+                        while (hash[h] != 0)
+                            h = (h + 1) & hash_mask;
+                        hash[h] = j + 1;
+                    }
+                }
+            }
+        } else {
+            uint32_t h = attrs_hash(attrs, hash_mask);
+            while (hash[h] != 0 &&
+                   memcmp(&palette[hash[h] - 1], &attrs, sizeof(attrs)) != 0)
+            {
+                h = (h + 1) & hash_mask;
+            }
+
+            if (hash[h] == 0) {
+                palette[palette_count++] = attrs;
+                hash[h] = palette_count;
+            }
+
+            i = hash[h] - 1;
+        }
+
+        attr_idx[c] = i;
+    }
+
+    size_t len = varint_put(buf, palette_count);
+    memcpy(&buf[len], palette, palette_count * sizeof(palette[0]));
+    len += palette_count * sizeof(palette[0]);
+
+    for (int c = 0; c < cols;) {
+        const uint32_t idx = attr_idx[c];
+        const size_t fill = identical_cells(cells, cols, c, INT_MAX);
+
+        if (fill >= PACK_MIN_FILL) {
+            len += varint_put(&buf[len], fill << 1 | 1);
+            len += varint_put(&buf[len], idx);
+            len += varint_put(&buf[len], cells[c].wc);
+            c += fill;
+            continue;
+        }
+
+        /* Literal run; ends where attributes change, or where a
+         * fill run starts */
+        int end = c + 1;
+        while (end < cols &&
+               attr_idx[end] == idx &&
+               identical_cells(cells, cols, end, PACK_MIN_FILL) < PACK_MIN_FILL)
+        {
+            end++;
+        }
+
+        len += varint_put(&buf[len], (uint32_t)(end - c) << 1);
+        len += varint_put(&buf[len], idx);
+
+        for (; c < end; c++)
+            len += varint_put(&buf[len], cells[c].wc);
+    }
+
+    xassert(len <= grid_cells_encode_max_size(cols));
+    return len;
+}
+
+void
+grid_cells_decode(const uint8_t *data, size_t size, struct cell *cells, int cols)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = p + size;
+    int c = 0;
+
+    const uint32_t palette_count = varint_get(&p);
+    const uint8_t *palette = p;
+    p += palette_count * sizeof(struct attributes);
+
+    while (p < end) {
+        const uint32_t header = varint_get(&p);
+        const uint32_t count = header >> 1;
+        const bool fill = header & 1;
+        const uint32_t idx = varint_get(&p);
+
+        xassert(idx < palette_count);
+
+        struct attributes attrs;
+        memcpy(&attrs, &palette[idx * sizeof(attrs)], sizeof(attrs));
+
+        xassert(c + count <= cols);
+
+        if (fill) {
+            const char32_t wc = varint_get(&p);
+            for (uint32_t i = 0; i < count; i++, c++)
+                cells[c] = (struct cell){.wc = wc, .attrs = attrs};
+        } else {
+            for (uint32_t i = 0; i < count; i++, c++)
+                cells[c] = (struct cell){.wc = varint_get(&p), .attrs = attrs};
+        }
+    }
+
+    xassert(c == cols);
+}
+
+bool
+grid_row_pack(struct row *row, int cols)
+{
+    xassert(row->cells != NULL);
+    xassert(row->packed == NULL);
+
+    uint8_t *buf = pack_buf_reserve(cols);
+    const size_t len = grid_cells_encode(row->cells, cols, buf);
+
+    if (len >= cols * sizeof(struct cell) / 2) {
+        /* Not worth it */
+        return false;
+    }
+
+    struct row_packed *packed = xmalloc(sizeof(*packed) + len);
+    packed->cols = cols;
+    packed->size = len;
+    memcpy(packed->data, buf, len);
+
+    cells_free(row->cells, cols);
+    row->cells = NULL;
+    row->packed = packed;
+    return true;
+}
+
+size_t
+grid_row_encode(const struct row *row, int cols, uint8_t *buf)
+{
+    if (row->packed != NULL) {
+        xassert(row->packed->cols == cols);
+        memcpy(buf, row->packed->data, row->packed->size);
+        return row->packed->size;
+    }
+
+    return grid_cells_encode(row->cells, cols, buf);
+}
+
+void
+grid_row_unpack_into(const struct row *row, struct cell *cells, int cols)
+{
+    xassert(row->packed != NULL);
+    xassert(row->packed->cols == cols);
+    grid_cells_decode(row->packed->data, row->packed->size, cells, cols);
+}
+
+void
+grid_row_unpack(struct row *row)
+{
+    const int cols = row->packed->cols;
+    struct cell *cells = cells_alloc(cols);
+    grid_row_unpack_into(row, cells, cols);
+
+    free(row->packed);
+    row->packed = NULL;
+    row->cells = cells;
+
+    /* We don't know what was rendered last time the row was visible */
+    row->dirty = true;
+}
+
+UNITTEST
+{
+    const int cols = 80;
+    struct row *row = grid_row_alloc(cols, true);
+
+    for (int c = 0; c < 10; c++)
+        row->cells[c].wc = U'a' + c;
+    row->cells[3].attrs.bold = true;
+    row->cells[12].wc = CELL_COMB_CHARS_LO + 0x12345;
+    row->cells[13].wc = CELL_SPACER + 1;
+    row->cells[20].attrs.bg_src = COLOR_RGB;
+    row->cells[20].attrs.bg = 0x123456;
+    for (int c = 30; c < 40; c++)
+        row->cells[c].wc = U'x';
+
+    struct cell copy[80];
+    memcpy(copy, row->cells, sizeof(copy));
+
+    xassert(grid_row_pack(row, cols));
+    xassert(row->cells == NULL);
+    xassert(row->packed != NULL);
+    xassert(row->packed->size < cols * sizeof(struct cell) / 2);
+
+    struct cell peek[80];
+    grid_row_unpack_into(row, peek, cols);
+
+    grid_row_unpack(row);
+    xassert(row->packed == NULL);
+    xassert(row->dirty);
+
+    for (int c = 0; c < cols; c++) {
+        xassert(row->cells[c].wc == copy[c].wc);
+        xassert(peek[c].wc == copy[c].wc);
+        xassert(attrs_equal(row->cells[c].attrs, copy[c].attrs));
+        xassert(attrs_equal(peek[c].attrs, copy[c].attrs));
+        xassert(!row->cells[c].attrs.clean);
+    }
+
+    grid_row_free(row);
+}
+
+UNITTEST
+{
+    /* Cell arrays are recycled when packing and unpacking rows */
+    grid_cell_cache_flush();
+
+    const int cols = 80;
+    struct row *a = grid_row_alloc(cols, true);
+    struct row *b = grid_row_alloc(cols, true);
+    struct row *narrow = grid_row_alloc(cols - 1, true);
+
+    struct cell *cells = a->cells;
+    xassert(grid_row_pack(a, cols));
+    xassert(cell_cache_lookup(cols)->count == 1);
+
+    struct row *c = grid_row_alloc(cols, true);
+    xassert(c->cells == cells);
+    xassert(cell_cache_lookup(cols)->count == 0);
+
+    for (int i = 0; i < cols; i++) {
+        xassert(c->cells[i].wc == 0);
+        xassert(c->cells[i].attrs.clean);
+    }
+
+    /* Different widths are cached side by side */
+    struct cell *narrow_cells = narrow->cells;
+    xassert(grid_row_pack(b, cols));
+    xassert(grid_row_pack(narrow, cols - 1));
+    xassert(cell_cache_lookup(cols)->count == 1);
+    xassert(cell_cache_lookup(cols - 1)->count == 1);
+
+    struct row *d = grid_row_alloc(cols - 1, true);
+    xassert(d->cells == narrow_cells);
+
+    /* The least recently used width is dropped */
+    for (int i = 0; i < CELL_CACHE_WIDTHS; i++) {
+        struct row *r = grid_row_alloc(cols + 1 + i, true);
+        xassert(grid_row_pack(r, cols + 1 + i));
+        grid_row_free(r);
+    }
+    xassert(cell_cache_lookup(cols) == NULL);
+    xassert(cell_cache_lookup(cols + CELL_CACHE_WIDTHS) != NULL);
+
+    grid_row_free(a);
+    grid_row_free(b);
+    grid_row_free(c);
+    grid_row_free(d);
+    grid_row_free(narrow);
+    grid_cell_cache_flush();
+}
+
+UNITTEST
+{
+    /* Attributes alternating between every cell; each set of
+     * attributes is only stored once */
+    const int cols = 80;
+    struct row *row = grid_row_alloc(cols, true);
+
+    for (int c = 0; c < cols; c++) {
+        row->cells[c].wc = U'a' + c % 26;
+        row->cells[c].attrs.fg_src = COLOR_BASE256;
+        row->cells[c].attrs.fg = c % 3;
+        row->cells[c].attrs.bold = c % 2;
+    }
+
+    struct cell copy[80];
+    memcpy(copy, row->cells, sizeof(copy));
+
+    xassert(grid_row_pack(row, cols));
+    xassert(row->packed->size <= 1 + 6 * sizeof(struct attributes) + cols * 3);
+
+    grid_row_unpack(row);
+
+    for (int c = 0; c < cols; c++) {
+        xassert(row->cells[c].wc == copy[c].wc);
+        xassert(attrs_equal(row->cells[c].attrs, copy[c].attrs));
+    }
+
+    grid_row_free(row);
+}
+
+UNITTEST
+{
+    /* More attributes than fit the linear palette search; the hash
+     * table must still store each set of attributes only once */
+    const int cols = 120;
+    struct cell cells[120] = {0};
+
+    for (int c = 0; c < cols; c++) {
+        cells[c].wc = U'a' + c % 26;
+        cells[c].attrs.fg_src = COLOR_RGB;
+        cells[c].attrs.fg = (c % 40) * 0x010203;
+    }
+
+    uint8_t *buf = xmalloc(grid_cells_encode_max_size(cols));
+    const size_t len = grid_cells_encode(cells, cols, buf);
+    xassert(buf[0] == 40);
+
+    struct cell decoded[120];
+    grid_cells_decode(buf, len, decoded, cols);
+
+    for (int c = 0; c < cols; c++) {
+        xassert(decoded[c].wc == cells[c].wc);
+        xassert(attrs_equal(decoded[c].attrs, cells[c].attrs));
+    }
+
+    free(buf);
+}
+
 void
 grid_resize_without_reflow(
     struct grid *grid, int new_rows, int new_cols,
@@ -485,7 +1119,7 @@ grid_resize_without_reflow(
         const int old_row_idx = (grid->offset + r) & (old_rows - 1);
         const int new_row_idx = (new_offset + r) & (new_rows - 1);
 
-        const struct row *old_row = old_grid[old_row_idx];
+        const struct row *old_row = grid_row_unpacked(old_grid[old_row_idx]);
         xassert(old_row != NULL);
 
         struct row *new_row = grid_row_alloc(new_cols, false);
@@ -596,6 +1230,7 @@ grid_resize_without_reflow(
     grid->rows = new_grid;
     grid->num_rows = new_rows;
     grid->num_cols = new_cols;
+    grid_sixel_rows_invalidate(grid);
 
     grid->view = grid->offset = new_offset;
 
@@ -693,7 +1328,8 @@ reflow_range_end(struct row_range *range, enum row_range_type type,
 
 static struct row *
 _line_wrap(struct grid *old_grid, struct row **new_grid, struct row *row,
-           int *row_idx, int *col_idx, int row_count, int col_count)
+           int *row_idx, int *col_idx, int row_count, int col_count,
+           struct scrollback_spill *spill)
 {
     *col_idx = 0;
     *row_idx = (*row_idx + 1) & (row_count - 1);
@@ -706,6 +1342,12 @@ _line_wrap(struct grid *old_grid, struct row **new_grid, struct row *row,
         new_grid[*row_idx] = new_row;
     } else {
         /* Scrollback is full, need to reuse a row */
+        if (spill != NULL) {
+            /* Rows pending reflow are older, and can't be placed either */
+            grid_reflow_pending_discard(old_grid, spill);
+            scrollback_spill_row(spill, new_row, col_count);
+        }
+
         grid_row_reset_extra(new_row);
         new_row->linebreak = false;
         new_row->shell_integration.prompt_marker = false;
@@ -809,12 +1451,56 @@ tp_cmp(const void *_a, const void *_b)
     return 0;
 }
 
-void
-grid_resize_and_reflow(
+/*
+ * Number of cells of 'row' to reflow: up to the last non-empty cell,
+ * or all of them, if the logical line continues on the next row. URI
+ * and underline ranges are always included.
+ */
+static int
+reflow_col_count(const struct row *row, int old_cols)
+{
+    /* Find last non-empty cell */
+    int col_count = 0;
+    for (int c = old_cols - 1; c >= 0; c--) {
+        const struct cell *cell = &row->cells[c];
+        if (!(cell->wc == 0 || cell->wc == CELL_SPACER)) {
+            col_count = c + 1;
+            break;
+        }
+    }
+
+    if (!row->linebreak && col_count > 0) {
+        /* Don't truncate logical lines */
+        col_count = old_cols;
+    }
+
+    const struct row_data *extra = row->extra;
+
+    if (extra != NULL && extra->uri_ranges.count > 0) {
+        /* Make sure the *last* URI range's end point is included
+         * in the copy */
+        const struct row_range *last_on_row =
+            &extra->uri_ranges.v[extra->uri_ranges.count - 1];
+        col_count = max(col_count, last_on_row->end + 1);
+    }
+
+    if (extra != NULL && extra->underline_ranges.count > 0) {
+        const struct row_range *last_on_row =
+            &extra->underline_ranges.v[extra->underline_ranges.count - 1];
+        col_count = max(col_count, last_on_row->end + 1);
+    }
+
+    xassert(col_count >= 0 && col_count <= old_cols);
+    return col_count;
+}
+
+static void
+reflow(
     struct grid *grid, int new_rows, int new_cols,
     int old_screen_rows, int new_screen_rows,
     size_t tracking_points_count,
-    struct coord *const _tracking_points[static tracking_points_count])
+    struct coord *const _tracking_points[static tracking_points_count],
+    struct scrollback_spill *spill)
 {
 #if defined(TIME_REFLOW) && TIME_REFLOW
     struct timespec start;
@@ -897,7 +1583,7 @@ grid_resize_and_reflow(
         const size_t old_row_idx = (offset + r) & (old_rows - 1);
 
         /* Unallocated (empty) rows we can simply skip */
-        const struct row *old_row = old_grid[old_row_idx];
+        const struct row *old_row = grid_row_unpacked(old_grid[old_row_idx]);
         if (old_row == NULL)
             continue;
 
@@ -916,24 +1602,9 @@ grid_resize_and_reflow(
 #define line_wrap()                                                 \
         new_row = _line_wrap(                                       \
             grid, new_grid, new_row, &new_row_idx, &new_col_idx,    \
-            new_rows, new_cols)
-
-        /* Find last non-empty cell */
-        int col_count = 0;
-        for (int c = old_cols - 1; c >= 0; c--) {
-            const struct cell *cell = &old_row->cells[c];
-            if (!(cell->wc == 0 || cell->wc == CELL_SPACER)) {
-                col_count = c + 1;
-                break;
-            }
-        }
-
-        if (!old_row->linebreak && col_count > 0) {
-            /* Don't truncate logical lines */
-            col_count = old_cols;
-        }
+            new_rows, new_cols, spill)
 
-        xassert(col_count >= 0 && col_count <= old_cols);
+        int col_count = reflow_col_count(old_row, old_cols);
 
         /* Do we have a (at least one) tracking point on this row */
         struct coord *tp;
@@ -960,21 +1631,12 @@ grid_resize_and_reflow(
             uri_range = &extra->uri_ranges.v[0];
             uri_range_terminator = &extra->uri_ranges.v[extra->uri_ranges.count];
 
-            /* Make sure the *last* URI range's end point is included
-             * in the copy */
-            const struct row_range *last_on_row =
-                &extra->uri_ranges.v[extra->uri_ranges.count - 1];
-            col_count = max(col_count, last_on_row->end + 1);
         } else
             uri_range = uri_range_terminator = NULL;
 
         if (extra != NULL && extra->underline_ranges.count > 0) {
             underline_range = &extra->underline_ranges.v[0];
             underline_range_terminator = &extra->underline_ranges.v[extra->underline_ranges.count];
-
-            const struct row_range *last_on_row =
-                &extra->underline_ranges.v[extra->underline_ranges.count - 1];
-            col_count = max(col_count, last_on_row->end + 1);
         } else
             underline_range = underline_range_terminator = NULL;
 
@@ -1249,6 +1911,7 @@ grid_resize_and_reflow(
     grid->rows = new_grid;
     grid->num_rows = new_rows;
     grid->num_cols = new_cols;
+    grid_sixel_rows_invalidate(grid);
 
     /*
      * Set new viewport, making sure it's not too far down.
@@ -1301,6 +1964,356 @@ grid_resize_and_reflow(
 #endif
 }
 
+/*
+ * Reflowing a large scrollback is slow. Only the screen, and this
+ * many screens of scrollback, are reflowed immediately. Older rows are
+ * reflowed lazily; see grid_reflow_pending().
+ */
+#define REFLOW_EAGER_SCREENS 4
+
+/* Don't bother deferring less than this many rows */
+#define REFLOW_LAZY_MIN_ROWS 4096
+
+/*
+ * Moves the oldest part of the scrollback to a new pending segment,
+ * leaving NULL rows in its place (i.e. the scrollback looks like it
+ * hasn't been filled yet).
+ *
+ * Everything that references a row (tracking points, the viewport,
+ * sixels) must be reflowed immediately; the split is made at a logical
+ * line boundary, *before* the oldest such row.
+ */
+static void
+defer_old_scrollback(struct grid *grid, int old_screen_rows,
+                     size_t tracking_points_count,
+                     struct coord *const tracking_points[])
+{
+    const int mask = grid->num_rows - 1;
+    const int sb_start =
+        grid_sb_start_ignore_uninitialized(grid, old_screen_rows);
+
+#define sb_rel(abs_row) \
+    grid_row_abs_to_sb_precalc_sb_start(grid, sb_start, abs_row)
+
+    /* Number of (scrollback relative) rows to defer */
+    int count = sb_rel(grid->offset) - REFLOW_EAGER_SCREENS * old_screen_rows;
+    count = min(count, sb_rel(grid->view));
+
+    for (size_t i = 0; i < tracking_points_count; i++) {
+        if (tracking_points[i]->row >= 0)
+            count = min(count, sb_rel(tracking_points[i]->row));
+    }
+
+    tll_foreach(grid->sixel_images, it)
+        count = min(count, sb_rel(it->item.pos.row));
+
+#undef sb_rel
+
+    /* Don't split logical lines */
+    while (count > 0 && !grid->rows[(sb_start + count - 1) & mask]->linebreak)
+        count--;
+
+    if (count < REFLOW_LAZY_MIN_ROWS)
+        return;
+
+    struct grid_reflow_segment segment = {
+        .rows = xmalloc(count * sizeof(segment.rows[0])),
+        .count = count,
+        .cols = grid->num_cols,
+    };
+
+    for (int i = 0; i < count; i++) {
+        const int r = (sb_start + i) & mask;
+        segment.rows[i] = grid->rows[r];
+        grid->rows[r] = NULL;
+    }
+
+    LOG_DBG("deferring reflow of %d rows", count);
+    tll_push_back(grid->reflow_pending, segment);
+}
+
+void
+grid_resize_and_reflow(
+    struct grid *grid, int new_rows, int new_cols,
+    int old_screen_rows, int new_screen_rows,
+    size_t tracking_points_count,
+    struct coord *const tracking_points[static tracking_points_count],
+    struct scrollback_spill *spill)
+{
+    defer_old_scrollback(
+        grid, old_screen_rows, tracking_points_count, tracking_points);
+
+    reflow(grid, new_rows, new_cols, old_screen_rows, new_screen_rows,
+           tracking_points_count, tracking_points, spill);
+}
+
+int
+grid_reflow_pending(struct grid *grid, int screen_rows, int max_rows,
+                    struct scrollback_spill *spill)
+{
+    if (tll_length(grid->reflow_pending) == 0)
+        return 0;
+
+    struct grid_reflow_segment *segment = &tll_back(grid->reflow_pending);
+    xassert(segment->count > 0);
+
+    /* Whole logical lines, from the (newest) end of the segment */
+    int start = max(segment->count - max_rows, 0);
+    while (start > 0 && !segment->rows[start - 1]->linebreak)
+        start--;
+
+    const int count = segment->count - start;
+    const int old_cols = segment->cols;
+    const int new_cols = grid->num_cols;
+
+    /*
+     * Reflow the rows in a temporary grid. They are preceded by an
+     * empty row, that the cursor is placed on. And, since the last
+     * row ends with a linebreak, reflow() always emits an empty row
+     * after it. Both are thrown away.
+     */
+    const int tmp_old_rows = 1 << (32 - __builtin_clz(count + 1));
+
+    /*
+     * Size the new grid from the number of rows each logical line
+     * wraps into. Multi-column characters that don't fit at the end of
+     * a row are pushed to the next one, wasting at most one cell per
+     * row. Plus the two rows thrown away.
+     */
+    const size_t cells_per_row = max(new_cols - 1, 1);
+    size_t max_new_rows = 2;
+    size_t line_cells = 0;
+
+    for (int r = start; r < segment->count; r++) {
+        const struct row *row = grid_row_unpacked(segment->rows[r]);
+        line_cells += reflow_col_count(row, old_cols);
+
+        if (row->linebreak || r + 1 == segment->count) {
+            max_new_rows +=
+                max((line_cells + cells_per_row - 1) / cells_per_row, 1);
+            line_cells = 0;
+        }
+    }
+
+    xassert(max_new_rows < INT_MAX / 2);
+    const int tmp_new_rows = 1 << (32 - __builtin_clz((unsigned)max_new_rows));
+
+    struct grid tmp = {
+        .num_rows = tmp_old_rows,
+        .num_cols = old_cols,
+        .rows = xcalloc(tmp_old_rows, sizeof(tmp.rows[0])),
+    };
+
+    tmp.rows[0] = grid_row_alloc(old_cols, true);
+    tmp.rows[0]->linebreak = true;
+    memcpy(&tmp.rows[1], &segment->rows[start], count * sizeof(tmp.rows[0]));
+
+    reflow(&tmp, tmp_new_rows, new_cols, 0, 1, 0, NULL, NULL);
+
+    const int produced = tmp.offset - 1;
+    xassert(produced >= 0);
+
+    grid_row_free(tmp.rows[0]);
+    grid_row_free(tmp.rows[tmp.offset]);
+
+    /* Prepend the new rows to the scrollback, as long as there's room */
+    const int mask = grid->num_rows - 1;
+    const int sb_start = grid_sb_start_ignore_uninitialized(grid, screen_rows);
+    const int unused = (sb_start - grid->offset - screen_rows) & mask;
+    const int placed = min(produced, unused);
+
+    for (int i = 0; i < placed; i++)
+        grid->rows[(sb_start - 1 - i) & mask] = tmp.rows[produced - i];
+
+    LOG_DBG("reflowed %d pending rows into %d rows (%d discarded)",
+            count, produced, produced - placed);
+
+    segment->count = start;
+
+    if (placed < produced) {
+        /*
+         * Scrollback is full; anything older would be discarded
+         * anyway. Oldest first: the remaining pending rows, then the
+         * reflowed rows that didn't fit.
+         */
+        grid_reflow_pending_discard(grid, spill);
+
+        for (int i = 1; i <= produced - placed; i++) {
+            if (spill != NULL)
+                scrollback_spill_row(spill, tmp.rows[i], new_cols);
+            grid_row_free(tmp.rows[i]);
+        }
+    } else if (segment->count == 0) {
+        free(segment->rows);
+        tll_pop_back(grid->reflow_pending);
+    }
+
+    free(tmp.rows);
+    tll_free(tmp.scroll_damage);
+
+    return placed;
+}
+
+void
+grid_reflow_pending_discard(struct grid *grid, struct scrollback_spill *spill)
+{
+    tll_foreach(grid->reflow_pending, it) {
+        for (int i = 0; i < it->item.count; i++) {
+            if (spill != NULL)
+                scrollback_spill_row(spill, it->item.rows[i], it->item.cols);
+            grid_row_free(it->item.rows[i]);
+        }
+        free(it->item.rows);
+        tll_remove(grid->reflow_pending, it);
+    }
+}
+
+static void
+sixel_rows_set(struct grid *grid, int abs_row, int count)
+{
+    const int mask = grid->num_rows - 1;
+    count = min(count, grid->num_rows);
+
+    for (int i = 0; i < count; i++) {
+        const int r = (abs_row + i) & mask;
+        grid->sixel_rows[r / 64] |= 1ull << (r % 64);
+    }
+}
+
+void
+grid_sixel_rows_add(struct grid *grid, int abs_row, int count)
+{
+    if (unlikely(grid->sixel_rows == NULL)) {
+        /* Picks up this image too, if it's already in the list */
+        grid_sixel_rows_rebuild(grid);
+    }
+
+    sixel_rows_set(grid, abs_row, count);
+}
+
+void
+grid_sixel_rows_rebuild(struct grid *grid)
+{
+    const size_t words = (grid->num_rows + 63) / 64;
+
+    if (grid->sixel_rows == NULL)
+        grid->sixel_rows = xcalloc(words, sizeof(grid->sixel_rows[0]));
+    else
+        memset(grid->sixel_rows, 0, words * sizeof(grid->sixel_rows[0]));
+
+    tll_foreach(grid->sixel_images, it)
+        sixel_rows_set(grid, it->item.pos.row, it->item.rows);
+}
+
+void
+grid_sixel_rows_invalidate(struct grid *grid)
+{
+    free(grid->sixel_rows);
+    grid->sixel_rows = NULL;
+}
+
+bool
+grid_sixel_rows_any(const struct grid *grid, int abs_row, int count)
+{
+    if (grid->sixel_rows == NULL)
+        return tll_length(grid->sixel_images) > 0;
+
+    const int mask = grid->num_rows - 1;
+    count = min(count, grid->num_rows);
+
+    for (int i = 0; i < count; i++) {
+        if (grid_sixel_row(grid, (abs_row + i) & mask))
+            return true;
+    }
+
+    return false;
+}
+
+static void UNUSED
+reflow_test_grid_init(struct grid *grid, int num_rows, int cols, int screen_rows)
+{
+    *grid = (struct grid){
+        .num_rows = num_rows,
+        .num_cols = cols,
+        .offset = num_rows - screen_rows,
+        .rows = xcalloc(num_rows, sizeof(grid->rows[0])),
+    };
+
+    grid->view = grid->offset;
+
+    unsigned seed = 1;
+    for (int r = 0; r < num_rows; r++) {
+        struct row *row = grid_row_alloc(cols, true);
+        grid->rows[r] = row;
+
+        seed = seed * 1103515245 + 12345;
+        const int len = (seed >> 16) % (cols + 1);
+        row->linebreak = (seed >> 8) % 4 != 0;
+
+        for (int c = 0; c < len; c++) {
+            if (c + 1 < len && (c + r) % 17 == 0) {
+                row->cells[c].wc = 0x4e00 + c;
+                row->cells[c + 1].wc = CELL_SPACER + 1;
+                c++;
+            } else {
+                row->cells[c].wc = U'a' + (r + c) % 26;
+                row->cells[c].attrs.bold = c % 7 == 0;
+            }
+        }
+    }
+
+    grid->cur_row = grid->rows[grid->offset];
+}
+
+UNITTEST
+{
+    /*
+     * Lazily reflowing the old scrollback must give the same result
+     * as reflowing everything at once
+     */
+    const int screen_rows = 24;
+
+    for (int new_cols = 37; new_cols <= 131; new_cols += 47) {
+        struct grid eager;
+        struct grid lazy;
+        reflow_test_grid_init(&eager, 16384, 80, screen_rows);
+        reflow_test_grid_init(&lazy, 16384, 80, screen_rows);
+
+        reflow(&eager, 16384, new_cols, screen_rows, screen_rows, 0, NULL,
+               NULL);
+        grid_resize_and_reflow(
+            &lazy, 16384, new_cols, screen_rows, screen_rows, 0, NULL, NULL);
+
+        xassert(tll_length(lazy.reflow_pending) == 1);
+
+        while (tll_length(lazy.reflow_pending) > 0)
+            grid_reflow_pending(&lazy, screen_rows, 1000, NULL);
+
+        xassert(eager.cursor.point.row == lazy.cursor.point.row);
+        xassert(eager.cursor.point.col == lazy.cursor.point.col);
+
+        /* Compare from the bottom of the screen, and up */
+        const int mask = eager.num_rows - 1;
+        for (int i = 0; i < eager.num_rows; i++) {
+            const struct row *a =
+                eager.rows[(eager.offset + screen_rows - 1 - i) & mask];
+            const struct row *b =
+                lazy.rows[(lazy.offset + screen_rows - 1 - i) & mask];
+
+            xassert((a == NULL) == (b == NULL));
+            if (a == NULL)
+                continue;
+
+            xassert(a->linebreak == b->linebreak);
+            for (int c = 0; c < new_cols; c++)
+                xassert(cells_equal(&a->cells[c], &b->cells[c]));
+        }
+
+        grid_free(&eager);
+        grid_free(&lazy);
+    }
+}
+
 static bool
 ranges_match(const struct row_range *r1, const struct row_range *r2,
              enum row_range_type type)
@@ -1693,3 +2706,54 @@ UNITTEST
     grid_row_ranges_destroy(&row_data.uri_ranges, ROW_RANGE_URI);
     free(row_data.uri_ranges.v);
 }
+
+UNITTEST
+{
+    struct grid grid = {.num_rows = 256};
+
+    /* No index yet; falls back to the image list */
+    xassert(!grid_sixel_row(&grid, 10));
+
+    /* An image at the end of the grid, and one that ends at row 130 */
+    tll_push_back(grid.sixel_images, ((struct sixel){.pos = {0, 250}, .rows = 6}));
+    xassert(grid_sixel_row(&grid, 10));
+
+    grid_sixel_rows_rebuild(&grid);
+    xassert(grid.sixel_rows != NULL);
+    xassert(!grid_sixel_row(&grid, 249));
+    xassert(grid_sixel_row(&grid, 250));
+    xassert(grid_sixel_row(&grid, 255));
+    xassert(!grid_sixel_row(&grid, 0));
+
+    tll_push_back(grid.sixel_images, ((struct sixel){.pos = {4, 128}, .rows = 3}));
+    grid_sixel_rows_add(&grid, 128, 3);
+    xassert(!grid_sixel_row(&grid, 127));
+    xassert(grid_sixel_row(&grid, 128));
+    xassert(grid_sixel_row(&grid, 130));
+    xassert(!grid_sixel_row(&grid, 131));
+
+    xassert(grid_sixel_rows_any(&grid, 120, 9));
+    xassert(!grid_sixel_rows_any(&grid, 120, 8));
+    xassert(!grid_sixel_rows_any(&grid, 131, 119));
+
+    /* Wraps around */
+    xassert(grid_sixel_rows_any(&grid, 255, 2));
+
+    /* Removing an image leaves its rows until the next rebuild */
+    tll_pop_front(grid.sixel_images);
+    xassert(grid_sixel_row(&grid, 250));
+    grid_sixel_rows_rebuild(&grid);
+    xassert(!grid_sixel_row(&grid, 250));
+    xassert(grid_sixel_row(&grid, 129));
+
+    /* Invalidating falls back to the list, until rows are added */
+    grid_sixel_rows_invalidate(&grid);
+    xassert(grid_sixel_row(&grid, 0));
+    grid_sixel_rows_add(&grid, 0, 1);
+    xassert(grid_sixel_row(&grid, 0));
+    xassert(grid_sixel_row(&grid, 128));
+    xassert(!grid_sixel_row(&grid, 1));
+
+    grid_sixel_rows_invalidate(&grid);
+    tll_free(grid.sixel_images);
+}
@@ -11,15 +11,100 @@ void grid_swap_row(struct grid *grid, int row_a, int row_b);
 struct row *grid_row_alloc(int cols, bool initialize);
 void grid_row_free(struct row *row);
 
+/*
+ * Compresses a (cold scrollback) row's cells. Returns false, and
+ * leaves the row untouched, if it doesn't compress well.
+ */
+bool grid_row_pack(struct row *row, int cols);
+void grid_row_unpack(struct row *row);
+
+/*
+ * Frees the cell arrays kept around for re-use by grid_row_alloc()
+ * and grid_row_unpack().
+ */
+void grid_cell_cache_flush(void);
+
+/* Decodes a packed row into 'cells', without unpacking the row itself */
+void grid_row_unpack_into(const struct row *row, struct cell *cells, int cols);
+
+/*
+ * The encoding used by packed rows. 'buf' must be at least
+ * grid_cells_encode_max_size() bytes.
+ */
+size_t grid_cells_encode_max_size(int cols);
+size_t grid_cells_encode(const struct cell *cells, int cols, uint8_t *buf);
+void grid_cells_decode(
+    const uint8_t *data, size_t size, struct cell *cells, int cols);
+
+/* Encodes a row's cells, regardless of whether it's packed or not */
+size_t grid_row_encode(const struct row *row, int cols, uint8_t *buf);
+
+/* Use when accessing rows that may be in the cold scrollback */
+static inline struct row *
+grid_row_unpacked(struct row *row)
+{
+    if (unlikely(row != NULL && row->packed != NULL))
+        grid_row_unpack(row);
+    return row;
+}
+
 void grid_resize_without_reflow(
     struct grid *grid, int new_rows, int new_cols,
     int old_screen_rows, int new_screen_rows);
 
+/*
+ * Rows that no longer fit in the scrollback are written to 'spill'
+ * (may be NULL), oldest first.
+ *
+ * Note: a large scrollback is only partially reflowed; the oldest rows
+ * are left in grid->reflow_pending, and must be reflowed with
+ * grid_reflow_pending().
+ */
 void grid_resize_and_reflow(
     struct grid *grid, int new_rows, int new_cols,
     int old_screen_rows, int new_screen_rows,
     size_t tracking_points_count,
-    struct coord *const _tracking_points[static tracking_points_count]);
+    struct coord *const _tracking_points[static tracking_points_count],
+    struct scrollback_spill *spill);
+
+/*
+ * Reflows (at least) 'max_rows' rows of the scrollback that was
+ * deferred by grid_resize_and_reflow(), and prepends them to the
+ * scrollback. Returns the number of rows added.
+ */
+int grid_reflow_pending(struct grid *grid, int screen_rows, int max_rows,
+                        struct scrollback_spill *spill);
+void grid_reflow_pending_discard(
+    struct grid *grid, struct scrollback_spill *spill);
+
+static inline bool
+grid_reflow_is_pending(const struct grid *grid)
+{
+    return tll_length(grid->reflow_pending) > 0;
+}
+
+/*
+ * Index of the rows covered by sixel images, letting e.g. the print
+ * path skip searching the image list for rows without any images.
+ *
+ * Rows are added when images are added, but only cleared by a
+ * rebuild. Anything that moves images, or changes the number of grid
+ * rows, must invalidate the index.
+ */
+void grid_sixel_rows_add(struct grid *grid, int abs_row, int count);
+void grid_sixel_rows_rebuild(struct grid *grid);
+void grid_sixel_rows_invalidate(struct grid *grid);
+bool grid_sixel_rows_any(const struct grid *grid, int abs_row, int count);
+
+/* True if the row *may* have a sixel image */
+static inline bool
+grid_sixel_row(const struct grid *grid, int abs_row)
+{
+    if (unlikely(grid->sixel_rows == NULL))
+        return tll_length(grid->sixel_images) > 0;
+
+    return (grid->sixel_rows[abs_row / 64] >> (abs_row % 64)) & 1;
+}
 
 /* Convert row numbers between scrollback-relative and absolute coordinates */
 int grid_row_abs_to_sb(const struct grid *grid, int screen_rows, int abs_row);
@@ -57,7 +142,7 @@ _grid_row_maybe_alloc(struct grid *grid, int row_no, bool alloc_if_null)
     }
 
     xassert(row != NULL);
-    return row;
+    return grid_row_unpacked(row);
 }
 
 static inline struct row *
@@ -81,7 +166,7 @@ grid_row_in_view(struct grid *grid, int row_no)
     struct row *row = grid->rows[real_row];
 
     xassert(row != NULL);
-    return row;
+    return grid_row_unpacked(row);
 }
 
 void grid_row_uri_range_put(
@@ -257,6 +257,7 @@ execute_binding(struct seat *seat, struct terminal *term,
         bool success;
         switch (action) {
         case BIND_ACTION_PIPE_SCROLLBACK:
+            term_reflow_pending_finish(term);
             success = term_scrollback_to_text(term, &text, &len);
             break;
 
@@ -271,6 +272,7 @@ execute_binding(struct seat *seat, struct terminal *term,
             break;
 
         case BIND_ACTION_PIPE_COMMAND_OUTPUT:
+            term_reflow_pending_finish(term);
             success = term_command_output_to_text(term, &text, &len);
             break;
 
@@ -364,6 +366,8 @@ execute_binding(struct seat *seat, struct terminal *term,
         if (term->grid != &term->normal)
             return false;
 
+        term_reflow_pending_finish(term);
+
         struct grid *grid = term->grid;
         const int sb_start =
             grid_sb_start_ignore_uninitialized(grid, term->rows);
@@ -1684,6 +1688,9 @@ key_press_release(struct seat *seat, struct terminal *term, uint32_t serial,
     if (handled && !keysym_is_modifier(sym)) {
         term_reset_view(term);
         selection_cancel(term);
+
+        if (pressed)
+            render_latency_key_pressed(term);
     }
 
     free(utf32);
@@ -46,6 +46,16 @@ fdm_sigint(struct fdm *fdm, int signo, void *data)
     return true;
 }
 
+static bool
+fdm_sigusr1(struct fdm *fdm, int signo, void *data)
+{
+    const struct wayland *wayl = data;
+
+    tll_foreach(wayl->terms, it)
+        render_latency_log(it->item);
+    return true;
+}
+
 static const char *
 version_and_features(void)
 {
@@ -619,7 +629,8 @@ main(int argc, char *const *argv)
 
     volatile sig_atomic_t aborted = false;
     if (!fdm_signal_add(fdm, SIGINT, &fdm_sigint, (void *)&aborted) ||
-        !fdm_signal_add(fdm, SIGTERM, &fdm_sigint, (void *)&aborted))
+        !fdm_signal_add(fdm, SIGTERM, &fdm_sigint, (void *)&aborted) ||
+        !fdm_signal_add(fdm, SIGUSR1, &fdm_sigusr1, wayl))
     {
         goto out;
     }
@@ -659,6 +670,7 @@ out:
     wayl_destroy(wayl);
     key_binding_manager_destroy(key_binding_manager);
     reaper_destroy(reaper);
+    fdm_signal_del(fdm, SIGUSR1);
     fdm_signal_del(fdm, SIGTERM);
     fdm_signal_del(fdm, SIGINT);
     fdm_destroy(fdm);
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <getopt.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,13 +13,28 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 
+#include <pixman.h>
+#include <fcft/fcft.h>
+
 #include "async.h"
 #include "config.h"
+#include "default-colors.h"
+#include "glyph-tiles.h"
+#include "grid.h"
+#include "ime.h"
 #include "key-binding.h"
+#include "pty-record.h"
+#include "quirks.h"
 #include "reaper.h"
+#include "render.h"
+#include "search.h"
+#include "shm.h"
 #include "sixel.h"
+#include "stride.h"
 #include "user-notification.h"
+#include "util.h"
 #include "vt.h"
+#include "xmalloc.h"
 
 extern bool fdm_ptmx(struct fdm *fdm, int fd, int events, void *data);
 
@@ -25,16 +42,316 @@ static void
 usage(const char *prog_name)
 {
     printf(
-        "Usage: %s stimuli-file1 stimuli-file2 ... stimuli-fileN\n",
+        "Usage: %s [OPTIONS...] stimuli-file1 stimuli-file2 ... stimuli-fileN\n"
+        "\n"
+        "Options:\n"
+        "  -i,--iterations=COUNT        feed each file COUNT times (1)\n"
+        "  -r,--render                  render a frame, offscreen, after each read\n"
+        "  -f,--font=NAME               font to render with (monospace)\n"
+        "  -w,--workers=COUNT           number of render worker threads (0)\n"
+        "  -h,--help                    show this help and exit\n",
         prog_name);
 }
 
+static double
+elapsed(const struct timespec *start, const struct timespec *stop)
+{
+    return (stop->tv_sec - start->tv_sec) +
+        (stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int
+double_cmp(const void *_a, const void *_b)
+{
+    const double a = *(const double *)_a;
+    const double b = *(const double *)_b;
+    return a < b ? -1 : a > b;
+}
+
+/*
+ * Offscreen rendering (--render). A frame is rendered after each read
+ * from the PTY; i.e. as often as foot would, if the compositor never
+ * throttled it.
+ */
+struct render_bench {
+    struct buffer buf;
+
+    double *times;   /* Render time, per frame */
+    size_t count;
+    size_t size;
+};
+
+static bool
+render_bench_init(struct render_bench *bench, struct terminal *term,
+                  const char *font_name, uint16_t workers)
+{
+    static const char *const attrs[4] = {
+        "dpi=96",
+        "dpi=96:weight=bold",
+        "dpi=96:slant=italic",
+        "dpi=96:weight=bold:slant=italic",
+    };
+
+    for (size_t i = 0; i < 4; i++) {
+        term->fonts[i] = fcft_from_name(1, &font_name, attrs[i]);
+        if (term->fonts[i] == NULL) {
+            fprintf(stderr, "error: %s: failed to load font\n", font_name);
+            goto err;
+        }
+    }
+
+    /* Like term_set_fonts() */
+    const struct fcft_font *font = term->fonts[0];
+    const struct fcft_glyph *M = fcft_rasterize_char_utf32(
+        term->fonts[0], U'M', term->font_subpixel);
+
+    term->cell_width = max(M != NULL ? M->advance.x : font->max_advance.x, 1);
+    term->cell_height = max(max(font->height, font->ascent + font->descent), 1);
+    term->font_line_height.px = -1;
+    term->font_baseline = term_font_baseline(term);
+    term->width = term->cols * term->cell_width;
+    term->height = term->rows * term->cell_height;
+
+    if (mtx_init(&term->render.workers.lock, mtx_plain) != thrd_success) {
+        fprintf(stderr, "error: failed to instantiate render mutex\n");
+        goto err;
+    }
+
+    if (workers > 0) {
+        if (!render_workers_ref(workers)) {
+            mtx_destroy(&term->render.workers.lock);
+            goto err;
+        }
+        term->render.workers.count = workers;
+        term->render.workers.pool_ref = true;
+    }
+
+    term->render.glyph_tiles = glyph_tiles_init();
+
+    /* Like shm_get_buffer(); one image, and damage region, per thread */
+    const size_t instances = workers + 1;
+    const pixman_format_code_t fmt = PIXMAN_x8r8g8b8;
+    const int stride = stride_for_format_and_width(fmt, term->width);
+
+    *bench = (struct render_bench){
+        .buf = {
+            .width = term->width,
+            .height = term->height,
+            .stride = stride,
+            .data = calloc(term->height, stride),
+            .pix = calloc(instances, sizeof(bench->buf.pix[0])),
+            .pix_instances = instances,
+            .dirty = calloc(instances, sizeof(bench->buf.dirty[0])),
+        },
+    };
+
+    for (size_t i = 0; i < instances; i++) {
+        bench->buf.pix[i] = pixman_image_create_bits_no_clear(
+            fmt, term->width, term->height, bench->buf.data, stride);
+        pixman_region32_init(&bench->buf.dirty[i]);
+    }
+
+    printf("Rendering offscreen with %s (%dx%d px cells, %dx%d px), "
+           "%hu worker thread(s)\n",
+           font_name, term->cell_width, term->cell_height,
+           term->width, term->height, workers);
+    return true;
+
+err:
+    for (size_t i = 0; i < 4; i++) {
+        fcft_destroy(term->fonts[i]);
+        term->fonts[i] = NULL;
+    }
+    return false;
+}
+
+static void
+render_bench_destroy(struct render_bench *bench, struct terminal *term)
+{
+    for (size_t i = 0; i < bench->buf.pix_instances; i++) {
+        pixman_image_unref(bench->buf.pix[i]);
+        pixman_region32_fini(&bench->buf.dirty[i]);
+    }
+
+    free(bench->buf.pix);
+    free(bench->buf.dirty);
+    free(bench->buf.data);
+    free(bench->times);
+
+    glyph_tiles_destroy(term->render.glyph_tiles);
+
+    if (term->render.workers.pool_ref)
+        render_workers_unref();
+    mtx_destroy(&term->render.workers.lock);
+
+    for (size_t i = 0; i < 4; i++)
+        fcft_destroy(term->fonts[i]);
+}
+
+/* Renders a frame, and returns the time it took */
+static double
+render_bench_frame(struct render_bench *bench, struct terminal *term)
+{
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    render_grid_offscreen(term, &bench->buf);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    /* The damage is never consumed; don't let it accumulate */
+    for (size_t i = 0; i < bench->buf.pix_instances; i++)
+        pixman_region32_clear(&bench->buf.dirty[i]);
+
+    if (bench->count >= bench->size) {
+        bench->size = bench->size > 0 ? bench->size * 2 : 1024;
+        bench->times = realloc(
+            bench->times, bench->size * sizeof(bench->times[0]));
+
+        if (bench->times == NULL) {
+            fprintf(stderr, "error: failed to allocate buffer: %s\n",
+                    strerror(errno));
+            abort();
+        }
+    }
+
+    const double secs = elapsed(&start, &stop);
+    bench->times[bench->count++] = secs;
+    return secs;
+}
+
+/* Prints, and resets, the render statistics */
+static void
+render_bench_report(struct render_bench *bench, int iterations,
+                    double parse_total)
+{
+    if (bench->count == 0)
+        return;
+
+    double total = 0.;
+    for (size_t i = 0; i < bench->count; i++)
+        total += bench->times[i];
+
+    qsort(bench->times, bench->count, sizeof(bench->times[0]), &double_cmp);
+
+    const size_t n = bench->count;
+    printf("  render: %.3fms average, %zu frames per iteration, "
+           "%.1f frames/s (%.1f frames/s including parsing)\n"
+           "  per frame: p50=%.1fus p95=%.1fus p99=%.1fus max=%.1fus\n",
+           total / iterations * 1e3, n / iterations,
+           total > 0. ? n / total : 0.,
+           total + parse_total > 0. ? n / (total + parse_total) : 0.,
+           bench->times[(n - 1) * 50 / 100] * 1e6,
+           bench->times[(n - 1) * 95 / 100] * 1e6,
+           bench->times[(n - 1) * 99 / 100] * 1e6,
+           bench->times[n - 1] * 1e6);
+
+    bench->count = 0;
+}
+
+/*
+ * Feeds a PTY recording (tweak.pty-record) to the VT parser, one
+ * recorded read at a time, and prints the distribution of the time
+ * spent parsing each one.
+ *
+ * The recorded pacing is not reproduced, since there's no renderer
+ * here to compete with. Window size changes are ignored as well.
+ */
+static bool
+replay_recording(struct terminal *term, struct render_bench *render,
+                 const char *name, const uint8_t *data, size_t size,
+                 int iterations)
+{
+    const uint8_t *const end = data + size;
+    const uint8_t *p = data + strlen(PTY_RECORD_MAGIC);
+    struct pty_record_event ev;
+
+    size_t chunks = 0;
+    size_t bytes = 0;
+    size_t resizes = 0;
+    uint64_t duration_ns = 0;
+
+    while (pty_record_next(&p, end, &ev)) {
+        if (ev.type == PTY_RECORD_DATA) {
+            chunks++;
+            bytes += ev.len;
+        } else
+            resizes++;
+        duration_ns = ev.time_ns;
+    }
+
+    printf("Replaying %s (%zu chunks, %zu bytes, %.3fs, "
+           "%zu window size changes ignored)\n",
+           name, chunks, bytes, duration_ns / 1e9, resizes);
+
+    if (chunks == 0)
+        return true;
+
+    double *times = malloc(chunks * iterations * sizeof(times[0]));
+    if (times == NULL) {
+        fprintf(stderr, "error: failed to allocate buffer: %s\n",
+                strerror(errno));
+        return false;
+    }
+
+    size_t count = 0;
+    double total = 0.;
+
+    for (int i = 0; i < iterations; i++) {
+        p = data + strlen(PTY_RECORD_MAGIC);
+
+        while (pty_record_next(&p, end, &ev)) {
+            if (ev.type != PTY_RECORD_DATA)
+                continue;
+
+            struct timespec start, stop;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            vt_from_slave(term, ev.data, ev.len);
+            clock_gettime(CLOCK_MONOTONIC, &stop);
+
+            times[count++] = elapsed(&start, &stop);
+            total += times[count - 1];
+
+            if (render != NULL)
+                render_bench_frame(render, term);
+        }
+    }
+
+    qsort(times, count, sizeof(times[0]), &double_cmp);
+
+    printf("  %d iteration(s): %.3fms average (%.2f MiB/s)\n"
+           "  per chunk: p50=%.1fus p95=%.1fus p99=%.1fus max=%.1fus\n",
+           iterations, total / iterations * 1e3,
+           total > 0. ? bytes * iterations / (1024. * 1024.) / total : 0.,
+           times[(count - 1) * 50 / 100] * 1e6,
+           times[(count - 1) * 95 / 100] * 1e6,
+           times[(count - 1) * 99 / 100] * 1e6,
+           times[count - 1] * 1e6);
+
+    if (render != NULL)
+        render_bench_report(render, iterations, total);
+
+    free(times);
+    return true;
+}
+
 enum async_write_status
 async_write(int fd, const void *data, size_t len, size_t *idx)
 {
     return ASYNC_WRITE_DONE;
 }
 
+struct fdm *
+fdm_init(void)
+{
+    /* Never dereferenced; the other fdm stubs ignore it */
+    return xmalloc(1);
+}
+
+void
+fdm_destroy(struct fdm *fdm)
+{
+    free(fdm);
+}
+
 bool
 fdm_add(struct fdm *fdm, int fd, int events, fdm_fd_handler_t handler, void *data)
 {
@@ -48,37 +365,32 @@ fdm_del(struct fdm *fdm, int fd)
 }
 
 bool
-fdm_event_add(struct fdm *fdm, int fd, int events)
+fdm_del_no_close(struct fdm *fdm, int fd)
 {
     return true;
 }
 
 bool
-fdm_event_del(struct fdm *fdm, int fd, int events)
+fdm_event_add(struct fdm *fdm, int fd, int events)
 {
     return true;
 }
 
 bool
-render_resize(
-    struct terminal *term, int width, int height, uint8_t resize_options)
+fdm_event_del(struct fdm *fdm, int fd, int events)
 {
     return true;
 }
 
-void render_refresh(struct terminal *term) {}
-void render_refresh_csd(struct terminal *term) {}
-void render_refresh_title(struct terminal *term) {}
-void render_refresh_app_id(struct terminal *term) {}
-
 bool
-render_xcursor_is_valid(const struct seat *seat, const char *cursor)
+fdm_hook_add(struct fdm *fdm, fdm_hook_t hook, void *data,
+             enum fdm_hook_priority priority)
 {
     return true;
 }
 
 bool
-render_xcursor_set(struct seat *seat, struct terminal *term, enum cursor_shape shape)
+fdm_hook_del(struct fdm *fdm, fdm_hook_t hook, enum fdm_hook_priority priority)
 {
     return true;
 }
@@ -99,6 +411,52 @@ void wayl_win_destroy(struct wl_window *win) {}
 void wayl_win_alpha_changed(struct wl_window *win) {}
 bool wayl_win_set_urgent(struct wl_window *win) { return true; }
 bool wayl_fractional_scaling(const struct wayland *wayl) { return true; }
+bool wayl_win_csd_titlebar_visible(const struct wl_window *win) { return false; }
+bool wayl_win_csd_borders_visible(const struct wl_window *win) { return false; }
+void wayl_win_scale(struct wl_window *win, const struct buffer *buf) {}
+
+void
+wayl_surface_scale(
+    const struct wl_window *win, const struct wayl_surface *surf,
+    const struct buffer *buf, float scale)
+{
+}
+
+void
+wayl_surface_scale_explicit_width_height(
+    const struct wl_window *win, const struct wayl_surface *surf,
+    int width, int height, float scale)
+{
+}
+
+bool
+wayl_win_subsurface_new(
+    struct wl_window *win, struct wayl_sub_surface *surf,
+    bool allow_pointer_input)
+{
+    return false;
+}
+
+void wayl_win_subsurface_destroy(struct wayl_sub_surface *surf) {}
+
+/*
+ * There's no compositor. Protocol requests, e.g. xdg_toplevel's
+ * set_title and set_app_id (static inline wrappers, generated by
+ * wayland-scanner), end up here, and are dropped.
+ */
+struct wl_proxy *
+wl_proxy_marshal_flags(struct wl_proxy *proxy, uint32_t opcode,
+                       const struct wl_interface *interface,
+                       uint32_t version, uint32_t flags, ...)
+{
+    return NULL;
+}
+
+uint32_t
+wl_proxy_get_version(struct wl_proxy *proxy)
+{
+    return 0;
+}
 
 pid_t
 spawn(struct reaper *reaper, const char *cwd, char *const argv[],
@@ -118,12 +476,6 @@ slave_spawn(
     return 0;
 }
 
-int
-render_worker_thread(void *_ctx)
-{
-    return 0;
-}
-
 struct extraction_context *
 extract_begin(enum selection_kind kind, bool strip_trailing_empty)
 {
@@ -138,6 +490,14 @@ extract_one(
     return true;
 }
 
+bool
+extract_one_composed(
+    const struct terminal *term, const struct row *row, const struct cell *cell,
+    int col, const struct composed *composed, void *context)
+{
+    return true;
+}
+
 bool
 extract_finish(struct extraction_context *context, char **text, size_t *len)
 {
@@ -150,6 +510,13 @@ void cmd_scrollback_down(struct terminal *term, int rows) {}
 void ime_enable(struct seat *seat) {}
 void ime_disable(struct seat *seat) {}
 void ime_reset_preedit(struct seat *seat) {}
+void ime_update_cursor_rect(struct seat *seat) {}
+
+void quirk_weston_subsurface_desync_on(struct wl_subsurface *sub) {}
+void quirk_weston_subsurface_desync_off(struct wl_subsurface *sub) {}
+void quirk_weston_csd_on(struct terminal *term) {}
+void quirk_weston_csd_off(struct terminal *term) {}
+void quirk_sway_subsurface_unmap(struct terminal *term) {}
 
 bool
 notify_notify(struct terminal *term, struct notification *notif)
@@ -189,8 +556,34 @@ void reaper_del(struct reaper *reaper, pid_t pid) {}
 
 void urls_reset(struct terminal *term) {}
 
+void shm_addref(struct buffer *buf) {}
 void shm_unref(struct buffer *buf) {}
+void shm_did_not_use_buf(struct buffer *buf) {}
 void shm_chain_free(struct buffer_chain *chain) {}
+bool shm_can_scroll(const struct buffer *buf) { return false; }
+
+bool
+shm_scroll(struct buffer *buf, int rows,
+           int top_margin, int top_keep_rows,
+           int bottom_margin, int bottom_keep_rows)
+{
+    return false;
+}
+
+struct buffer *
+shm_get_buffer(
+    struct buffer_chain *chain, int width, int height, bool with_alpha)
+{
+    return NULL;
+}
+
+void
+shm_get_many(
+    struct buffer_chain *chain, size_t count,
+    int widths[static count], int heights[static count],
+    struct buffer *bufs[static count], bool with_alpha)
+{
+}
 
 struct buffer_chain *
 shm_chain_new(struct wl_shm *shm, bool scrollable, size_t pix_instances)
@@ -201,6 +594,18 @@ shm_chain_new(struct wl_shm *shm, bool scrollable, size_t pix_instances)
 
 void search_selection_cancelled(struct terminal *term) {}
 
+struct search_match_iterator
+search_matches_new_iter(struct terminal *term)
+{
+    return (struct search_match_iterator){.term = term};
+}
+
+struct range
+search_matches_next(struct search_match_iterator *iter)
+{
+    return (struct range){{-1, -1}, {-1, -1}};
+}
+
 void get_current_modifiers(const struct seat *seat,
                            xkb_mod_mask_t *effective,
                            xkb_mod_mask_t *consumed, uint32_t key,
@@ -240,10 +645,75 @@ key_binding_unref(struct key_binding_manager *mgr, const struct config *conf)
 }
 
 int
-main(int argc, const char *const *argv)
+main(int argc, char *const *argv)
 {
-    if (argc < 2) {
-        usage(argv[0]);
+    static const struct option longopts[] = {
+        {"iterations", required_argument, NULL, 'i'},
+        {"render",     no_argument,       NULL, 'r'},
+        {"font",       required_argument, NULL, 'f'},
+        {"workers",    required_argument, NULL, 'w'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL,         no_argument,       NULL,   0},
+    };
+
+    const char *const prog_name = argv[0];
+    int iterations = 1;
+    bool render = false;
+    const char *font_name = "monospace";
+    uint16_t workers = 0;
+
+    while (true) {
+        int c = getopt_long(argc, argv, "+i:rf:w:h", longopts, NULL);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'i': {
+            char *end;
+            errno = 0;
+            long v = strtol(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || v <= 0 || v > INT32_MAX) {
+                fprintf(stderr, "error: %s: invalid iteration count\n", optarg);
+                return EXIT_FAILURE;
+            }
+            iterations = v;
+            break;
+        }
+
+        case 'r':
+            render = true;
+            break;
+
+        case 'f':
+            font_name = optarg;
+            break;
+
+        case 'w': {
+            char *end;
+            errno = 0;
+            long v = strtol(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || v < 0 || v > 1024) {
+                fprintf(stderr, "error: %s: invalid worker count\n", optarg);
+                return EXIT_FAILURE;
+            }
+            workers = v;
+            break;
+        }
+
+        case 'h':
+            usage(prog_name);
+            return EXIT_SUCCESS;
+
+        case '?':
+            return EXIT_FAILURE;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(prog_name);
         return EXIT_FAILURE;
     }
 
@@ -265,16 +735,22 @@ main(int argc, const char *const *argv)
     struct row **alt_rows = calloc(grid_row_count, sizeof(alt_rows[0]));
 
     for (int i = 0; i < grid_row_count; i++) {
-        normal_rows[i] = calloc(1, sizeof(*normal_rows[i]));
-        normal_rows[i]->cells = calloc(col_count, sizeof(normal_rows[i]->cells[0]));
-        alt_rows[i] = calloc(1, sizeof(*alt_rows[i]));
-        alt_rows[i]->cells = calloc(col_count, sizeof(alt_rows[i]->cells[0]));
+        normal_rows[i] = grid_row_alloc(col_count, true);
+        alt_rows[i] = grid_row_alloc(col_count, true);
     }
 
     struct config conf = {
+        .underline_thickness = {.pt = 0., .px = -1},
+        .cursor = {
+            .beam_thickness = {.pt = 1.5},
+            .underline_thickness = {.pt = 0., .px = -1},
+        },
         .tweak = {
             .delayed_render_lower_ns = 500000,         /* 0.5ms */
             .delayed_render_upper_ns = 16666666 / 2,   /* half a frame period (60Hz) */
+            .overflowing_glyphs = true,
+            .box_drawing_base_thickness = 0.04,
+            .box_drawing_solid_shades = true,
         },
     };
 
@@ -284,9 +760,15 @@ main(int argc, const char *const *argv)
         .terms = tll_init(),
     };
 
+    /* Never configured, and without a toplevel; render.c's refresh
+     * and resize functions are no-ops, and Wayland requests are
+     * dropped (see wl_proxy_marshal_flags() above) */
+    struct wl_window window = {0};
+
     struct terminal term = {
         .conf = &conf,
         .wl = &wayl,
+        .window = &window,
         .grid = &term.normal,
         .normal = {
             .num_rows = grid_row_count,
@@ -307,6 +789,11 @@ main(int argc, const char *const *argv)
         .rows = row_count,
         .cell_width = 8,
         .cell_height = 15,
+        .colors = {
+            .fg = default_foreground,
+            .bg = default_background,
+            .alpha = 0xffff,
+        },
         .scroll_region = {
             .start = 0,
             .end = row_count,
@@ -328,11 +815,23 @@ main(int argc, const char *const *argv)
         },
     };
 
+    memcpy(term.colors.table, default_color_table, sizeof(default_color_table));
     tll_push_back(wayl.terms, &term);
 
     int ret = EXIT_FAILURE;
 
-    for (int i = 1; i < argc; i++) {
+    struct render_bench render_bench = {0};
+    if (render) {
+        fcft_init(FCFT_LOG_COLORIZE_AUTO, false, FCFT_LOG_CLASS_ERROR);
+
+        if (!render_bench_init(&render_bench, &term, font_name, workers)) {
+            fcft_fini();
+            render = false;
+            goto out;
+        }
+    }
+
+    for (int i = 0; i < argc; i++) {
         struct stat st;
         if (stat(argv[i], &st) < 0) {
             fprintf(stderr, "error: %s: failed to stat: %s\n",
@@ -347,7 +846,7 @@ main(int argc, const char *const *argv)
             goto out;
         }
 
-        int fd = open(argv[1], O_RDONLY);
+        int fd = open(argv[i], O_RDONLY);
         if (fd < 0) {
             fprintf(stderr, "error: %s: failed to open: %s\n",
                     argv[i], strerror(errno));
@@ -363,6 +862,17 @@ main(int argc, const char *const *argv)
 
         close(fd);
 
+        if (pty_record_is_recording(data, st.st_size)) {
+            bool ok = replay_recording(
+                &term, render ? &render_bench : NULL,
+                argv[i], data, st.st_size, iterations);
+            free(data);
+
+            if (!ok)
+                goto out;
+            continue;
+        }
+
 #if defined(MEMFD_CREATE)
         int mem_fd = memfd_create("foot-pgo-ptmx", MFD_CLOEXEC);
 #elif defined(__FreeBSD__)
@@ -387,34 +897,68 @@ main(int argc, const char *const *argv)
         free(data);
 
         term.ptmx = mem_fd;
-        lseek(mem_fd, 0, SEEK_SET);
 
         printf("Feeding VT parser with %s (%lld bytes)\n",
                argv[i], (long long)st.st_size);
 
-        while (lseek(mem_fd, 0, SEEK_CUR) < st.st_size) {
-            if (!fdm_ptmx(NULL, -1, EPOLLIN, &term)) {
-                fprintf(stderr, "error: fdm_ptmx() failed\n");
-                close(mem_fd);
-                goto out;
+        double best = -1.;
+        double total = 0.;
+
+        for (int j = 0; j < iterations; j++) {
+            lseek(mem_fd, 0, SEEK_SET);
+
+            struct timespec start, stop;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            double render_secs = 0.;
+
+            while (lseek(mem_fd, 0, SEEK_CUR) < st.st_size) {
+                if (!fdm_ptmx(NULL, -1, EPOLLIN, &term)) {
+                    fprintf(stderr, "error: fdm_ptmx() failed\n");
+                    close(mem_fd);
+                    goto out;
+                }
+
+                if (render)
+                    render_secs += render_bench_frame(&render_bench, &term);
             }
+
+            clock_gettime(CLOCK_MONOTONIC, &stop);
+
+            /* Parsing only */
+            const double secs = elapsed(&start, &stop) - render_secs;
+            total += secs;
+            if (best < 0. || secs < best)
+                best = secs;
         }
+
         close(mem_fd);
+
+        const double mib = st.st_size / (1024. * 1024.);
+        printf("  %d iteration(s): %.3fms average, %.3fms best "
+               "(%.2f MiB/s average, %.2f MiB/s best)\n",
+               iterations,
+               total / iterations * 1e3, best * 1e3,
+               total > 0. ? mib * iterations / total : 0.,
+               best > 0. ? mib / best : 0.);
+
+        if (render)
+            render_bench_report(&render_bench, iterations, total);
     }
 
     ret = EXIT_SUCCESS;
 
 out:
+    if (render) {
+        render_bench_destroy(&render_bench, &term);
+        fcft_fini();
+    }
+
     tll_free(wayl.terms);
 
     for (int i = 0; i < grid_row_count; i++) {
-        if (normal_rows[i] != NULL)
-            free(normal_rows[i]->cells);
-        free(normal_rows[i]);
-
-        if (alt_rows[i] != NULL)
-            free(alt_rows[i]->cells);
-        free(alt_rows[i]);
+        grid_row_free(normal_rows[i]);
+        grid_row_free(alt_rows[i]);
     }
 
     free(normal_rows);
@@ -0,0 +1,274 @@
+#include "ptmx-reader.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+#include "macros.h"
+#if HAS_INCLUDE(<pthread_np.h>)
+#include <pthread_np.h>
+#define pthread_setname_np(thread, name) (pthread_set_name_np(thread, name), 0)
+#elif defined(__NetBSD__)
+#define pthread_setname_np(thread, name) pthread_setname_np(thread, "%s", (void *)name)
+#endif
+
+#define LOG_MODULE "ptmx-reader"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "debug.h"
+#include "util.h"
+#include "xmalloc.h"
+
+struct ptmx_reader {
+    int ptmx;
+
+    int data_fd;   /* Signaled by the reader thread: data added, or EOF */
+    int space_fd;  /* Signaled by the consumer: space freed, or quit */
+
+    thrd_t thread;
+    bool thread_started;
+
+    uint8_t *ring;
+    size_t size;
+
+    /* Free running indices; masked with (size - 1) when accessing 'ring' */
+    atomic_size_t head;  /* Only written by the reader thread */
+    atomic_size_t tail;  /* Only written by the consumer */
+
+    atomic_bool waiting_for_space;
+    atomic_bool eof;
+    atomic_bool quit;
+};
+
+static void
+signal_fd(int fd)
+{
+    if (write(fd, &(uint64_t){1}, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        /* EAGAIN means the counter is saturated - it's readable anyway */
+        if (errno != EAGAIN)
+            LOG_ERRNO("failed to signal event FD");
+    }
+}
+
+static void
+drain_fd(int fd)
+{
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        LOG_ERRNO("failed to read event FD");
+}
+
+static int
+reader_thread(void *data)
+{
+    struct ptmx_reader *reader = data;
+
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+    if (pthread_setname_np(pthread_self(), "foot:ptmx") < 0)
+        LOG_ERRNO("ptmx reader: failed to set process title");
+
+    const size_t size = reader->size;
+
+    while (!atomic_load(&reader->quit)) {
+        const size_t head = atomic_load_explicit(&reader->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&reader->tail, memory_order_acquire);
+
+        bool full = head - tail == size;
+
+        if (full) {
+            /*
+             * Announce that we're waiting for space, then re-check,
+             * in case the consumer freed up space before it could
+             * see our flag.
+             */
+            atomic_store(&reader->waiting_for_space, true);
+            tail = atomic_load(&reader->tail);
+            full = head - tail == size;
+
+            if (!full)
+                atomic_store(&reader->waiting_for_space, false);
+        }
+
+        struct pollfd fds[] = {
+            {.fd = reader->space_fd, .events = POLLIN},
+            {.fd = reader->ptmx, .events = POLLIN},
+        };
+
+        /* When the ring buffer is full, don't poll the PTY */
+        if (poll(fds, full ? 1 : 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERRNO("failed to poll pseudo terminal");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            drain_fd(reader->space_fd);
+            atomic_store(&reader->waiting_for_space, false);
+        }
+
+        if (full || fds[1].revents == 0)
+            continue;
+
+        const size_t idx = head & (size - 1);
+        const size_t space = min(size - (head - tail), size - idx);
+
+        ssize_t count = read(reader->ptmx, &reader->ring[idx], space);
+
+        if (count < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+
+            /* EIO: assume PTY was closed */
+            if (errno != EIO)
+                LOG_ERRNO("failed to read from pseudo terminal");
+            break;
+        } else if (count == 0) {
+            /* Reached end-of-file */
+            break;
+        }
+
+        atomic_store_explicit(&reader->head, head + count, memory_order_release);
+        signal_fd(reader->data_fd);
+    }
+
+    atomic_store_explicit(&reader->eof, true, memory_order_release);
+    signal_fd(reader->data_fd);
+    return 0;
+}
+
+struct ptmx_reader *
+ptmx_reader_init(int ptmx, size_t size)
+{
+    xassert(size > 0 && (size & (size - 1)) == 0);
+
+    int data_fd = -1;
+    int space_fd = -1;
+
+    if ((data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0 ||
+        (space_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+    {
+        LOG_ERRNO("failed to create ptmx reader event FDs");
+        goto err;
+    }
+
+    struct ptmx_reader *reader = xmalloc(sizeof(*reader));
+    *reader = (struct ptmx_reader){
+        .ptmx = ptmx,
+        .data_fd = data_fd,
+        .space_fd = space_fd,
+        .ring = xmalloc(size),
+        .size = size,
+    };
+
+    atomic_init(&reader->head, 0);
+    atomic_init(&reader->tail, 0);
+    atomic_init(&reader->waiting_for_space, false);
+    atomic_init(&reader->eof, false);
+    atomic_init(&reader->quit, false);
+
+    int ret = thrd_create(&reader->thread, &reader_thread, reader);
+    if (ret != thrd_success) {
+        LOG_ERR("failed to create ptmx reader thread: %s (%d)",
+                thrd_err_as_string(ret), ret);
+        ptmx_reader_destroy(reader);
+        return NULL;
+    }
+
+    reader->thread_started = true;
+    return reader;
+
+err:
+    if (data_fd >= 0)
+        close(data_fd);
+    if (space_fd >= 0)
+        close(space_fd);
+    return NULL;
+}
+
+void
+ptmx_reader_destroy(struct ptmx_reader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    if (reader->thread_started) {
+        atomic_store(&reader->quit, true);
+        signal_fd(reader->space_fd);
+
+        int ret;
+        thrd_join(reader->thread, &ret);
+    }
+
+    close(reader->data_fd);
+    close(reader->space_fd);
+    free(reader->ring);
+    free(reader);
+}
+
+int
+ptmx_reader_fd(const struct ptmx_reader *reader)
+{
+    return reader->data_fd;
+}
+
+void
+ptmx_reader_ack(struct ptmx_reader *reader)
+{
+    drain_fd(reader->data_fd);
+}
+
+void
+ptmx_reader_kick(struct ptmx_reader *reader)
+{
+    signal_fd(reader->data_fd);
+}
+
+const uint8_t *
+ptmx_reader_peek(struct ptmx_reader *reader, size_t *len)
+{
+    const size_t tail = atomic_load_explicit(&reader->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&reader->head, memory_order_acquire);
+
+    if (head == tail) {
+        *len = 0;
+        return NULL;
+    }
+
+    const size_t idx = tail & (reader->size - 1);
+    *len = min(head - tail, reader->size - idx);
+    return &reader->ring[idx];
+}
+
+void
+ptmx_reader_consume(struct ptmx_reader *reader, size_t len)
+{
+    const size_t tail = atomic_load_explicit(&reader->tail, memory_order_relaxed);
+    xassert(len <= atomic_load(&reader->head) - tail);
+
+    atomic_store(&reader->tail, tail + len);
+
+    if (atomic_load(&reader->waiting_for_space))
+        signal_fd(reader->space_fd);
+}
+
+bool
+ptmx_reader_eof(struct ptmx_reader *reader)
+{
+    if (!atomic_load_explicit(&reader->eof, memory_order_acquire))
+        return false;
+
+    size_t len;
+    return ptmx_reader_peek(reader, &len) == NULL;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Drains a PTY master on a dedicated thread, into a single-producer,
+ * single-consumer ring buffer.
+ *
+ * The consumer (the main thread) is notified through an event FD
+ * (ptmx_reader_fd()), and parses data directly from the ring buffer
+ * with ptmx_reader_peek() + ptmx_reader_consume().
+ *
+ * When the ring buffer is full, the reader thread stops reading from
+ * the PTY, applying back pressure on the client application, exactly
+ * like the non-threaded path does.
+ */
+struct ptmx_reader;
+
+/* 'size' must be a power of two */
+struct ptmx_reader *ptmx_reader_init(int ptmx, size_t size);
+void ptmx_reader_destroy(struct ptmx_reader *reader);
+
+/* Readable whenever there is data (or EOF) to process */
+int ptmx_reader_fd(const struct ptmx_reader *reader);
+
+/* Resets the event FD; call before processing data */
+void ptmx_reader_ack(struct ptmx_reader *reader);
+
+/* Makes the event FD readable again, e.g. when the consumer yields
+ * before having processed everything */
+void ptmx_reader_kick(struct ptmx_reader *reader);
+
+/*
+ * Returns a pointer to the next, contiguous, chunk of buffered data,
+ * or NULL if the ring buffer is empty. Data must be released with
+ * ptmx_reader_consume().
+ */
+const uint8_t *ptmx_reader_peek(struct ptmx_reader *reader, size_t *len);
+void ptmx_reader_consume(struct ptmx_reader *reader, size_t len);
+
+/* True when the PTY has been closed, *and* all data has been consumed */
+bool ptmx_reader_eof(struct ptmx_reader *reader);
@@ -0,0 +1,237 @@
+#include "pty-record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_MODULE "pty-record"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "debug.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define MAX_RECORD_SIZE ((1u << 24) - 1)
+
+struct record_header {
+    uint64_t time_ns;
+    uint32_t header;
+} __attribute__((packed));
+
+struct pty_recorder {
+    FILE *file;
+    char *path;
+    struct timespec start;
+};
+
+struct pty_recorder *
+pty_record_open(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_ERRNO("%s: failed to create PTY recording", path);
+        return NULL;
+    }
+
+    FILE *file = fdopen(fd, "w");
+    if (file == NULL) {
+        LOG_ERRNO("%s: failed to create PTY recording", path);
+        close(fd);
+        return NULL;
+    }
+
+    struct pty_recorder *rec = xmalloc(sizeof(*rec));
+    *rec = (struct pty_recorder){
+        .file = file,
+        .path = xstrdup(path),
+    };
+    clock_gettime(CLOCK_MONOTONIC, &rec->start);
+
+    if (fwrite(PTY_RECORD_MAGIC, 1, 8, file) != 8) {
+        LOG_ERRNO("%s: failed to write PTY recording", path);
+        pty_record_close(rec);
+        return NULL;
+    }
+
+    LOG_INFO("recording PTY data to %s", path);
+    return rec;
+}
+
+void
+pty_record_close(struct pty_recorder *rec)
+{
+    if (rec == NULL)
+        return;
+
+    if (rec->file != NULL && fclose(rec->file) != 0)
+        LOG_ERRNO("%s: failed to write PTY recording", rec->path);
+
+    free(rec->path);
+    free(rec);
+}
+
+static void
+write_record(struct pty_recorder *rec, enum pty_record_type type,
+             const void *data, size_t len)
+{
+    if (rec->file == NULL)
+        return;
+
+    xassert(len <= MAX_RECORD_SIZE);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    const struct record_header hdr = {
+        .time_ns = (now.tv_sec - rec->start.tv_sec) * 1000000000ull +
+                   now.tv_nsec - rec->start.tv_nsec,
+        .header = (uint32_t)len << 8 | type,
+    };
+
+    if (fwrite(&hdr, sizeof(hdr), 1, rec->file) != 1 ||
+        (len > 0 && fwrite(data, len, 1, rec->file) != 1))
+    {
+        LOG_ERRNO("%s: failed to write PTY recording; recording stopped",
+                  rec->path);
+        fclose(rec->file);
+        rec->file = NULL;
+    }
+}
+
+void
+pty_record_data(struct pty_recorder *rec, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        const size_t count = min(len, MAX_RECORD_SIZE);
+        write_record(rec, PTY_RECORD_DATA, data, count);
+        data += count;
+        len -= count;
+    }
+}
+
+void
+pty_record_resize(
+    struct pty_recorder *rec, int cols, int rows, int width, int height)
+{
+    const struct pty_record_size size = {
+        .cols = cols,
+        .rows = rows,
+        .width = width,
+        .height = height,
+    };
+    write_record(rec, PTY_RECORD_RESIZE, &size, sizeof(size));
+}
+
+bool
+pty_record_is_recording(const uint8_t *data, size_t len)
+{
+    return len >= 8 && memcmp(data, PTY_RECORD_MAGIC, 8) == 0;
+}
+
+bool
+pty_record_next(
+    const uint8_t **p, const uint8_t *end, struct pty_record_event *event)
+{
+    while (true) {
+        struct record_header hdr;
+
+        if ((size_t)(end - *p) < sizeof(hdr))
+            return false;
+
+        memcpy(&hdr, *p, sizeof(hdr));
+
+        const size_t len = hdr.header >> 8;
+        const uint8_t *payload = *p + sizeof(hdr);
+
+        if ((size_t)(end - payload) < len)
+            return false;
+
+        *p = payload + len;
+
+        switch (hdr.header & 0xff) {
+        case PTY_RECORD_DATA:
+            *event = (struct pty_record_event){
+                .type = PTY_RECORD_DATA,
+                .time_ns = hdr.time_ns,
+                .data = payload,
+                .len = len,
+            };
+            return true;
+
+        case PTY_RECORD_RESIZE:
+            if (len < sizeof(event->size))
+                continue;
+
+            *event = (struct pty_record_event){
+                .type = PTY_RECORD_RESIZE,
+                .time_ns = hdr.time_ns,
+            };
+            memcpy(&event->size, payload, sizeof(event->size));
+            return true;
+
+        default:
+            continue;
+        }
+    }
+}
+
+UNITTEST
+{
+    char path[] = "/tmp/foot-pty-record-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return;
+    close(fd);
+
+    struct pty_recorder *rec = pty_record_open(path);
+    xassert(rec != NULL);
+
+    pty_record_resize(rec, 80, 24, 640, 480);
+    pty_record_data(rec, (const uint8_t *)"hello", 5);
+    pty_record_data(rec, (const uint8_t *)"\x1b[m", 3);
+    pty_record_close(rec);
+
+    FILE *f = fopen(path, "r");
+    xassert(f != NULL);
+
+    uint8_t buf[256];
+    const size_t size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    unlink(path);
+
+    xassert(pty_record_is_recording(buf, size));
+
+    const uint8_t *p = buf + 8;
+    const uint8_t *end = buf + size;
+    struct pty_record_event ev;
+
+    xassert(pty_record_next(&p, end, &ev));
+    xassert(ev.type == PTY_RECORD_RESIZE);
+    xassert(ev.size.cols == 80 && ev.size.rows == 24);
+    xassert(ev.size.width == 640 && ev.size.height == 480);
+
+    uint64_t last_time = ev.time_ns;
+
+    xassert(pty_record_next(&p, end, &ev));
+    xassert(ev.type == PTY_RECORD_DATA);
+    xassert(ev.len == 5 && memcmp(ev.data, "hello", 5) == 0);
+    xassert(ev.time_ns >= last_time);
+
+    xassert(pty_record_next(&p, end, &ev));
+    xassert(ev.type == PTY_RECORD_DATA);
+    xassert(ev.len == 3 && memcmp(ev.data, "\x1b[m", 3) == 0);
+
+    xassert(!pty_record_next(&p, end, &ev));
+    xassert(p == end);
+
+    /* Truncated record */
+    p = buf + 8;
+    xassert(pty_record_next(&p, end - 1, &ev));
+    xassert(pty_record_next(&p, end - 1, &ev));
+    xassert(!pty_record_next(&p, end - 1, &ev));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Recording of the data read from the PTY (tweak.pty-record), with
+ * timing, for replaying later (e.g. with foot-bench).
+ *
+ * The file starts with an 8 byte magic, followed by a sequence of
+ * records. Each record has a 12 byte header:
+ *
+ *   time:   uint64_t, nanoseconds since the recording started
+ *   header: uint32_t, (size << 8) | type
+ *
+ * followed by 'size' bytes of payload. PTY_RECORD_DATA records
+ * contain the bytes exactly as read (i.e. one record per read), and
+ * PTY_RECORD_RESIZE records contain a struct pty_record_size. All
+ * integers are in native byte order.
+ */
+
+#define PTY_RECORD_MAGIC "FOOTPTY1"
+
+enum pty_record_type {
+    PTY_RECORD_DATA = 1,
+    PTY_RECORD_RESIZE = 2,
+};
+
+struct pty_record_size {
+    uint16_t cols;
+    uint16_t rows;
+    uint16_t width;   /* Pixels */
+    uint16_t height;  /* Pixels */
+};
+
+struct pty_recorder;
+
+struct pty_recorder *pty_record_open(const char *path);
+void pty_record_close(struct pty_recorder *rec);
+
+void pty_record_data(struct pty_recorder *rec, const uint8_t *data, size_t len);
+void pty_record_resize(
+    struct pty_recorder *rec, int cols, int rows, int width, int height);
+
+/* A record, as returned by pty_record_next() */
+struct pty_record_event {
+    enum pty_record_type type;
+    uint64_t time_ns;
+    const uint8_t *data;  /* PTY_RECORD_DATA */
+    size_t len;
+    struct pty_record_size size;  /* PTY_RECORD_RESIZE */
+};
+
+/* True if 'data' starts with the recording magic */
+bool pty_record_is_recording(const uint8_t *data, size_t len);
+
+/*
+ * Parses the record at '*p' (initially, the data following the
+ * magic), and advances '*p' to the next one. Returns false at the end
+ * of the data, or if the record is truncated. Records of unknown
+ * types are skipped.
+ */
+bool pty_record_next(
+    const uint8_t **p, const uint8_t *end, struct pty_record_event *event);
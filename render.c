@@ -1,6 +1,8 @@
 #include "render.h"
 
 #include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <signal.h>
 
@@ -31,9 +33,11 @@
 #include "char32.h"
 #include "config.h"
 #include "cursor-shape.h"
+#include "glyph-tiles.h"
 #include "grid.h"
 #include "hsl.h"
 #include "ime.h"
+#include "pty-record.h"
 #include "quirks.h"
 #include "search.h"
 #include "selection.h"
@@ -57,6 +61,71 @@ static struct {
     size_t two;   /* commits presented in two or more frame intervals */
 } presentation_statistics = {0};
 
+/* A render thread's share of a frame's dirty rows; see grid_render() */
+struct render_worker_range {
+    atomic_int next;  /* Index into 'rows'; may go past 'end' */
+    int end;
+
+    /* Avoid false sharing between threads */
+    char pad[64 - sizeof(atomic_int) - sizeof(int)];
+};
+
+/* Part of a sixel to scale; see render_sixel_images_scale() */
+struct render_sixel_stripe {
+    struct sixel *sixel;
+    int start;
+    int end;
+};
+
+/*
+ * Process wide pool of render worker threads, shared by all
+ * terminals (in server mode, all windows use the same threads).
+ *
+ * Frames are rendered one at a time, from the main thread, so the
+ * pool only ever works on a single terminal's frame.
+ */
+static struct {
+    size_t ref_count;
+    uint16_t count;
+    thrd_t *threads;
+
+    /* Frame start: 'generation' is bumped, and 'start' is broadcasted */
+    mtx_t start_lock;
+    cnd_t start;
+    atomic_uint generation;
+    atomic_bool quit;
+
+    /* Frame end: the last worker to finish posts 'done' */
+    atomic_uint remaining;
+    sem_t done;
+
+    /* The frame currently being rendered */
+    struct terminal *term;
+    struct buffer *buf;
+    struct coord cursor;
+    int active;  /* Threads (including the main thread) rendering the frame */
+
+    enum {
+        RENDER_JOB_ROWS,
+        RENDER_JOB_SIXEL_SCALE,
+    } job;
+
+    /*
+     * Dirty rows of the current frame, split into one contiguous
+     * range per active thread. Threads that run out of rows steal
+     * from the other threads' ranges.
+     */
+    int *rows;
+    int rows_size;
+    struct render_worker_range *ranges;
+
+    /* Sixels to scale, split into stripes, claimed with 'next_stripe' */
+    struct render_sixel_stripe *stripes;
+    int stripes_count;
+    int stripes_size;
+    atomic_int next_stripe;
+} render_pool = {0};
+
 static void fdm_hook_refresh_pending_terminals(struct fdm *fdm, void *data);
 
 struct renderer *
@@ -120,23 +189,127 @@ struct presentation_context {
     struct terminal *term;
     struct timeval input;
     struct timeval commit;
+
+    /* Key press latency tracing; see render_latency_key_pressed() */
+    bool traced;
+    struct timespec key;
+    struct timespec echo;
+    struct timespec commit_ts;
 };
 
+/* Number of key presses render_latency_log() reports on */
+#define LATENCY_SAMPLES 1024
+
+/* Key presses without an echo within this time are no longer traced */
+#define LATENCY_ECHO_TIMEOUT_NS 1000000000ull
+
+static uint64_t
+ns_between(const struct timespec *start, const struct timespec *end)
+{
+    struct timespec diff;
+    timespec_sub(end, start, &diff);
+    return diff.tv_sec < 0 ? 0 : diff.tv_sec * 1000000000ull + diff.tv_nsec;
+}
+
+void
+render_latency_key_pressed(struct terminal *term)
+{
+    struct timespec now;
+    clock_gettime(term->wl->presentation_clock_id, &now);
+
+    if (term->render.latency.tracing &&
+        ns_between(&term->render.latency.input, &now) < LATENCY_ECHO_TIMEOUT_NS)
+    {
+        /* Still waiting for the previous key press's echo */
+        return;
+    }
+
+    term->render.latency.tracing = true;
+    term->render.latency.echoed = false;
+    term->render.latency.input = now;
+}
+
 static void
-presented(void *data,
-          struct wp_presentation_feedback *wp_presentation_feedback,
-          uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
-          uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+latency_add_sample(struct terminal *term,
+                   const struct presentation_context *ctx,
+                   const struct timespec *presented)
 {
-    struct presentation_context *ctx = data;
-    struct terminal *term = ctx->term;
-    const struct timeval *input = &ctx->input;
-    const struct timeval *commit = &ctx->commit;
+    if (term->render.latency.samples == NULL) {
+        term->render.latency.samples = xmalloc(
+            LATENCY_SAMPLES * sizeof(term->render.latency.samples[0]));
+    }
 
-    const struct timeval presented = {
-        .tv_sec = (uint64_t)tv_sec_hi << 32 | tv_sec_lo,
-        .tv_usec = tv_nsec / 1000,
+    const size_t idx = term->render.latency.count++ % LATENCY_SAMPLES;
+    term->render.latency.samples[idx] = (struct latency_sample){
+        .echo = min(ns_between(&ctx->key, &ctx->echo) / 1000, UINT32_MAX),
+        .commit = min(ns_between(&ctx->echo, &ctx->commit_ts) / 1000, UINT32_MAX),
+        .presented = min(ns_between(&ctx->commit_ts, presented) / 1000, UINT32_MAX),
     };
+}
+
+static int
+u32_cmp(const void *_a, const void *_b)
+{
+    const uint32_t a = *(const uint32_t *)_a;
+    const uint32_t b = *(const uint32_t *)_b;
+    return a < b ? -1 : a > b;
+}
+
+static void
+log_latency_percentiles(const char *name, uint32_t *v, size_t count)
+{
+    qsort(v, count, sizeof(v[0]), &u32_cmp);
+    LOG_INFO("  %-20s p50=%.2fms, p95=%.2fms, p99=%.2fms, max=%.2fms",
+             name,
+             v[(count - 1) * 50 / 100] / 1000.,
+             v[(count - 1) * 95 / 100] / 1000.,
+             v[(count - 1) * 99 / 100] / 1000.,
+             v[count - 1] / 1000.);
+}
+
+void
+render_latency_log(const struct terminal *term)
+{
+    const size_t count = min(term->render.latency.count, LATENCY_SAMPLES);
+
+    LOG_INFO("%d: key press latency, last %zu of %zu key presses "
+             "(%zu traced frames discarded by the compositor):",
+             (int)term->slave, count, term->render.latency.count,
+             term->render.latency.discarded);
+
+    if (count == 0)
+        return;
+
+    const struct latency_sample *samples = term->render.latency.samples;
+    uint32_t *v = xmalloc(count * sizeof(v[0]));
+
+    for (size_t i = 0; i < count; i++)
+        v[i] = samples[i].echo;
+    log_latency_percentiles("input -> PTY echo:", v, count);
+
+    for (size_t i = 0; i < count; i++)
+        v[i] = samples[i].commit;
+    log_latency_percentiles("PTY echo -> commit:", v, count);
+
+    for (size_t i = 0; i < count; i++)
+        v[i] = samples[i].presented;
+    log_latency_percentiles("commit -> presented:", v, count);
+
+    for (size_t i = 0; i < count; i++)
+        v[i] = samples[i].echo + samples[i].commit + samples[i].presented;
+    log_latency_percentiles("total:", v, count);
+
+    free(v);
+}
+
+static void
+log_presentation_timings(const struct presentation_context *ctx,
+                         const struct timeval *_presented)
+{
+    const struct terminal *term = ctx->term;
+    const struct timeval *input = &ctx->input;
+    const struct timeval *commit = &ctx->commit;
+    const struct timeval presented = *_presented;
 
     bool use_input = (input->tv_sec > 0 || input->tv_usec > 0) &&
         timercmp(&presented, input, >);
@@ -201,17 +374,76 @@ presented(void *data,
         LOG_INFO(_log_fmt, msg, frame_count);
 
 #undef _log_fmt
+}
+
+static void
+presentation_feedback_done(struct presentation_context *ctx,
+                           struct wp_presentation_feedback *feedback)
+{
+    struct terminal *term = ctx->term;
+
+    tll_foreach(term->render.presentation_feedbacks, it) {
+        if (it->item == feedback) {
+            tll_remove(term->render.presentation_feedbacks, it);
+            break;
+        }
+    }
 
-    wp_presentation_feedback_destroy(wp_presentation_feedback);
+    wp_presentation_feedback_destroy(feedback);
     free(ctx);
 }
 
+static void
+presented(void *data,
+          struct wp_presentation_feedback *wp_presentation_feedback,
+          uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+          uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    struct presentation_context *ctx = data;
+    struct terminal *term = ctx->term;
+
+    /*
+     * Remember when, and at which rate, frames are presented. This is
+     * used to predict the next vblank when scheduling PTY parsing
+     * (see ptmx_parse_budget()). We only have a monotonic clock to
+     * compare with on the PTY side, so ignore other clock domains.
+     */
+    if (term->wl->presentation_clock_id == CLOCK_MONOTONIC) {
+        term->render.frame_timing.last_presented = (struct timespec){
+            .tv_sec = (uint64_t)tv_sec_hi << 32 | tv_sec_lo,
+            .tv_nsec = tv_nsec,
+        };
+        term->render.frame_timing.refresh_ns = refresh;
+    }
+
+    if (term->conf->presentation_timings) {
+        const struct timeval presented = {
+            .tv_sec = (uint64_t)tv_sec_hi << 32 | tv_sec_lo,
+            .tv_usec = tv_nsec / 1000,
+        };
+        log_presentation_timings(ctx, &presented);
+    }
+
+    if (ctx->traced) {
+        const struct timespec presented = {
+            .tv_sec = (uint64_t)tv_sec_hi << 32 | tv_sec_lo,
+            .tv_nsec = tv_nsec,
+        };
+        latency_add_sample(term, ctx, &presented);
+    }
+
+    presentation_feedback_done(ctx, wp_presentation_feedback);
+}
+
 static void
 discarded(void *data, struct wp_presentation_feedback *wp_presentation_feedback)
 {
     struct presentation_context *ctx = data;
-    wp_presentation_feedback_destroy(wp_presentation_feedback);
-    free(ctx);
+
+    if (ctx->traced)
+        ctx->term->render.latency.discarded++;
+
+    presentation_feedback_done(ctx, wp_presentation_feedback);
 }
 
 static const struct wp_presentation_feedback_listener presentation_feedback_listener = {
@@ -227,6 +459,100 @@ attrs_to_font(const struct terminal *term, const struct attributes *attrs)
     return term->fonts[idx];
 }
 
+/*
+ * Like fcft_rasterize_char_utf32(), on the font for 'attrs', but
+ * looks up low code points in the terminal's direct mapped glyph
+ * table first. This avoids fcft's hash lookups, and locking, for the
+ * bulk of the output.
+ */
+static const struct fcft_glyph *
+rasterize_char(struct terminal *term, const struct attributes *attrs,
+               char32_t wc)
+{
+    const int idx = attrs->italic << 1 | attrs->bold;
+    struct fcft_font *font = term->fonts[idx];
+
+    if (unlikely(wc >= GLYPH_DIRECT_COUNT))
+        return fcft_rasterize_char_utf32(font, wc, term->font_subpixel);
+
+    _Atomic(const struct fcft_glyph *) *slot = &term->direct_glyphs[idx][wc];
+    const struct fcft_glyph *glyph =
+        atomic_load_explicit(slot, memory_order_acquire);
+
+    if (likely(glyph != NULL))
+        return glyph;
+
+    /* Other threads may race us here; they'll get the same glyph */
+    glyph = fcft_rasterize_char_utf32(font, wc, term->font_subpixel);
+    atomic_store_explicit(slot, glyph, memory_order_release);
+    return glyph;
+}
+
+/* Cached, by shape_composed(), when a cluster could not be shaped */
+static const struct fcft_grapheme grapheme_shaping_failed;
+
+/*
+ * Shapes a composed character (grapheme cluster), with the font for
+ * 'attrs'. The result is cached in the composed character, and
+ * re-used in subsequent frames. Returns NULL if the cluster could not
+ * be shaped.
+ */
+static const struct fcft_grapheme *
+shape_composed(struct terminal *term, const struct attributes *attrs,
+               struct composed *composed)
+{
+    const int idx = attrs->italic << 1 | attrs->bold;
+    const struct fcft_grapheme *grapheme =
+        atomic_load_explicit(&composed->grapheme[idx], memory_order_acquire);
+
+    if (grapheme == NULL) {
+        grapheme = fcft_rasterize_grapheme_utf32(
+            term->fonts[idx], composed->count, composed->chars,
+            term->font_subpixel);
+
+        if (grapheme == NULL)
+            grapheme = &grapheme_shaping_failed;
+
+        atomic_store_explicit(
+            &composed->grapheme[idx], grapheme, memory_order_release);
+    }
+
+    return grapheme != &grapheme_shaping_failed ? grapheme : NULL;
+}
+
+/*
+ * Returns the glyphs, one for each character, of a composed character,
+ * with the font for 'attrs'. Used when the cluster isn't shaped. Like
+ * shape_composed(), the result is cached in the composed character.
+ */
+static const struct fcft_glyph **
+composed_glyphs(struct terminal *term, const struct attributes *attrs,
+                struct composed *composed)
+{
+    const int idx = attrs->italic << 1 | attrs->bold;
+    const struct fcft_glyph **glyphs =
+        atomic_load_explicit(&composed->glyphs[idx], memory_order_acquire);
+
+    if (likely(glyphs != NULL))
+        return glyphs;
+
+    glyphs = xmalloc(composed->count * sizeof(glyphs[0]));
+    for (size_t i = 0; i < composed->count; i++)
+        glyphs[i] = rasterize_char(term, attrs, composed->chars[i]);
+
+    /* Another thread may have beaten us to it */
+    const struct fcft_glyph **expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(
+            &composed->glyphs[idx], &expected, glyphs,
+            memory_order_acq_rel, memory_order_acquire))
+    {
+        free(glyphs);
+        glyphs = expected;
+    }
+
+    return glyphs;
+}
+
 static inline pixman_color_t
 color_hex_to_pixman_with_alpha(uint32_t color, uint16_t alpha)
 {
@@ -635,22 +961,10 @@ draw_cursor(const struct terminal *term, const struct cell *cell,
     }
 }
 
-static int
-render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damage,
-            struct row *row, int row_no, int col, bool has_cursor)
+static void
+cell_colors(const struct terminal *term, const struct cell *cell,
+            pixman_color_t *fg, pixman_color_t *bg)
 {
-    struct cell *cell = &row->cells[col];
-    if (cell->attrs.clean)
-        return 0;
-
-    cell->attrs.clean = 1;
-    cell->attrs.confined = true;
-
-    int width = term->cell_width;
-    int height = term->cell_height;
-    const int x = term->margins.left + col * width;
-    const int y = term->margins.top + row_no * height;
-
     bool is_selected = cell->attrs.selected;
 
     uint32_t _fg = 0;
@@ -756,11 +1070,176 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
     if (cell->attrs.blink && term->blink.state == BLINK_OFF)
         _fg = color_decrease_luminance(_fg);
 
-    pixman_color_t fg = color_hex_to_pixman(_fg);
-    pixman_color_t bg = color_hex_to_pixman_with_alpha(_bg, alpha);
+    *fg = color_hex_to_pixman(_fg);
+    *bg = color_hex_to_pixman_with_alpha(_bg, alpha);
+}
+
+/*
+ * Returns our own rendition of box drawing, braille and legacy
+ * computing characters, or NULL if the character should be rendered
+ * from the font.
+ */
+static const struct fcft_glyph *
+custom_glyph(struct terminal *term, char32_t base)
+{
+    if (likely(
+            /* Classic box drawings */
+            (base < GLYPH_BOX_DRAWING_FIRST ||
+             base > GLYPH_BOX_DRAWING_LAST) &&
+
+            /* Braille */
+            (base < GLYPH_BRAILLE_FIRST ||
+             base > GLYPH_BRAILLE_LAST) &&
+
+            /*
+             * Unicode 13 "Symbols for Legacy Computing"
+             * sub-ranges below.
+             *
+             * Note, the full range is U+1FB00 - U+1FBF9
+             */
+            (base < GLYPH_LEGACY_FIRST ||
+             base > GLYPH_LEGACY_LAST)) ||
+
+        unlikely(term->conf->box_drawings_uses_font_glyphs))
+    {
+        return NULL;
+    }
+
+    struct fcft_glyph ***arr;
+    size_t count;
+    size_t idx;
+
+    if (base >= GLYPH_LEGACY_FIRST) {
+        arr = &term->custom_glyphs.legacy;
+        count = GLYPH_LEGACY_COUNT;
+        idx = base - GLYPH_LEGACY_FIRST;
+    } else if (base >= GLYPH_BRAILLE_FIRST) {
+        arr = &term->custom_glyphs.braille;
+        count = GLYPH_BRAILLE_COUNT;
+        idx = base - GLYPH_BRAILLE_FIRST;
+    } else {
+        arr = &term->custom_glyphs.box_drawing;
+        count = GLYPH_BOX_DRAWING_COUNT;
+        idx = base - GLYPH_BOX_DRAWING_FIRST;
+    }
+
+    if (unlikely(*arr == NULL))
+        *arr = xcalloc(count, sizeof((*arr)[0]));
+
+    const struct fcft_glyph *single = (*arr)[idx];
+    if (likely(single != NULL))
+        return single;
+
+    mtx_lock(&term->render.workers.lock);
+
+    /* Other thread may have instantiated it while we
+     * acquired the lock */
+    single = (*arr)[idx];
+    if (likely(single == NULL))
+        single = (*arr)[idx] = box_drawing(term, base);
+    mtx_unlock(&term->render.workers.lock);
+
+    return single;
+}
+
+/*
+ * Whether the cell's glyph(s) and decorations are drawn. Empty cells,
+ * spacers, tabs and (unselected) concealed text only get a background.
+ */
+static bool
+cell_has_foreground(const struct cell *cell)
+{
+    return !(cell->wc == 0 || cell->wc >= CELL_SPACER || cell->wc == U'\t' ||
+             (unlikely(cell->attrs.conceal) && !cell->attrs.selected));
+}
+
+/* Underline, strikeout and URL underline */
+static void
+draw_cell_decorations(const struct terminal *term, pixman_image_t *pix,
+                      const struct fcft_font *font, const struct row *row,
+                      int col, const pixman_color_t *fg, int x, int y,
+                      int cell_cols)
+{
+    const struct cell *cell = &row->cells[col];
+
+    /* Underline */
+    if (cell->attrs.underline) {
+        pixman_color_t underline_color = *fg;
+        enum underline_style underline_style = UNDERLINE_SINGLE;
+
+        /* Check if cell has a styled underline. This lookup is fairly
+           expensive... */
+        if (row->extra != NULL) {
+            for (int i = 0; i < row->extra->underline_ranges.count; i++) {
+                const struct row_range *range = &row->extra->underline_ranges.v[i];
+
+                if (range->start > col)
+                    break;
+
+                if (range->start <= col && col <= range->end) {
+                    switch (range->underline.color_src) {
+                    case COLOR_BASE256:
+                        underline_color = color_hex_to_pixman(
+                            term->colors.table[range->underline.color]);
+                        break;
+
+                    case COLOR_RGB:
+                        underline_color =
+                            color_hex_to_pixman(range->underline.color);
+                        break;
+
+                    case COLOR_DEFAULT:
+                        break;
+
+                    case COLOR_BASE16:
+                        BUG("underline color can't be base-16");
+                        break;
+                    }
+
+                    underline_style = range->underline.style;
+                    break;
+                }
+            }
+        }
+
+        draw_styled_underline(
+            term, pix, font, &underline_color, underline_style, x, y, cell_cols);
+    }
+
+    if (cell->attrs.strikethrough)
+        draw_strikeout(term, pix, font, fg, x, y, cell_cols);
+
+    if (unlikely(cell->attrs.url)) {
+        pixman_color_t url_color = color_hex_to_pixman(
+            term->conf->colors.use_custom.url
+            ? term->conf->colors.url
+            : term->colors.table[3]
+            );
+        draw_underline(term, pix, font, &url_color, x, y, cell_cols);
+    }
+}
+
+static int
+render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damage,
+            struct row *row, int row_no, int col, bool has_cursor)
+{
+    struct cell *cell = &row->cells[col];
+    if (cell->attrs.clean)
+        return 0;
+
+    cell->attrs.clean = 1;
+    cell->attrs.confined = true;
+
+    int width = term->cell_width;
+    int height = term->cell_height;
+    const int x = term->margins.left + col * width;
+    const int y = term->margins.top + row_no * height;
+
+    pixman_color_t fg, bg;
+    cell_colors(term, cell, &fg, &bg);
 
     struct fcft_font *font = attrs_to_font(term, &cell->attrs);
-    const struct composed *composed = NULL;
+    struct composed *composed = NULL;
     const struct fcft_grapheme *grapheme = NULL;
     const struct fcft_glyph *single = NULL;
     const struct fcft_glyph **glyphs = NULL;
@@ -770,76 +1249,21 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
     int cell_cols = 1;
 
     if (base != 0) {
-        if (unlikely(
-                /* Classic box drawings */
-                (base >= GLYPH_BOX_DRAWING_FIRST &&
-                 base <= GLYPH_BOX_DRAWING_LAST) ||
-
-                /* Braille */
-                (base >= GLYPH_BRAILLE_FIRST &&
-                 base <= GLYPH_BRAILLE_LAST) ||
-
-                /*
-                 * Unicode 13 "Symbols for Legacy Computing"
-                 * sub-ranges below.
-                 *
-                 * Note, the full range is U+1FB00 - U+1FBF9
-                 */
-                (base >= GLYPH_LEGACY_FIRST &&
-                 base <= GLYPH_LEGACY_LAST)) &&
-
-            likely(!term->conf->box_drawings_uses_font_glyphs))
-        {
-            struct fcft_glyph ***arr;
-            size_t count;
-            size_t idx;
-
-            if (base >= GLYPH_LEGACY_FIRST) {
-                arr = &term->custom_glyphs.legacy;
-                count = GLYPH_LEGACY_COUNT;
-                idx = base - GLYPH_LEGACY_FIRST;
-            } else if (base >= GLYPH_BRAILLE_FIRST) {
-                arr = &term->custom_glyphs.braille;
-                count = GLYPH_BRAILLE_COUNT;
-                idx = base - GLYPH_BRAILLE_FIRST;
-            } else {
-                arr = &term->custom_glyphs.box_drawing;
-                count = GLYPH_BOX_DRAWING_COUNT;
-                idx = base - GLYPH_BOX_DRAWING_FIRST;
-            }
-
-            if (unlikely(*arr == NULL))
-                *arr = xcalloc(count, sizeof((*arr)[0]));
-
-            if (likely((*arr)[idx] != NULL))
-                single = (*arr)[idx];
-            else {
-                mtx_lock(&term->render.workers.lock);
-
-                /* Other thread may have instantiated it while we
-                 * acquired the lock */
-                single = (*arr)[idx];
-                if (likely(single == NULL))
-                    single = (*arr)[idx] = box_drawing(term, base);
-                mtx_unlock(&term->render.workers.lock);
-            }
+        single = custom_glyph(term, base);
 
-            if (single != NULL) {
-                glyph_count = 1;
-                glyphs = &single;
-                cell_cols = single->cols;
-            }
+        if (single != NULL) {
+            glyph_count = 1;
+            glyphs = &single;
+            cell_cols = single->cols;
         }
 
         else if (base >= CELL_COMB_CHARS_LO && base <= CELL_COMB_CHARS_HI)
         {
-            composed = composed_lookup(term->composed, base - CELL_COMB_CHARS_LO);
+            composed = composed_lookup(&term->composed, base - CELL_COMB_CHARS_LO);
             base = composed->chars[0];
 
-            if (term->conf->can_shape_grapheme && term->conf->tweak.grapheme_shaping) {
-                grapheme = fcft_rasterize_grapheme_utf32(
-                    font, composed->count, composed->chars, term->font_subpixel);
-            }
+            if (term->conf->can_shape_grapheme && term->conf->tweak.grapheme_shaping)
+                grapheme = shape_composed(term, &cell->attrs, composed);
 
             if (grapheme != NULL) {
                 cell_cols = composed->width;
@@ -856,7 +1280,7 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
                 cell_cols = 1;
             } else {
                 xassert(base != 0);
-                single = fcft_rasterize_char_utf32(font, base, term->font_subpixel);
+                single = rasterize_char(term, &cell->attrs, base);
                 if (single == NULL) {
                     glyph_count = 0;
                     cell_cols = 1;
@@ -926,11 +1350,8 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
     if (unlikely(has_cursor && term->cursor_style == CURSOR_BLOCK && term->kbd_focus))
         draw_cursor(term, cell, font, pix, &fg, &bg, x, y, cell_cols);
 
-    if (cell->wc == 0 || cell->wc >= CELL_SPACER || cell->wc == U'\t' ||
-        (unlikely(cell->attrs.conceal) && !is_selected))
-    {
+    if (!cell_has_foreground(cell))
         goto draw_cursor;
-    }
 
     pixman_image_t *clr_pix = pixman_image_create_solid_fill(&fg);
 
@@ -966,9 +1387,11 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
             if (composed != NULL) {
                 assert(glyph_count == 1);
 
+                const struct fcft_glyph **comb_glyphs =
+                    composed_glyphs(term, &cell->attrs, composed);
+
                 for (size_t i = 1; i < composed->count; i++) {
-                    const struct fcft_glyph *g = fcft_rasterize_char_utf32(
-                        font, composed->chars[i], term->font_subpixel);
+                    const struct fcft_glyph *g = comb_glyphs[i];
 
                     if (g == NULL)
                         continue;
@@ -1010,77 +1433,311 @@ render_cell(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damag
 
     pixman_image_unref(clr_pix);
 
-    /* Underline */
-    if (cell->attrs.underline) {
-        pixman_color_t underline_color = fg;
-        enum underline_style underline_style = UNDERLINE_SINGLE;
+    draw_cell_decorations(term, pix, font, row, col, &fg, x, y, cell_cols);
 
-        /* Check if cell has a styled underline. This lookup is fairly
-           expensive... */
-        if (row->extra != NULL) {
-            for (int i = 0; i < row->extra->underline_ranges.count; i++) {
-                const struct row_range *range = &row->extra->underline_ranges.v[i];
+draw_cursor:
+    if (has_cursor && (term->cursor_style != CURSOR_BLOCK || !term->kbd_focus))
+        draw_cursor(term, cell, font, pix, &fg, &bg, x, y, cell_cols);
 
-                if (range->start > col)
-                    break;
+    pixman_image_set_clip_region32(pix, NULL);
+    return cell_cols;
+}
 
-                if (range->start <= col && col <= range->end) {
-                    switch (range->underline.color_src) {
-                    case COLOR_BASE256:
-                        underline_color = color_hex_to_pixman(
-                            term->colors.table[range->underline.color]);
-                        break;
+static bool
+pixman_color_equal(const pixman_color_t *a, const pixman_color_t *b)
+{
+    return a->red == b->red && a->green == b->green &&
+        a->blue == b->blue && a->alpha == b->alpha;
+}
 
-                    case COLOR_RGB:
-                        underline_color =
-                            color_hex_to_pixman(range->underline.color);
-                        break;
+/* 16-bit per channel color, to a8r8g8b8 (like pixman does it) */
+static uint32_t
+pixman_color_to_argb32(const pixman_color_t *color)
+{
+    return (uint32_t)(color->alpha >> 8) << 24 |
+        (uint32_t)(color->red >> 8) << 16 |
+        (uint32_t)(color->green & 0xff00) |
+        (uint32_t)(color->blue >> 8);
+}
 
-                    case COLOR_DEFAULT:
-                        break;
+/*
+ * Solid fill images, used as glyph sources, for the foreground colors
+ * of a row. Avoids creating one image per cell.
+ */
+struct solid_fills {
+    pixman_color_t colors[4];
+    pixman_image_t *pix[4];
+    size_t count;
+    size_t next;  /* Next slot to evict */
+};
 
-                    case COLOR_BASE16:
-                        BUG("underline color can't be base-16");
-                        break;
-                    }
+static pixman_image_t *
+solid_fill_get(struct solid_fills *fills, const pixman_color_t *color)
+{
+    for (size_t i = 0; i < fills->count; i++) {
+        if (pixman_color_equal(&fills->colors[i], color))
+            return fills->pix[i];
+    }
 
-                    underline_style = range->underline.style;
-                    break;
+    size_t idx;
+    if (fills->count < ALEN(fills->pix))
+        idx = fills->count++;
+    else {
+        idx = fills->next;
+        fills->next = (fills->next + 1) % ALEN(fills->pix);
+        pixman_image_unref(fills->pix[idx]);
+    }
+
+    fills->colors[idx] = *color;
+    fills->pix[idx] = pixman_image_create_solid_fill(color);
+    return fills->pix[idx];
+}
+
+static void
+solid_fills_release(struct solid_fills *fills)
+{
+    for (size_t i = 0; i < fills->count; i++)
+        pixman_image_unref(fills->pix[i]);
+    fills->count = fills->next = 0;
+}
+
+/* A dirty cell that is rendered as part of a span; see render_row() */
+struct span_cell {
+    pixman_color_t fg;
+    const struct fcft_font *font;
+    const struct fcft_glyph *glyph;  /* NULL if there's nothing to draw */
+};
+
+/*
+ * Resolves a cell's colors and glyph. Returns false if the cell cannot
+ * be rendered as part of a span, and must be rendered with
+ * render_cell(). This is the case for cells with the cursor, composed
+ * characters, multi-column characters, and glyphs that don't fit
+ * inside the cell (overflowing glyphs).
+ */
+static bool
+prepare_span_cell(struct terminal *term, const struct cell *cell,
+                  struct span_cell *sc, pixman_color_t *bg)
+{
+    const char32_t base = cell->wc;
+
+    if (base >= CELL_COMB_CHARS_LO && base <= CELL_COMB_CHARS_HI)
+        return false;
+
+    struct fcft_font *font = attrs_to_font(term, &cell->attrs);
+    const struct fcft_glyph *glyph = NULL;
+
+    if (base != 0 && base < CELL_SPACER) {
+        glyph = custom_glyph(term, base);
+        if (glyph == NULL)
+            glyph = rasterize_char(term, &cell->attrs, base);
+
+        if (glyph != NULL) {
+            if (glyph->cols > 1)
+                return false;
+
+            const int glyph_x = term->font_x_ofs + glyph->x;
+            if (glyph_x < 0 || glyph_x + glyph->width > term->cell_width)
+                return false;
+        }
+    }
+
+    cell_colors(term, cell, &sc->fg, bg);
+    sc->font = font;
+    sc->glyph = cell_has_foreground(cell) ? glyph : NULL;
+    return true;
+}
+
+static void
+render_span(struct terminal *term, pixman_image_t *pix,
+            pixman_region32_t *damage, const struct row *row, int row_no,
+            int first_col, int last_col, const struct span_cell *cells,
+            const pixman_color_t *bg, struct solid_fills *fills)
+{
+    const int width = term->cell_width;
+    const int height = term->cell_height;
+    const int x = term->margins.left + first_col * width;
+    const int y = term->margins.top + row_no * height;
+    const int span_width = (last_col - first_col + 1) * width;
+
+    pixman_region32_t clip;
+    pixman_region32_init_rect(&clip, x, y, span_width, height);
+    pixman_image_set_clip_region32(pix, &clip);
+    pixman_region32_fini(&clip);
+
+    if (damage != NULL)
+        pixman_region32_union_rect(damage, damage, x, y, span_width, height);
+
+    /* Background */
+    pixman_image_fill_rectangles(
+        PIXMAN_OP_SRC, pix, bg, 1,
+        &(pixman_rectangle16_t){x, y, span_width, height});
+
+    /*
+     * With an opaque background, and an 8-bit buffer, cells with
+     * grayscale glyphs can be copied from pre-blended tiles, instead
+     * of being composited.
+     */
+    const pixman_format_code_t fmt = pixman_image_get_format(pix);
+    const bool use_tiles = bg->alpha == 0xffff &&
+        (fmt == PIXMAN_a8r8g8b8 || fmt == PIXMAN_x8r8g8b8);
+    const uint32_t bg_argb = pixman_color_to_argb32(bg);
+
+    for (int col = first_col; col <= last_col; col++) {
+        const struct cell *cell = &row->cells[col];
+        const struct span_cell *sc = &cells[col];
+        const struct fcft_glyph *glyph = sc->glyph;
+        const int cell_x = term->margins.left + col * width;
+
+        if (glyph != NULL) {
+            const int glyph_x = cell_x + term->font_x_ofs + glyph->x;
+            const int glyph_y = y + term->font_baseline - glyph->y;
+
+            if (use_tiles &&
+                glyph_tiles_render(
+                    term->render.glyph_tiles, pix, cell_x, y, glyph,
+                    glyph_x - cell_x, glyph_y - y,
+                    pixman_color_to_argb32(&sc->fg), bg_argb))
+            {
+                /* Cell fully rendered from a pre-blended tile */
+            }
+
+            else if (unlikely(pixman_image_get_format(glyph->pix) == PIXMAN_a8r8g8b8)) {
+                /* Glyph surface is a pre-rendered image (typically a color emoji...) */
+                if (!(cell->attrs.blink && term->blink.state == BLINK_OFF)) {
+                    pixman_image_composite32(
+                        PIXMAN_OP_OVER, glyph->pix, NULL, pix, 0, 0, 0, 0,
+                        glyph_x, glyph_y, glyph->width, glyph->height);
                 }
+            } else {
+                pixman_image_composite32(
+                    PIXMAN_OP_OVER, solid_fill_get(fills, &sc->fg), glyph->pix,
+                    pix, 0, 0, 0, 0,
+                    glyph_x, glyph_y, glyph->width, glyph->height);
             }
         }
 
-        draw_styled_underline(
-            term, pix, font, &underline_color, underline_style, x, y, cell_cols);
-
+        if (cell_has_foreground(cell))
+            draw_cell_decorations(term, pix, sc->font, row, col, &sc->fg, cell_x, y, 1);
     }
 
-    if (cell->attrs.strikethrough)
-        draw_strikeout(term, pix, font, &fg, x, y, cell_cols);
+    pixman_image_set_clip_region32(pix, NULL);
+}
 
-    if (unlikely(cell->attrs.url)) {
-        pixman_color_t url_color = color_hex_to_pixman(
-            term->conf->colors.use_custom.url
-            ? term->conf->colors.url
-            : term->colors.table[3]
-            );
-        draw_underline(term, pix, font, &url_color, x, y, cell_cols);
-    }
+UNITTEST
+{
+    /* Cells without a foreground must not get decorations */
+    struct terminal term = {
+        .cell_width = 4,
+        .cell_height = 8,
+        .font_baseline = 6,
+        .cols = 4,
+    };
 
-draw_cursor:
-    if (has_cursor && (term->cursor_style != CURSOR_BLOCK || !term->kbd_focus))
-        draw_cursor(term, cell, font, pix, &fg, &bg, x, y, cell_cols);
+    struct fcft_font font = {.strikeout = {.position = 2, .thickness = 1}};
 
-    pixman_image_set_clip_region32(pix, NULL);
-    return cell_cols;
+    struct cell cells[4] = {
+        {.wc = U'a', .attrs = {.strikethrough = true, .conceal = true}},
+        {.wc = U'\t', .attrs = {.strikethrough = true}},
+        {.wc = CELL_SPACER + 1, .attrs = {.strikethrough = true}},
+        {.wc = U'a', .attrs = {.strikethrough = true}},
+    };
+    const struct row row = {.cells = cells};
+
+    const pixman_color_t fg = {0xffff, 0xffff, 0xffff, 0xffff};
+    const pixman_color_t bg = {0, 0, 0, 0xffff};
+
+    struct span_cell span_cells[4];
+    for (size_t i = 0; i < ALEN(span_cells); i++)
+        span_cells[i] = (struct span_cell){.fg = fg, .font = &font};
+
+    uint32_t data[8 * 16] = {0};
+    pixman_image_t *pix = pixman_image_create_bits_no_clear(
+        PIXMAN_x8r8g8b8, 16, 8, data, 16 * sizeof(uint32_t));
+
+    struct solid_fills fills = {.count = 0};
+    render_span(&term, pix, NULL, &row, 0, 0, 3, span_cells, &bg, &fills);
+    solid_fills_release(&fills);
+    pixman_image_unref(pix);
+
+    /* Strikeout is on pixel row baseline - position */
+    const uint32_t *strikeout = &data[(6 - 2) * 16];
+    for (int x = 0; x < 12; x++)
+        xassert((strikeout[x] & 0xffffff) == 0);
+    for (int x = 12; x < 16; x++)
+        xassert((strikeout[x] & 0xffffff) == 0xffffff);
 }
 
+/*
+ * Renders the dirty cells of a row. Consecutive dirty cells sharing
+ * the same background color are rendered as a span: the background is
+ * filled once, and glyphs are composited with one solid fill source
+ * per foreground color. Cells that can't be rendered as part of a span
+ * fall back to render_cell().
+ *
+ * Like render_cell(), cells are processed right to left, to let
+ * overflowing glyphs paint over their (already rendered) right
+ * neighbor.
+ */
 static void
 render_row(struct terminal *term, pixman_image_t *pix, pixman_region32_t *damage,
            struct row *row, int row_no, int cursor_col)
 {
-    for (int col = term->cols - 1; col >= 0; col--)
-        render_cell(term, pix, damage, row, row_no, col, cursor_col == col);
+    struct span_cell cells[term->cols];
+    struct solid_fills fills = {.count = 0};
+
+    pixman_color_t span_bg;
+    int span_first = -1;
+    int span_last = -1;
+
+    /* Every cell is rendered, and its clean bit set, below */
+    const bool all_dirty = row->all_dirty;
+    row->all_dirty = false;
+
+    for (int col = term->cols - 1; col >= 0; col--) {
+        struct cell *cell = &row->cells[col];
+
+        pixman_color_t bg;
+        bool in_span = (all_dirty || !cell->attrs.clean) &&
+            col != cursor_col &&
+            prepare_span_cell(term, cell, &cells[col], &bg);
+
+        /* Flush the current span, if this cell can't extend it */
+        if (span_last >= 0 && (!in_span || !pixman_color_equal(&bg, &span_bg))) {
+            render_span(term, pix, damage, row, row_no, span_first, span_last,
+                        cells, &span_bg, &fills);
+            span_first = span_last = -1;
+        }
+
+        if (!in_span) {
+            if (all_dirty)
+                cell->attrs.clean = 0;
+            render_cell(term, pix, damage, row, row_no, col, cursor_col == col);
+            continue;
+        }
+
+        cell->attrs.clean = 1;
+        cell->attrs.confined = true;
+
+        if (cell->attrs.blink && term->blink.fd < 0) {
+            mtx_lock(&term->render.workers.lock);
+            term_arm_blink_timer(term);
+            mtx_unlock(&term->render.workers.lock);
+        }
+
+        if (span_last < 0) {
+            span_last = col;
+            span_bg = bg;
+        }
+        span_first = col;
+    }
+
+    if (span_last >= 0) {
+        render_span(term, pix, damage, row, row_no, span_first, span_last,
+                    cells, &span_bg, &fills);
+    }
+
+    solid_fills_release(&fills);
 }
 
 static void
@@ -1486,7 +2143,7 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
         }
 
         /* Is the row dirty? */
-        struct row *row = term->grid->rows[abs_row_no];
+        struct row *row = grid_row_unpacked(term->grid->rows[abs_row_no]);
         xassert(row != NULL);  /* Should be visible */
 
         if (!row->dirty) {
@@ -1494,6 +2151,14 @@ render_sixel(struct terminal *term, pixman_image_t *pix,
             continue;
         }
 
+        /* We're only touching the cells beneath the image; make the
+         * whole-row damage explicit, for the regular renderer */
+        if (row->all_dirty) {
+            for (int col = 0; col < term->cols; col++)
+                row->cells[col].attrs.clean = 0;
+            row->all_dirty = false;
+        }
+
         int cursor_col = cursor->row == term_row_no ? cursor->col : -1;
 
         /*
@@ -1593,6 +2258,20 @@ render_sixel_images(struct terminal *term, pixman_image_t *pix,
     }
 }
 
+/* The part of a sixel that has been received, but not yet inserted */
+static void
+render_sixel_preview(struct terminal *term, pixman_image_t *pix,
+                     pixman_region32_t *damage,
+                     const struct coord *cursor)
+{
+    struct sixel preview;
+    if (likely(!sixel_preview(term, &preview)))
+        return;
+
+    render_sixel(term, pix, damage, cursor, &preview);
+    pixman_image_unref(preview.pix);
+}
+
 #if defined(FOOT_IME_ENABLED) && FOOT_IME_ENABLED
 static void
 render_ime_preedit_for_seat(struct terminal *term, struct seat *seat,
@@ -2047,12 +2726,172 @@ render_overlay(struct terminal *term)
     term->render.last_overlay_style = style;
 }
 
-int
+/*
+ * Renders the current frame's dirty rows, starting with the calling
+ * thread's own range. When that has been exhausted, rows are stolen
+ * from the other threads' ranges.
+ *
+ * Rows are claimed with an atomic increment of the range's 'next'
+ * index; no locks are taken.
+ */
+static void
+render_worker_rows(int my_id, pixman_region32_t *damage)
+{
+    struct terminal *term = render_pool.term;
+    pixman_image_t *pix = render_pool.buf->pix[my_id];
+    const struct coord cursor = render_pool.cursor;
+    const int count = render_pool.active;
+
+    for (int i = 0; i < count; i++) {
+        struct render_worker_range *range =
+            &render_pool.ranges[(my_id + i) % count];
+
+        while (true) {
+            const int idx = atomic_fetch_add_explicit(
+                &range->next, 1, memory_order_relaxed);
+
+            if (idx >= range->end)
+                break;
+
+            const int row_no = render_pool.rows[idx];
+            struct row *row = grid_row_in_view(term->grid, row_no);
+            int cursor_col = cursor.row == row_no ? cursor.col : -1;
+
+            render_row(term, pix, damage, row, row_no, cursor_col);
+        }
+    }
+}
+
+static void
+render_worker_sixel_scale(void)
+{
+    struct terminal *term = render_pool.term;
+
+    while (true) {
+        const int idx = atomic_fetch_add_explicit(
+            &render_pool.next_stripe, 1, memory_order_relaxed);
+
+        if (idx >= render_pool.stripes_count)
+            break;
+
+        const struct render_sixel_stripe *stripe = &render_pool.stripes[idx];
+        sixel_scale_rows(term, stripe->sixel, stripe->start, stripe->end);
+    }
+}
+
+/* Runs the current job on 'active - 1' workers, and the calling thread */
+static void
+render_workers_start(int active)
+{
+    render_pool.active = active;
+    atomic_store(&render_pool.remaining, render_pool.count);
+
+    /* Wake all workers; the release on unlock publishes the job */
+    mtx_lock(&render_pool.start_lock);
+    atomic_fetch_add(&render_pool.generation, 1);
+    cnd_broadcast(&render_pool.start);
+    mtx_unlock(&render_pool.start_lock);
+}
+
+static void
+render_workers_wait(void)
+{
+    while (sem_wait(&render_pool.done) < 0 && errno == EINTR)
+        ;
+}
+
+/*
+ * Scales the sixels in view whose cached, scaled, image is missing
+ * (e.g. after a font size change). The images are split into stripes
+ * of rows, which are scaled by the worker threads and this thread in
+ * parallel.
+ *
+ * Must be called before render_sixel_images(), which then finds the
+ * caches already up-to-date.
+ */
+static void
+render_sixel_images_scale(struct terminal *term)
+{
+    if (likely(tll_length(term->grid->sixel_images) == 0))
+        return;
+
+    const int stripe_height = 64;
+
+    const int scrollback_end
+        = (term->grid->offset + term->rows) & (term->grid->num_rows - 1);
+
+    const int view_start
+        = (term->grid->view
+           - scrollback_end
+           + term->grid->num_rows) & (term->grid->num_rows - 1);
+
+    const int view_end = view_start + term->rows - 1;
+
+    render_pool.stripes_count = 0;
+
+    tll_foreach(term->grid->sixel_images, it) {
+        struct sixel *six = &it->item;
+        const int start
+            = (six->pos.row
+               - scrollback_end
+               + term->grid->num_rows) & (term->grid->num_rows - 1);
+        const int end = start + six->rows - 1;
+
+        if (start > view_end)
+            continue;
+        else if (end < view_start)
+            break;
+
+        if (!sixel_scale_begin(term, six))
+            continue;
+
+        for (int y = 0; y < six->scaled.height; y += stripe_height) {
+            if (render_pool.stripes_count >= render_pool.stripes_size) {
+                render_pool.stripes_size = max(
+                    16, render_pool.stripes_size * 2);
+                render_pool.stripes = xrealloc(
+                    render_pool.stripes,
+                    render_pool.stripes_size * sizeof(render_pool.stripes[0]));
+            }
+
+            render_pool.stripes[render_pool.stripes_count++] =
+                (struct render_sixel_stripe){
+                    .sixel = six,
+                    .start = y,
+                    .end = min(y + stripe_height, six->scaled.height),
+                };
+        }
+    }
+
+    if (render_pool.stripes_count == 0)
+        return;
+
+    LOG_DBG("scaling sixels: %d stripes", render_pool.stripes_count);
+
+    atomic_store_explicit(&render_pool.next_stripe, 0, memory_order_relaxed);
+
+    render_pool.term = term;
+    render_pool.job = RENDER_JOB_SIXEL_SCALE;
+    render_workers_start(min(term->render.workers.count + 1,
+                             render_pool.stripes_count));
+
+    render_worker_sixel_scale();
+    render_workers_wait();
+
+    render_pool.term = NULL;
+}
+
+struct render_worker_context {
+    int my_id;
+    unsigned generation;
+};
+
+static int
 render_worker_thread(void *_ctx)
 {
     struct render_worker_context *ctx = _ctx;
-    struct terminal *term = ctx->term;
     const int my_id = ctx->my_id;
+    unsigned generation = ctx->generation;
     free(ctx);
 
     sigset_t mask;
@@ -2062,59 +2901,152 @@ render_worker_thread(void *_ctx)
     char proc_title[16];
     snprintf(proc_title, sizeof(proc_title), "foot:render:%d", my_id);
 
-    if (pthread_setname_np(pthread_self(), proc_title) < 0)
-        LOG_ERRNO("render worker %d: failed to set process title", my_id);
+    if (pthread_setname_np(pthread_self(), proc_title) < 0)
+        LOG_ERRNO("render worker %d: failed to set process title", my_id);
+
+    while (true) {
+        mtx_lock(&render_pool.start_lock);
+        while (atomic_load(&render_pool.generation) == generation)
+            cnd_wait(&render_pool.start, &render_pool.start_lock);
+        generation = atomic_load(&render_pool.generation);
+        mtx_unlock(&render_pool.start_lock);
+
+        if (atomic_load(&render_pool.quit))
+            return 0;
+
+        /* Terminals may use fewer threads than there are in the pool */
+        if (my_id < render_pool.active) {
+            switch (render_pool.job) {
+            case RENDER_JOB_ROWS: {
+                struct buffer *buf = render_pool.buf;
+                xassert(buf != NULL);
+                render_worker_rows(my_id, &buf->dirty[my_id]);
+                break;
+            }
+
+            case RENDER_JOB_SIXEL_SCALE:
+                render_worker_sixel_scale();
+                break;
+            }
+        }
+
+        /* Last one out signals the frame is done */
+        if (atomic_fetch_sub(&render_pool.remaining, 1) == 1)
+            sem_post(&render_pool.done);
+    };
+
+    return -1;
+}
+
+static void
+render_workers_stop(void)
+{
+    mtx_lock(&render_pool.start_lock);
+    atomic_store(&render_pool.quit, true);
+    atomic_fetch_add(&render_pool.generation, 1);
+    cnd_broadcast(&render_pool.start);
+    mtx_unlock(&render_pool.start_lock);
+
+    for (size_t i = 0; i < render_pool.count; i++)
+        thrd_join(render_pool.threads[i], NULL);
+
+    free(render_pool.threads);
+    free(render_pool.rows);
+    free(render_pool.ranges);
+    free(render_pool.stripes);
+    mtx_destroy(&render_pool.start_lock);
+    cnd_destroy(&render_pool.start);
+    sem_destroy(&render_pool.done);
+
+    render_pool.threads = NULL;
+    render_pool.rows = NULL;
+    render_pool.ranges = NULL;
+    render_pool.stripes = NULL;
+    render_pool.rows_size = 0;
+    render_pool.stripes_size = 0;
+    render_pool.count = 0;
+}
+
+bool
+render_workers_ref(uint16_t count)
+{
+    if (render_pool.ref_count == 0) {
+        if (sem_init(&render_pool.done, 0, 0) < 0) {
+            LOG_ERRNO("failed to instantiate render worker semaphore");
+            return false;
+        }
+
+        int err;
+        if ((err = mtx_init(&render_pool.start_lock, mtx_plain)) != thrd_success) {
+            LOG_ERR("failed to instantiate render worker mutex: %s (%d)",
+                    thrd_err_as_string(err), err);
+            sem_destroy(&render_pool.done);
+            return false;
+        }
+
+        if ((err = cnd_init(&render_pool.start)) != thrd_success) {
+            LOG_ERR("failed to instantiate render worker condition variable: %s (%d)",
+                    thrd_err_as_string(err), err);
+            mtx_destroy(&render_pool.start_lock);
+            sem_destroy(&render_pool.done);
+            return false;
+        }
+
+        atomic_init(&render_pool.generation, 0);
+        atomic_init(&render_pool.quit, false);
+        atomic_init(&render_pool.remaining, 0);
+    }
+
+    render_pool.ref_count++;
 
-    sem_t *start = &term->render.workers.start;
-    sem_t *done = &term->render.workers.done;
-    mtx_t *lock = &term->render.workers.lock;
+    if (count <= render_pool.count)
+        return true;
 
-    while (true) {
-        sem_wait(start);
-
-        struct buffer *buf = term->render.workers.buf;
-        bool frame_done = false;
-
-        /* Translate offset-relative cursor row to view-relative */
-        struct coord cursor = {-1, -1};
-        if (!term->hide_cursor) {
-            cursor = term->grid->cursor.point;
-            cursor.row += term->grid->offset;
-            cursor.row -= term->grid->view;
-            cursor.row &= term->grid->num_rows - 1;
-        }
+    /*
+     * Grow the pool. This is only done between frames, so the new
+     * threads can safely start at the current generation.
+     */
+    LOG_INFO("using %hu rendering threads", count);
 
-        while (!frame_done) {
-            mtx_lock(lock);
-            xassert(tll_length(term->render.workers.queue) > 0);
+    render_pool.threads = xrealloc(
+        render_pool.threads, count * sizeof(render_pool.threads[0]));
 
-            int row_no = tll_pop_front(term->render.workers.queue);
-            mtx_unlock(lock);
+    /* One range per worker, plus one for the main thread */
+    free(render_pool.ranges);
+    render_pool.ranges = xcalloc(count + 1, sizeof(render_pool.ranges[0]));
 
-            switch (row_no) {
-            default: {
-                xassert(buf != NULL);
+    for (size_t i = render_pool.count; i < count; i++) {
+        struct render_worker_context *ctx = xmalloc(sizeof(*ctx));
+        *ctx = (struct render_worker_context) {
+            .my_id = 1 + i,
+            .generation = atomic_load(&render_pool.generation),
+        };
 
-                struct row *row = grid_row_in_view(term->grid, row_no);
-                int cursor_col = cursor.row == row_no ? cursor.col : -1;
+        int ret = thrd_create(
+            &render_pool.threads[i], &render_worker_thread, ctx);
+        if (ret != thrd_success) {
+            LOG_ERR("failed to create render worker thread: %s (%d)",
+                    thrd_err_as_string(ret), ret);
+            free(ctx);
+            render_workers_unref();
+            return false;
+        }
 
-                render_row(term, buf->pix[my_id], &buf->dirty[my_id],
-                           row, row_no, cursor_col);
-                break;
-            }
+        render_pool.count++;
+    }
 
-            case -1:
-                frame_done = true;
-                sem_post(done);
-                break;
+    return true;
+}
 
-            case -2:
-                return 0;
-            }
-        }
-    };
+void
+render_workers_unref(void)
+{
+    xassert(render_pool.ref_count > 0);
 
-    return -1;
+    if (--render_pool.ref_count > 0)
+        return;
+
+    render_workers_stop();
 }
 
 struct csd_data
@@ -2943,7 +3875,11 @@ render_render_timer(struct terminal *term, struct timespec render_time)
 
     char usecs_str[256];
     double usecs = render_time.tv_sec * 1000000 + render_time.tv_nsec / 1000.0;
-    snprintf(usecs_str, sizeof(usecs_str), "%.2f µs", usecs);
+    snprintf(usecs_str, sizeof(usecs_str),
+             "%.2f µs, PTY: %.2f ms budget, %.1f KiB/frame",
+             usecs,
+             term->ptmx_sched.budget_ns / 1000000.0,
+             term->ptmx_sched.bytes_per_frame / 1024.0);
 
     char32_t text[256];
     mbstoc32(text, usecs_str, ALEN(text));
@@ -3032,7 +3968,7 @@ reapply_old_damage(struct terminal *term, struct buffer *new, struct buffer *old
         const struct row *row = grid_row_in_view(term->grid, r);
 
         bool row_all_dirty = true;
-        for (int c = 0; c < term->cols; c++) {
+        for (int c = 0; c < term->cols && !row->all_dirty; c++) {
             if (row->cells[c].attrs.clean) {
                 row_all_dirty = false;
                 full_repaint_needed = false;
@@ -3092,7 +4028,11 @@ reapply_old_damage(struct terminal *term, struct buffer *new, struct buffer *old
 static void
 dirty_old_cursor(struct terminal *term)
 {
-    if (term->render.last_cursor.row != NULL && !term->render.last_cursor.hidden) {
+    if (term->render.last_cursor.row != NULL &&
+        term->render.last_cursor.row->packed == NULL &&
+        !term->render.last_cursor.hidden)
+    {
+        /* Packed rows are fully re-rendered when unpacked */
         struct row *row = term->render.last_cursor.row;
         struct cell *cell = &row->cells[term->render.last_cursor.col];
         cell->attrs.clean = 0;
@@ -3119,85 +4059,15 @@ dirty_cursor(struct terminal *term)
     row->dirty = true;
 }
 
+/*
+ * Renders the dirty cells in view, and the sixels, into 'buf', and
+ * adds the rendered area to 'damage', and to the buffer's damage.
+ * Scroll damage must already have been applied.
+ */
 static void
-grid_render(struct terminal *term)
+render_grid_cells(struct terminal *term, struct buffer *buf,
+                  pixman_region32_t *damage)
 {
-    if (term->shutdown.in_progress)
-        return;
-
-    struct timespec start_time, start_double_buffering = {0}, stop_double_buffering = {0};
-
-    if (term->conf->tweak.render_timer != RENDER_TIMER_NONE)
-        clock_gettime(CLOCK_MONOTONIC, &start_time);
-
-    xassert(term->width > 0);
-    xassert(term->height > 0);
-
-    struct buffer_chain *chain = term->render.chains.grid;
-    bool use_alpha = !term->window->is_fullscreen &&
-                     term->colors.alpha != 0xffff;
-    struct buffer *buf = shm_get_buffer(
-        chain, term->width, term->height, use_alpha);
-
-    /* Dirty old and current cursor cell, to ensure they're repainted */
-    dirty_old_cursor(term);
-    dirty_cursor(term);
-
-    if (term->render.last_buf == NULL ||
-        term->render.last_buf->width != buf->width ||
-        term->render.last_buf->height != buf->height ||
-        term->render.margins)
-    {
-        force_full_repaint(term, buf);
-    }
-
-    else if (buf->age > 0) {
-        LOG_DBG("buffer age: %u (%p)", buf->age, (void *)buf);
-
-        xassert(term->render.last_buf != NULL);
-        xassert(term->render.last_buf != buf);
-        xassert(term->render.last_buf->width == buf->width);
-        xassert(term->render.last_buf->height == buf->height);
-
-        clock_gettime(CLOCK_MONOTONIC, &start_double_buffering);
-        reapply_old_damage(term, buf, term->render.last_buf);
-        clock_gettime(CLOCK_MONOTONIC, &stop_double_buffering);
-    }
-
-    if (term->render.last_buf != NULL) {
-        shm_unref(term->render.last_buf);
-        term->render.last_buf = NULL;
-    }
-
-    term->render.last_buf = buf;
-    shm_addref(buf);
-    buf->age = 0;
-
-
-    tll_foreach(term->grid->scroll_damage, it) {
-        switch (it->item.type) {
-        case DAMAGE_SCROLL:
-            if (term->grid->view == term->grid->offset)
-                grid_render_scroll(term, buf, &it->item);
-            break;
-
-        case DAMAGE_SCROLL_REVERSE:
-            if (term->grid->view == term->grid->offset)
-                grid_render_scroll_reverse(term, buf, &it->item);
-            break;
-
-        case DAMAGE_SCROLL_IN_VIEW:
-            grid_render_scroll(term, buf, &it->item);
-            break;
-
-        case DAMAGE_SCROLL_REVERSE_IN_VIEW:
-            grid_render_scroll_reverse(term, buf, &it->item);
-            break;
-        }
-
-        tll_remove(term->grid->scroll_damage, it);
-    }
-
     /*
      * Ensure selected cells have their 'selected' bit set. This is
      * normally "automatically" true - the bit is set when the
@@ -3242,7 +4112,8 @@ grid_render(struct terminal *term)
         for (int r = 0; r < term->rows; r++) {
             struct row *row = grid_row_in_view(term->grid, r);
 
-            if (!row->dirty)
+            /* Nothing to do if all cells are already dirty */
+            if (!row->dirty || row->all_dirty)
                 continue;
 
             /* Loop row from left to right, looking for dirty cells */
@@ -3295,20 +4166,27 @@ grid_render(struct terminal *term)
         }
     }
 
-    pixman_region32_t damage;
-    pixman_region32_init(&damage);
+    glyph_tiles_frame_begin(
+        term->render.glyph_tiles, term->cell_width, term->cell_height);
+
+    if (term->render.workers.count > 0)
+        render_sixel_images_scale(term);
 
-    render_sixel_images(term, buf->pix[0], &damage, &cursor);
+    render_sixel_images(term, buf->pix[0], damage, &cursor);
+    render_sixel_preview(term, buf->pix[0], damage, &cursor);
 
     if (term->render.workers.count > 0) {
-        mtx_lock(&term->render.workers.lock);
-        term->render.workers.buf = buf;
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            sem_post(&term->render.workers.start);
+        xassert(term->render.workers.count <= render_pool.count);
 
-        xassert(tll_length(term->render.workers.queue) == 0);
+        if (render_pool.rows_size < term->rows) {
+            render_pool.rows = xrealloc(
+                render_pool.rows, term->rows * sizeof(render_pool.rows[0]));
+            render_pool.rows_size = term->rows;
+        }
     }
 
+    int dirty_count = 0;
+
     for (int r = 0; r < term->rows; r++) {
         struct row *row = grid_row_in_view(term->grid, r);
 
@@ -3318,30 +4196,132 @@ grid_render(struct terminal *term)
         row->dirty = false;
 
         if (term->render.workers.count > 0)
-            tll_push_back(term->render.workers.queue, r);
+            render_pool.rows[dirty_count++] = r;
 
         else {
             /* TODO: damage region */
             int cursor_col = cursor.row == r ? cursor.col : -1;
-            render_row(term, buf->pix[0], &damage, row, r, cursor_col);
+            render_row(term, buf->pix[0], damage, row, r, cursor_col);
         }
     }
 
-    /* Signal workers the frame is done */
     if (term->render.workers.count > 0) {
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            tll_push_back(term->render.workers.queue, -1);
-        mtx_unlock(&term->render.workers.lock);
+        /*
+         * Split the dirty rows into one contiguous range per thread
+         * (including this one). Threads finishing early steal rows
+         * from the others.
+         */
+        const int count = term->render.workers.count + 1;
+
+        for (int i = 0; i < count; i++) {
+            struct render_worker_range *range = &render_pool.ranges[i];
+            atomic_store_explicit(
+                &range->next, dirty_count * i / count, memory_order_relaxed);
+            range->end = dirty_count * (i + 1) / count;
+        }
 
-        for (size_t i = 0; i < term->render.workers.count; i++)
-            sem_wait(&term->render.workers.done);
-        term->render.workers.buf = NULL;
+        render_pool.term = term;
+        render_pool.buf = buf;
+        render_pool.cursor = cursor;
+        render_pool.job = RENDER_JOB_ROWS;
+        render_workers_start(count);
+
+        render_worker_rows(0, damage);
+        render_workers_wait();
+
+        render_pool.term = NULL;
+        render_pool.buf = NULL;
     }
 
     for (size_t i = 0; i < term->render.workers.count; i++)
-        pixman_region32_union(&damage, &damage, &buf->dirty[i + 1]);
+        pixman_region32_union(damage, damage, &buf->dirty[i + 1]);
+
+    pixman_region32_union(&buf->dirty[0], &buf->dirty[0], damage);
+}
+
+static void
+grid_render(struct terminal *term)
+{
+    if (term->shutdown.in_progress)
+        return;
+
+    struct timespec start_time, start_double_buffering = {0}, stop_double_buffering = {0};
+
+    /* Always measured; the render time is used when sizing PTY parse slices */
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    xassert(term->width > 0);
+    xassert(term->height > 0);
+
+    struct buffer_chain *chain = term->render.chains.grid;
+    bool use_alpha = !term->window->is_fullscreen &&
+                     term->colors.alpha != 0xffff;
+    struct buffer *buf = shm_get_buffer(
+        chain, term->width, term->height, use_alpha);
+
+    /* Dirty old and current cursor cell, to ensure they're repainted */
+    dirty_old_cursor(term);
+    dirty_cursor(term);
+
+    if (term->render.last_buf == NULL ||
+        term->render.last_buf->width != buf->width ||
+        term->render.last_buf->height != buf->height ||
+        term->render.margins)
+    {
+        force_full_repaint(term, buf);
+    }
+
+    else if (buf->age > 0) {
+        LOG_DBG("buffer age: %u (%p)", buf->age, (void *)buf);
+
+        xassert(term->render.last_buf != NULL);
+        xassert(term->render.last_buf != buf);
+        xassert(term->render.last_buf->width == buf->width);
+        xassert(term->render.last_buf->height == buf->height);
+
+        clock_gettime(CLOCK_MONOTONIC, &start_double_buffering);
+        reapply_old_damage(term, buf, term->render.last_buf);
+        clock_gettime(CLOCK_MONOTONIC, &stop_double_buffering);
+    }
+
+    if (term->render.last_buf != NULL) {
+        shm_unref(term->render.last_buf);
+        term->render.last_buf = NULL;
+    }
+
+    term->render.last_buf = buf;
+    shm_addref(buf);
+    buf->age = 0;
+
+
+    tll_foreach(term->grid->scroll_damage, it) {
+        switch (it->item.type) {
+        case DAMAGE_SCROLL:
+            if (term->grid->view == term->grid->offset)
+                grid_render_scroll(term, buf, &it->item);
+            break;
+
+        case DAMAGE_SCROLL_REVERSE:
+            if (term->grid->view == term->grid->offset)
+                grid_render_scroll_reverse(term, buf, &it->item);
+            break;
+
+        case DAMAGE_SCROLL_IN_VIEW:
+            grid_render_scroll(term, buf, &it->item);
+            break;
+
+        case DAMAGE_SCROLL_REVERSE_IN_VIEW:
+            grid_render_scroll_reverse(term, buf, &it->item);
+            break;
+        }
+
+        tll_remove(term->grid->scroll_damage, it);
+    }
+
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
 
-    pixman_region32_union(&buf->dirty[0], &buf->dirty[0], &damage);
+    render_grid_cells(term, buf, &damage);
 
     {
         int box_count = 0;
@@ -3361,13 +4341,23 @@ grid_render(struct terminal *term)
     render_ime_preedit(term, buf);
     render_scrollback_position(term);
 
-    if (term->conf->tweak.render_timer != RENDER_TIMER_NONE) {
-        struct timespec end_time;
-        clock_gettime(CLOCK_MONOTONIC, &end_time);
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
 
-        struct timespec render_time;
-        timespec_sub(&end_time, &start_time, &render_time);
+    struct timespec render_time;
+    timespec_sub(&end_time, &start_time, &render_time);
 
+    {
+        /* Moving average, weighting the last frame 1/8 */
+        const uint64_t ns = render_time.tv_sec * 1000000000ull + render_time.tv_nsec;
+        uint64_t *avg = &term->render.frame_timing.render_ns;
+        *avg = *avg == 0 ? ns : (*avg * 7 + ns) / 8;
+
+        term->ptmx_sched.bytes_per_frame = term->ptmx_sched.bytes;
+        term->ptmx_sched.bytes = 0;
+    }
+
+    if (term->conf->tweak.render_timer != RENDER_TIMER_NONE) {
         struct timespec double_buffering_time;
         timespec_sub(&stop_double_buffering, &start_double_buffering, &double_buffering_time);
 
@@ -3379,13 +4369,16 @@ grid_render(struct terminal *term)
         case RENDER_TIMER_BOTH:
             LOG_INFO(
                 "frame rendered in %lds %9ldns "
-                "(%lds %9ldns rendering, %lds %9ldns double buffering)",
+                "(%lds %9ldns rendering, %lds %9ldns double buffering), "
+                "PTY: %lluns budget, %llu bytes/frame",
                 (long)total_render_time.tv_sec,
                 total_render_time.tv_nsec,
                 (long)render_time.tv_sec,
                 render_time.tv_nsec,
                 (long)double_buffering_time.tv_sec,
-                double_buffering_time.tv_nsec);
+                double_buffering_time.tv_nsec,
+                (unsigned long long)term->ptmx_sched.budget_ns,
+                (unsigned long long)term->ptmx_sched.bytes_per_frame);
             break;
 
         case RENDER_TIMER_OSD:
@@ -3414,7 +4407,13 @@ grid_render(struct terminal *term)
 
     wayl_win_scale(term->window, buf);
 
-    if (term->wl->presentation != NULL && term->conf->presentation_timings) {
+    /* Presentation feedback is needed for the presentation timings,
+     * the adaptive PTY parse budget, and key press latency tracing */
+    if (term->wl->presentation != NULL &&
+        (term->conf->presentation_timings ||
+         term->conf->tweak.pty_parse_budget_ns == 0 ||
+         term->render.latency.echoed))
+    {
         struct timespec commit_time;
         clock_gettime(term->wl->presentation_clock_id, &commit_time);
 
@@ -3431,16 +4430,25 @@ grid_render(struct terminal *term)
                 .input.tv_usec = term->render.input_time.tv_nsec / 1000,
                 .commit.tv_sec = commit_time.tv_sec,
                 .commit.tv_usec = commit_time.tv_nsec / 1000,
+                .traced = term->render.latency.echoed,
+                .key = term->render.latency.input,
+                .echo = term->render.latency.echo,
+                .commit_ts = commit_time,
             };
 
             wp_presentation_feedback_add_listener(
                 feedback, &presentation_feedback_listener, ctx);
+            tll_push_back(term->render.presentation_feedbacks, feedback);
 
             term->render.input_time.tv_sec = 0;
             term->render.input_time.tv_nsec = 0;
         }
     }
 
+    /* This is the frame showing the traced key press's echo */
+    if (term->render.latency.echoed)
+        term->render.latency.tracing = term->render.latency.echoed = false;
+
     if (term->conf->tweak.damage_whole_window) {
         wl_surface_damage_buffer(
             term->window->surface.surf, 0, 0, INT32_MAX, INT32_MAX);
@@ -3450,6 +4458,21 @@ grid_render(struct terminal *term)
     wl_surface_commit(term->window->surface.surf);
 }
 
+void
+render_grid_offscreen(struct terminal *term, struct buffer *buf)
+{
+    dirty_old_cursor(term);
+    dirty_cursor(term);
+
+    /* Nothing to scroll; the buffer isn't presented */
+    tll_free(term->grid->scroll_damage);
+
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    render_grid_cells(term, buf, &damage);
+    pixman_region32_fini(&damage);
+}
+
 static void
 render_search_box(struct terminal *term)
 {
@@ -4101,6 +5124,12 @@ tiocswinsz(struct terminal *term)
             LOG_ERRNO("TIOCSWINSZ");
         }
 
+        if (unlikely(term->pty_recorder != NULL)) {
+            pty_record_resize(
+                term->pty_recorder, term->cols, term->rows,
+                term->cols * term->cell_width, term->rows * term->cell_height);
+        }
+
         term_send_size_notification(term);
     }
 }
@@ -4125,7 +5154,7 @@ delayed_reflow_of_normal_grid(struct terminal *term)
         term->interactive_resizing.new_rows, term->normal.num_cols,
         term->interactive_resizing.old_screen_rows, term->rows,
         term->selection.coords.end.row >= 0 ? ALEN(tracking_points) : 0,
-        tracking_points);
+        tracking_points, term->scrollback_spill);
 
     /* Replace the current, truncated, "normal" grid with the
      * correctly reflowed one */
@@ -4148,6 +5177,8 @@ delayed_reflow_of_normal_grid(struct terminal *term)
 
     tll_free(term->normal.scroll_damage);
     sixel_reflow_grid(term, &term->normal);
+    term_pack_cold_scrollback(term);
+    term_reflow_pending_schedule(term);
 
     if (term->grid == &term->normal) {
         term_damage_view(term);
@@ -4477,7 +5508,7 @@ render_resize(struct terminal *term, int width, int height, uint8_t opts)
         {
             g.rows[i] = grid_row_alloc(g.num_cols, false);
             memcpy(g.rows[i]->cells,
-                   orig->rows[j]->cells,
+                   grid_row_unpacked(orig->rows[j])->cells,
                    g.num_cols * sizeof(g.rows[i]->cells[0]));
 
             if (orig->rows[j]->extra == NULL ||
@@ -4572,7 +5603,7 @@ render_resize(struct terminal *term, int width, int height, uint8_t opts)
         grid_resize_and_reflow(
             &term->normal, new_normal_grid_rows, new_cols, old_normal_rows, new_rows,
             term->selection.coords.end.row >= 0 ? ALEN(tracking_points) : 0,
-            tracking_points);
+            tracking_points, term->scrollback_spill);
     }
 
     grid_resize_without_reflow(
@@ -4588,6 +5619,10 @@ render_resize(struct terminal *term, int width, int height, uint8_t opts)
 
     sixel_reflow(term);
 
+    /* Reflow unpacks all rows */
+    term_pack_cold_scrollback(term);
+    term_reflow_pending_schedule(term);
+
     LOG_DBG("resized: grid: cols=%d, rows=%d "
             "(left-margin=%d, right-margin=%d, top-margin=%d, bottom-margin=%d)",
             term->cols, term->rows,
@@ -4796,64 +5831,97 @@ xcursor_callback(void *data, struct wl_callback *wl_callback, uint32_t callback_
 }
 
 static void
-fdm_hook_refresh_pending_terminals(struct fdm *fdm, void *data)
+refresh_pending_terminal(struct terminal *term)
 {
-    struct renderer *renderer = data;
-    struct wayland *wayl = renderer->wayl;
+    bool grid = term->render.refresh.grid;
+    bool csd = term->render.refresh.csd;
+    bool search = term->is_searching && term->render.refresh.search;
+    bool urls = urls_mode_is_active(term) && term->render.refresh.urls;
 
-    tll_foreach(renderer->wayl->terms, it) {
-        struct terminal *term = it->item;
+    if (!(grid | csd | search | urls))
+        return;
 
-        if (unlikely(term->shutdown.in_progress || !term->window->is_configured))
-            continue;
+    if (term->render.app_sync_updates.enabled && !(csd | search | urls))
+        return;
 
-        bool grid = term->render.refresh.grid;
-        bool csd = term->render.refresh.csd;
-        bool search = term->is_searching && term->render.refresh.search;
-        bool urls = urls_mode_is_active(term) && term->render.refresh.urls;
+    term->render.refresh.grid = false;
+    term->render.refresh.csd = false;
+    term->render.refresh.search = false;
+    term->render.refresh.urls = false;
 
-        if (!(grid | csd | search | urls))
-            continue;
+    if (term->window->frame_callback == NULL) {
+        struct grid *original_grid = term->grid;
+        if (urls_mode_is_active(term)) {
+            xassert(term->url_grid_snapshot != NULL);
+            term->grid = term->url_grid_snapshot;
+        }
 
-        if (term->render.app_sync_updates.enabled && !(csd | search | urls))
-            continue;
+        if (csd && term->window->csd_mode == CSD_YES) {
+            quirk_weston_csd_on(term);
+            render_csd(term);
+            quirk_weston_csd_off(term);
+        }
+        if (search)
+            render_search_box(term);
+        if (urls)
+            render_urls(term);
+        if (grid | csd | search | urls)
+            grid_render(term);
 
-        term->render.refresh.grid = false;
-        term->render.refresh.csd = false;
-        term->render.refresh.search = false;
-        term->render.refresh.urls = false;
+        tll_foreach(term->wl->seats, it) {
+            if (it->item.ime_focus == term)
+                ime_update_cursor_rect(&it->item);
+        }
 
-        if (term->window->frame_callback == NULL) {
-            struct grid *original_grid = term->grid;
-            if (urls_mode_is_active(term)) {
-                xassert(term->url_grid_snapshot != NULL);
-                term->grid = term->url_grid_snapshot;
-            }
+        term->grid = original_grid;
+    } else {
+        /* Tells the frame callback to render again */
+        term->render.pending.grid |= grid;
+        term->render.pending.csd |= csd;
+        term->render.pending.search |= search;
+        term->render.pending.urls |= urls;
+    }
+}
 
-            if (csd && term->window->csd_mode == CSD_YES) {
-                quirk_weston_csd_on(term);
-                render_csd(term);
-                quirk_weston_csd_off(term);
-            }
-            if (search)
-                render_search_box(term);
-            if (urls)
-                render_urls(term);
-            if (grid | csd | search | urls)
-                grid_render(term);
-
-            tll_foreach(term->wl->seats, it) {
-                if (it->item.ime_focus == term)
-                    ime_update_cursor_rect(&it->item);
-            }
+/*
+ * Terminals are rendered one at a time, on the shared render worker
+ * pool. Render the focused window first, then the windows whose frame
+ * callback is due, i.e. that can be rendered right away. The remaining
+ * windows only have their pending state updated, and are rendered by
+ * their frame callbacks.
+ */
+enum refresh_priority {
+    REFRESH_PRIO_FOCUSED,
+    REFRESH_PRIO_FRAME_DUE,
+    REFRESH_PRIO_DEFERRED,
+    REFRESH_PRIO_COUNT,
+};
 
-            term->grid = original_grid;
-        } else {
-            /* Tells the frame callback to render again */
-            term->render.pending.grid |= grid;
-            term->render.pending.csd |= csd;
-            term->render.pending.search |= search;
-            term->render.pending.urls |= urls;
+static enum refresh_priority
+refresh_priority(const struct terminal *term)
+{
+    if (term->window->frame_callback != NULL)
+        return REFRESH_PRIO_DEFERRED;
+    return term->kbd_focus ? REFRESH_PRIO_FOCUSED : REFRESH_PRIO_FRAME_DUE;
+}
+
+static void
+fdm_hook_refresh_pending_terminals(struct fdm *fdm, void *data)
+{
+    struct renderer *renderer = data;
+    struct wayland *wayl = renderer->wayl;
+
+    for (int prio = 0; prio < REFRESH_PRIO_COUNT; prio++) {
+        tll_foreach(renderer->wayl->terms, it) {
+            struct terminal *term = it->item;
+
+            if (unlikely(term->shutdown.in_progress || !term->window->is_configured))
+                continue;
+
+            if (refresh_priority(term) != prio)
+                continue;
+
+            refresh_pending_terminal(term);
         }
     }
 
@@ -30,11 +30,35 @@ bool render_xcursor_set(
     struct seat *seat, struct terminal *term, enum cursor_shape shape);
 bool render_xcursor_is_valid(const struct seat *seat, const char *cursor);
 
-struct render_worker_context {
-    int my_id;
-    struct terminal *term;
-};
-int render_worker_thread(void *_ctx);
+/*
+ * Render worker threads are shared by all terminals. Each terminal
+ * holds a reference to the pool, which is grown to the largest worker
+ * count requested.
+ */
+bool render_workers_ref(uint16_t count);
+void render_workers_unref(void);
+
+/*
+ * Renders the dirty cells in view into 'buf', like a regular frame,
+ * but without a window; nothing is scrolled, or committed. Only the
+ * buffer's pixman images and damage regions are used (one of each for
+ * every render worker, plus one). Used by foot-bench.
+ */
+struct buffer;
+void render_grid_offscreen(struct terminal *term, struct buffer *buf);
+
+/*
+ * Input-to-photon latency tracing. A key press, that was sent to the
+ * client application, is matched with the first PTY data read after
+ * it (its echo, presumably), and the first frame committed after
+ * that. When the frame is presented, the timings of each stage are
+ * recorded.
+ *
+ * Only one key press is traced at a time. render_latency_log() logs
+ * the percentiles of the most recent key presses.
+ */
+void render_latency_key_pressed(struct terminal *term);
+void render_latency_log(const struct terminal *term);
 
 struct csd_data {
     int x;
@@ -0,0 +1,104 @@
+#!/usr/bin/env -S python3 -u
+
+# Replays a PTY recording (foot.ini: tweak.pty-record) to stdout, with
+# the original chunking and pacing. Run it inside the terminal being
+# measured; combine with foot's --presentation-timings, or
+# tweak.render-timer, to measure frame latency.
+
+import argparse
+import fcntl
+import os
+import statistics
+import struct
+import sys
+import termios
+import time
+
+MAGIC = b'FOOTPTY1'
+HEADER = struct.Struct('=QI')
+SIZE = struct.Struct('=HHHH')
+
+DATA = 1
+RESIZE = 2
+
+
+def records(data):
+    offset = len(MAGIC)
+    while offset + HEADER.size <= len(data):
+        time_ns, header = HEADER.unpack_from(data, offset)
+        offset += HEADER.size
+
+        size = header >> 8
+        if offset + size > len(data):
+            break
+
+        yield time_ns, header & 0xff, data[offset:offset + size]
+        offset += size
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('file', type=argparse.FileType('rb'))
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help='pacing multiplier (2.0 = twice as fast)')
+
+    args = parser.parse_args()
+    data = args.file.read()
+
+    if not data.startswith(MAGIC):
+        print(f'{args.file.name}: not a PTY recording', file=sys.stderr)
+        return 1
+
+    lines, cols, _, _ = struct.unpack(
+        'HHHH',
+        fcntl.ioctl(sys.stdout.fileno(),
+                    termios.TIOCGWINSZ,
+                    struct.pack('HHHH', 0, 0, 0, 0)))
+
+    out = sys.stdout.fileno()
+    lateness = []
+    size_mismatch = False
+
+    start = time.monotonic_ns()
+
+    for time_ns, kind, payload in records(data):
+        if kind == RESIZE:
+            rec_cols, rec_rows, _, _ = SIZE.unpack_from(payload)
+            if (rec_cols, rec_rows) != (cols, lines):
+                size_mismatch = True
+            continue
+
+        if kind != DATA:
+            continue
+
+        due = start + time_ns / args.speed
+        now = time.monotonic_ns()
+        if now < due:
+            time.sleep((due - now) / 1e9)
+
+        # How far behind schedule we are; grows when the terminal
+        # can't keep up, and applies back pressure
+        lateness.append(max(0, time.monotonic_ns() - due) / 1e6)
+
+        view = memoryview(payload)
+        while view:
+            view = view[os.write(out, view):]
+
+    elapsed = (time.monotonic_ns() - start) / 1e9
+
+    print('\033[m\033[J')
+    if size_mismatch:
+        print('warning: recorded with a different window size')
+
+    if lateness:
+        lateness.sort()
+        n = len(lateness)
+        print(f'{n} chunks in {elapsed:.3f}s; lateness: '
+              f'p50={lateness[(n - 1) * 50 // 100]:.2f}ms '
+              f'p95={lateness[(n - 1) * 95 // 100]:.2f}ms '
+              f'p99={lateness[(n - 1) * 99 // 100]:.2f}ms '
+              f'mean={statistics.mean(lateness):.2f}ms')
+
+
+if __name__ == '__main__':
+    sys.exit(main())
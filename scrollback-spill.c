@@ -0,0 +1,447 @@
+#include "scrollback-spill.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LOG_MODULE "scrollback-spill"
+#define LOG_ENABLE_DBG 0
+#include "log.h"
+#include "composed.h"
+#include "debug.h"
+#include "grid.h"
+#include "macros.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+/*
+ * Precedes each row's encoded cells in the spill file. The cells are
+ * followed by 'composed_size' bytes of composed characters: for each
+ * composed cell, in column order, a one byte character count, followed
+ * by the (unaligned) characters.
+ */
+struct record {
+    uint32_t cols;
+    uint32_t size;
+    uint32_t linebreak;
+    uint32_t composed_size;
+};
+
+struct scrollback_spill {
+    int fd;
+    bool failed;    /* Set on write errors; no more rows are spilled */
+
+    const struct composed_table *composed;
+    struct cell *cells;  /* Scratch buffer, for packed rows */
+    int cells_size;
+
+    off_t size;     /* Bytes written to the file */
+    size_t count;   /* Number of rows, including those in 'buf' */
+    size_t flushed_count;
+
+    uint8_t *buf;   /* Write buffer */
+    size_t buf_size;
+    size_t buf_used;
+};
+
+static int
+create_spill_file(void)
+{
+    const char *tmpdir = getenv("TMPDIR");
+    if (tmpdir == NULL || tmpdir[0] == '\0')
+        tmpdir = "/tmp";
+
+    char *path = xasprintf("%s/foot-scrollback-XXXXXX", tmpdir);
+    int fd = mkostemp(path, O_CLOEXEC);
+
+    if (fd < 0)
+        LOG_ERRNO("%s: failed to create scrollback spill file", path);
+    else
+        unlink(path);
+
+    free(path);
+    return fd;
+}
+
+struct scrollback_spill *
+scrollback_spill_init(const struct composed_table *composed)
+{
+    int fd = create_spill_file();
+    if (fd < 0)
+        return NULL;
+
+    struct scrollback_spill *spill = xmalloc(sizeof(*spill));
+    *spill = (struct scrollback_spill){
+        .fd = fd,
+        .composed = composed,
+        .buf = xmalloc(WRITE_BUFFER_SIZE),
+        .buf_size = WRITE_BUFFER_SIZE,
+    };
+    return spill;
+}
+
+void
+scrollback_spill_destroy(struct scrollback_spill *spill)
+{
+    if (spill == NULL)
+        return;
+
+    LOG_DBG("destroying spill file: %zu rows, %lld bytes",
+            spill->count, (long long)spill->size);
+
+    close(spill->fd);
+    free(spill->cells);
+    free(spill->buf);
+    free(spill);
+}
+
+static bool
+flush(struct scrollback_spill *spill)
+{
+    size_t done = 0;
+
+    while (done < spill->buf_used) {
+        ssize_t ret = write(
+            spill->fd, &spill->buf[done], spill->buf_used - done);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERRNO("failed to write scrollback spill file; "
+                      "no more lines will be spilled");
+
+            /* Throw away what's in the buffer, including partially
+             * written rows */
+            if (ftruncate(spill->fd, spill->size) < 0 ||
+                lseek(spill->fd, spill->size, SEEK_SET) < 0)
+            {
+                LOG_ERRNO("failed to truncate scrollback spill file");
+            }
+
+            spill->failed = true;
+            spill->count = spill->flushed_count;
+            spill->buf_used = 0;
+            return false;
+        }
+
+        done += ret;
+    }
+
+    spill->size += spill->buf_used;
+    spill->flushed_count = spill->count;
+    spill->buf_used = 0;
+    return true;
+}
+
+static inline bool
+is_composed(char32_t wc)
+{
+    return wc >= CELL_COMB_CHARS_LO && wc <= CELL_COMB_CHARS_HI;
+}
+
+static const struct composed *
+lookup_composed(const struct scrollback_spill *spill, char32_t wc)
+{
+    return composed_lookup(spill->composed, wc - CELL_COMB_CHARS_LO);
+}
+
+void
+scrollback_spill_row(
+    struct scrollback_spill *spill, const struct row *row, int cols)
+{
+    if (unlikely(spill->failed))
+        return;
+
+    const struct cell *cells = row->cells;
+
+    if (row->packed != NULL) {
+        if (cols > spill->cells_size) {
+            spill->cells = xrealloc(spill->cells, cols * sizeof(spill->cells[0]));
+            spill->cells_size = cols;
+        }
+
+        grid_row_unpack_into(row, spill->cells, cols);
+        cells = spill->cells;
+    }
+
+    size_t composed_size = 0;
+    for (int c = 0; c < cols; c++) {
+        if (unlikely(is_composed(cells[c].wc))) {
+            const struct composed *composed = lookup_composed(spill, cells[c].wc);
+            composed_size += 1 + (composed != NULL
+                                  ? composed->count * sizeof(char32_t) : 0);
+        }
+    }
+
+    const size_t max_size = sizeof(struct record) +
+        grid_cells_encode_max_size(cols) + composed_size;
+
+    if (spill->buf_size - spill->buf_used < max_size) {
+        if (!flush(spill))
+            return;
+
+        if (spill->buf_size < max_size) {
+            spill->buf = xrealloc(spill->buf, max_size);
+            spill->buf_size = max_size;
+        }
+    }
+
+    uint8_t *p = &spill->buf[spill->buf_used];
+    const size_t size = grid_row_encode(row, cols, p + sizeof(struct record));
+
+    const struct record record = {
+        .cols = cols,
+        .size = size,
+        .linebreak = row->linebreak,
+        .composed_size = composed_size,
+    };
+    memcpy(p, &record, sizeof(record));
+
+    uint8_t *q = p + sizeof(record) + size;
+    for (int c = 0; c < cols && composed_size > 0; c++) {
+        if (likely(!is_composed(cells[c].wc)))
+            continue;
+
+        /* Should never be NULL; store an empty character, just in case */
+        const struct composed *composed = lookup_composed(spill, cells[c].wc);
+        const uint8_t count = composed != NULL ? composed->count : 0;
+
+        *q++ = count;
+        if (count > 0) {
+            memcpy(q, composed->chars, count * sizeof(char32_t));
+            q += count * sizeof(char32_t);
+        }
+    }
+
+    xassert(q == p + sizeof(record) + size + composed_size);
+
+    spill->buf_used += sizeof(record) + size + composed_size;
+    spill->count++;
+}
+
+void
+scrollback_spill_reset(struct scrollback_spill *spill)
+{
+    if (ftruncate(spill->fd, 0) < 0 || lseek(spill->fd, 0, SEEK_SET) < 0) {
+        LOG_ERRNO("failed to truncate scrollback spill file");
+        spill->failed = true;
+    }
+
+    spill->size = 0;
+    spill->count = 0;
+    spill->flushed_count = 0;
+    spill->buf_used = 0;
+}
+
+size_t
+scrollback_spill_count(const struct scrollback_spill *spill)
+{
+    return spill->count;
+}
+
+bool
+scrollback_spill_for_each(
+    struct scrollback_spill *spill, scrollback_spill_cb cb, void *data)
+{
+    if (spill->buf_used > 0)
+        flush(spill);
+
+    if (spill->size == 0)
+        return true;
+
+    /*
+     * Map the file, rather than reading it; the pages are file backed,
+     * and can be reclaimed by the kernel at any time, keeping the
+     * resident memory usage down even for huge spill files.
+     */
+    const uint8_t *map = mmap(
+        NULL, spill->size, PROT_READ, MAP_PRIVATE, spill->fd, 0);
+
+    if (map == MAP_FAILED) {
+        LOG_ERRNO("failed to mmap scrollback spill file");
+        return false;
+    }
+
+    madvise((void *)map, spill->size, MADV_SEQUENTIAL);
+
+    struct cell *cells = NULL;
+    int cells_size = 0;
+    struct composed *composed = NULL;
+    char32_t *chars = NULL;
+    size_t chars_size = 0;
+    bool ret = true;
+
+    for (off_t offset = 0; offset < spill->size;) {
+        struct record record;
+
+        if (spill->size - offset < (off_t)sizeof(record)) {
+            LOG_ERR("scrollback spill file is corrupt");
+            ret = false;
+            break;
+        }
+
+        memcpy(&record, &map[offset], sizeof(record));
+        offset += sizeof(record);
+
+        if (spill->size - offset < (off_t)record.size + record.composed_size) {
+            LOG_ERR("scrollback spill file is corrupt");
+            ret = false;
+            break;
+        }
+
+        if ((int)record.cols > cells_size) {
+            cells_size = record.cols;
+            cells = xrealloc(cells, cells_size * sizeof(cells[0]));
+            composed = xrealloc(composed, cells_size * sizeof(composed[0]));
+        }
+
+        grid_cells_decode(&map[offset], record.size, cells, record.cols);
+        offset += record.size;
+
+        /* The characters are copied, since they're unaligned */
+        if (record.composed_size / sizeof(char32_t) > chars_size) {
+            chars_size = record.composed_size / sizeof(char32_t);
+            chars = xrealloc(chars, chars_size * sizeof(chars[0]));
+        }
+
+        /* Re-map composed cells to indices into 'composed' */
+        const uint8_t *p = &map[offset];
+        const uint8_t *const end = p + record.composed_size;
+        size_t composed_count = 0;
+        size_t chars_used = 0;
+
+        for (int c = 0; c < (int)record.cols; c++) {
+            if (likely(!is_composed(cells[c].wc)))
+                continue;
+
+            const size_t count = p < end ? *p++ : 0;
+            if (end - p < (ptrdiff_t)(count * sizeof(char32_t))) {
+                LOG_ERR("scrollback spill file is corrupt");
+                ret = false;
+                break;
+            }
+
+            struct composed *comp = &composed[composed_count];
+            memset(comp, 0, sizeof(*comp));
+            comp->chars = &chars[chars_used];
+            comp->count = count;
+            comp->width = 1;
+
+            if (count > 0) {
+                memcpy(comp->chars, p, count * sizeof(char32_t));
+                p += count * sizeof(char32_t);
+                chars_used += count;
+            }
+
+            cells[c].wc = CELL_COMB_CHARS_LO + composed_count++;
+        }
+
+        if (!ret)
+            break;
+
+        offset += record.composed_size;
+
+        if (!cb(cells, record.cols, record.linebreak, composed, data)) {
+            ret = false;
+            break;
+        }
+    }
+
+    free(chars);
+    free(composed);
+    free(cells);
+    munmap((void *)map, spill->size);
+    return ret;
+}
+
+static bool UNUSED
+verify_spilled_row(const struct cell *cells, int cols, bool linebreak,
+                   const struct composed *composed, void *data)
+{
+    int *count = data;
+    const int i = (*count)++;
+
+    xassert(cols == 40 + i % 100);
+    xassert(linebreak == (i % 3 == 0));
+
+    for (int c = 0; c < cols; c++) {
+        if (i % 5 == 0 && c == cols - 1) {
+            /* Composed characters are indices into 'composed' */
+            xassert(cells[c].wc == CELL_COMB_CHARS_LO);
+            xassert(composed[0].count == 2);
+            xassert(composed[0].chars[0] == U'e');
+            xassert(composed[0].chars[1] == 0x301);
+            continue;
+        }
+
+        const char32_t expected = c < i % 50 ? U'a' + (i + c) % 26 : 0;
+        xassert(cells[c].wc == expected);
+    }
+    return true;
+}
+
+UNITTEST
+{
+    struct composed_table table;
+    composed_init(&table);
+
+    struct composed *node = xmalloc(sizeof(*node));
+    *node = (struct composed){
+        .chars = xmalloc(2 * sizeof(node->chars[0])),
+        .key = 0x1234,
+        .count = 2,
+        .width = 1,
+    };
+    node->chars[0] = U'e';
+    node->chars[1] = 0x301;
+    composed_insert(&table, node);
+
+    struct scrollback_spill *spill = scrollback_spill_init(&table);
+    if (spill == NULL) {
+        composed_free(&table);
+        return;
+    }
+
+    /* Rows of different widths, packed and unpacked */
+    for (int i = 0; i < 300; i++) {
+        const int cols = 40 + i % 100;
+        struct row *row = grid_row_alloc(cols, true);
+        row->linebreak = i % 3 == 0;
+
+        for (int c = 0; c < cols && c < i % 50; c++)
+            row->cells[c].wc = U'a' + (i + c) % 26;
+
+        if (i % 5 == 0)
+            row->cells[cols - 1].wc = CELL_COMB_CHARS_LO + 0x1234;
+
+        if (i % 2 == 0)
+            grid_row_pack(row, cols);
+
+        scrollback_spill_row(spill, row, cols);
+        grid_row_free(row);
+    }
+
+    /* Spilled rows don't depend on the composed table */
+    composed_free(&table);
+
+    xassert(scrollback_spill_count(spill) == 300);
+
+    int i = 0;
+    xassert(scrollback_spill_for_each(spill, &verify_spilled_row, &i));
+    xassert(i == 300);
+
+    scrollback_spill_reset(spill);
+    xassert(scrollback_spill_count(spill) == 0);
+
+    i = 0;
+    xassert(scrollback_spill_for_each(spill, &verify_spilled_row, &i));
+    xassert(i == 0);
+
+    scrollback_spill_destroy(spill);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "terminal.h"
+
+/*
+ * Append-only, file backed, store for rows that have been pushed out
+ * of the scrollback ring buffer.
+ *
+ * Rows are serialized with the same encoding as packed (cold
+ * scrollback) rows, and appended to an unlinked temporary file. Only
+ * a small write buffer is kept in memory.
+ *
+ * Composed characters are stored inline, rather than as keys into the
+ * terminal's composed table; the table is garbage collected, and only
+ * knows about the rows in the grid.
+ *
+ * The only reader is pipe-scrollback (term_scrollback_to_text());
+ * spilled rows are never paged back in, for scrolling or searching.
+ */
+struct scrollback_spill;
+struct composed;
+struct composed_table;
+
+/* 'composed' is used to resolve composed characters when spilling */
+struct scrollback_spill *scrollback_spill_init(
+    const struct composed_table *composed);
+void scrollback_spill_destroy(struct scrollback_spill *spill);
+
+/* Appends a row, which may be packed */
+void scrollback_spill_row(
+    struct scrollback_spill *spill, const struct row *row, int cols);
+
+/* Discards all spilled rows */
+void scrollback_spill_reset(struct scrollback_spill *spill);
+
+size_t scrollback_spill_count(const struct scrollback_spill *spill);
+
+/*
+ * Calls 'cb' for each spilled row, oldest first. 'cells' and
+ * 'composed' are only valid during the callback. Stops, and returns
+ * false, if 'cb' returns false, or if the spill file cannot be read.
+ *
+ * Composed characters are *not* keys into the terminal's composed
+ * table: 'cells[i].wc - CELL_COMB_CHARS_LO' is an index into
+ * 'composed', which holds the row's composed characters.
+ */
+typedef bool (*scrollback_spill_cb)(
+    const struct cell *cells, int cols, bool linebreak,
+    const struct composed *composed, void *data);
+
+bool scrollback_spill_for_each(
+    struct scrollback_spill *spill, scrollback_spill_cb cb, void *data);
@@ -118,6 +118,9 @@ search_cancel_keep_selection(struct terminal *term)
     term->is_searching = false;
     term->render.search_glyph_offset = 0;
 
+    /* Searching may have unpacked large parts of the scrollback */
+    term_pack_cold_scrollback(term);
+
     /* Reset IME state */
     if (term_ime_is_enabled(term)) {
         term_ime_disable(term);
@@ -136,6 +139,9 @@ search_begin(struct terminal *term)
     search_cancel_keep_selection(term);
     selection_cancel(term);
 
+    /* Old scrollback, not yet reflowed after a resize */
+    term_reflow_pending_finish(term);
+
     /* Reset IME state */
     if (term_ime_is_enabled(term)) {
         term_ime_disable(term);
@@ -276,7 +282,7 @@ matches_cell(const struct terminal *term, const struct cell *cell, size_t search
 
     if (base >= CELL_COMB_CHARS_LO && base <= CELL_COMB_CHARS_HI)
     {
-        composed = composed_lookup(term->composed, base - CELL_COMB_CHARS_LO);
+        composed = composed_lookup(&term->composed, base - CELL_COMB_CHARS_LO);
         base = composed->chars[0];
     }
 
@@ -326,7 +332,7 @@ find_next(struct terminal *term, enum search_direction direction,
          ;
          backward ? ROW_DEC(match_start_row) : ROW_INC(match_start_row)) {
 
-        const struct row *row = grid->rows[match_start_row];
+        const struct row *row = grid_row_unpacked(grid->rows[match_start_row]);
         if (row == NULL) {
             if (match_start_row == abs_end.row)
                 break;
@@ -364,7 +370,7 @@ find_next(struct terminal *term, enum search_direction direction,
                     ROW_INC(match_end_row);
                     match_end_col = 0;
 
-                    match_row = grid->rows[match_end_row];
+                    match_row = grid_row_unpacked(grid->rows[match_end_row]);
                     if (match_row == NULL)
                         break;
                 }
@@ -672,7 +678,7 @@ coord_advance_left(const struct terminal *term, struct coord *pos,
             return false;
 
         if (row != NULL)
-            *row = grid->rows[new_pos.row];
+            *row = grid_row_unpacked(grid->rows[new_pos.row]);
     }
 
     *pos = new_pos;
@@ -694,7 +700,7 @@ coord_advance_right(const struct terminal *term, struct coord *pos,
             return false;
 
         if (row != NULL)
-            *row = grid->rows[new_pos.row];
+            *row = grid_row_unpacked(grid->rows[new_pos.row]);
     }
 
     *pos = new_pos;
@@ -715,7 +721,7 @@ search_extend_find_char(const struct terminal *term, struct coord *target,
 
     *target = pos;
 
-    const struct row *row = term->grid->rows[pos.row];
+    const struct row *row = grid_row_unpacked(term->grid->rows[pos.row]);
 
     while (true) {
         switch (direction) {
@@ -870,7 +876,7 @@ search_extend_left(struct terminal *term, const struct coord *target)
 
     const struct coord last_coord = selection_get_start(term);
     struct coord pos = *target;
-    const struct row *row = term->grid->rows[pos.row];
+    const struct row *row = grid_row_unpacked(term->grid->rows[pos.row]);
 
     const bool move_cursor = term->search.cursor != 0;
 
@@ -934,7 +940,7 @@ search_extend_right(struct terminal *term, const struct coord *target)
         return;
 
     struct coord pos = selection_get_end(term);
-    const struct row *row = term->grid->rows[pos.row];
+    const struct row *row = grid_row_unpacked(term->grid->rows[pos.row]);
 
     const bool move_cursor = term->search.cursor == term->search.len;
 
@@ -220,7 +220,7 @@ foreach_selected_normal(
     end_row &= (grid_rows - 1);
 
     for (int r = start_row; r != end_row; r = (r + 1) & (grid_rows - 1)) {
-        struct row *row = term->grid->rows[r];
+        struct row *row = grid_row_unpacked(term->grid->rows[r]);
         xassert(row != NULL);
 
         for (int c = start_col; c <= term->cols - 1; c++) {
@@ -232,7 +232,7 @@ foreach_selected_normal(
     }
 
     /* Last, partial row */
-    struct row *row = term->grid->rows[end_row];
+    struct row *row = grid_row_unpacked(term->grid->rows[end_row]);
     xassert(row != NULL);
 
     for (int c = start_col; c <= end_col; c++) {
@@ -273,7 +273,7 @@ foreach_selected_block(
 
     int r = top_left.row;
     while (true) {
-        struct row *row = term->grid->rows[r];
+        struct row *row = grid_row_unpacked(term->grid->rows[r]);
         xassert(row != NULL);
 
         for (int c = top_left.col; c <= bottom_right.col; c++) {
@@ -352,7 +352,7 @@ selection_find_word_boundary_left(const struct terminal *term, struct coord *pos
     xassert(pos->row >= 0);
     pos->row &= grid->num_rows - 1;
 
-    const struct row *r = grid->rows[pos->row];
+    const struct row *r = grid_row_unpacked(grid->rows[pos->row]);
     char32_t c = r->cells[pos->col].wc;
 
     while (c >= CELL_SPACER) {
@@ -364,7 +364,7 @@ selection_find_word_boundary_left(const struct terminal *term, struct coord *pos
     }
 
     if (c >= CELL_COMB_CHARS_LO && c <= CELL_COMB_CHARS_HI)
-        c = composed_lookup(term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
+        c = composed_lookup(&term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
 
     bool initial_is_space = c == 0 || isc32space(c);
     bool initial_is_delim =
@@ -376,7 +376,7 @@ selection_find_word_boundary_left(const struct terminal *term, struct coord *pos
         int next_col = pos->col - 1;
         int next_row = pos->row;
 
-        const struct row *row = grid->rows[next_row];
+        const struct row *row = grid_row_unpacked(grid->rows[next_row]);
 
         /* Linewrap */
         if (next_col < 0) {
@@ -391,7 +391,7 @@ selection_find_word_boundary_left(const struct terminal *term, struct coord *pos
                 break;
             }
 
-            row = grid->rows[next_row];
+            row = grid_row_unpacked(grid->rows[next_row]);
 
             if (row->linebreak) {
                 /* Hard linebreak, treat as space. I.e. break selection */
@@ -408,7 +408,7 @@ selection_find_word_boundary_left(const struct terminal *term, struct coord *pos
         }
 
         if (c >= CELL_COMB_CHARS_LO && c <= CELL_COMB_CHARS_HI)
-            c = composed_lookup(term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
+            c = composed_lookup(&term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
 
         bool is_space = c == 0 || isc32space(c);
         bool is_delim =
@@ -441,7 +441,7 @@ selection_find_word_boundary_right(const struct terminal *term, struct coord *po
     xassert(pos->row >= 0);
     pos->row &= grid->num_rows - 1;
 
-    const struct row *r = grid->rows[pos->row];
+    const struct row *r = grid_row_unpacked(grid->rows[pos->row]);
     char32_t c = r->cells[pos->col].wc;
 
     while (c >= CELL_SPACER) {
@@ -453,7 +453,7 @@ selection_find_word_boundary_right(const struct terminal *term, struct coord *po
     }
 
     if (c >= CELL_COMB_CHARS_LO && c <= CELL_COMB_CHARS_HI)
-        c = composed_lookup(term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
+        c = composed_lookup(&term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
 
     bool initial_is_space = c == 0 || isc32space(c);
     bool initial_is_delim =
@@ -466,7 +466,7 @@ selection_find_word_boundary_right(const struct terminal *term, struct coord *po
         int next_col = pos->col + 1;
         int next_row = pos->row;
 
-        const struct row *row = term->grid->rows[next_row];
+        const struct row *row = grid_row_unpacked(term->grid->rows[next_row]);
 
         /* Linewrap */
         if (next_col >= term->cols) {
@@ -483,7 +483,7 @@ selection_find_word_boundary_right(const struct terminal *term, struct coord *po
                 break;
             }
 
-            row = grid->rows[next_row];
+            row = grid_row_unpacked(grid->rows[next_row]);
         }
 
         c = row->cells[next_col].wc;
@@ -497,7 +497,7 @@ selection_find_word_boundary_right(const struct terminal *term, struct coord *po
         }
 
         if (c >= CELL_COMB_CHARS_LO && c <= CELL_COMB_CHARS_HI)
-            c = composed_lookup(term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
+            c = composed_lookup(&term->composed, c - CELL_COMB_CHARS_LO)->chars[0];
 
         bool is_space = c == 0 || isc32space(c);
         bool is_delim =
@@ -906,7 +906,7 @@ mark_selected_region(struct terminal *term, pixman_box32_t *boxes,
              rel_r < box->y2;
              r = (r + 1) & (term->grid->num_rows - 1), rel_r++)
         {
-            struct row *row = term->grid->rows[r];
+            struct row *row = grid_row_unpacked(term->grid->rows[r]);
             xassert(row != NULL);
 
             if (dirty_cells)
@@ -1045,7 +1045,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     /* First, make sure 'start' isn't in the middle of a
      * multi-column character */
     while (true) {
-        const struct row *row = term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)];
+        const struct row *row = grid_row_unpacked(term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)]);
         const struct cell *cell = &row->cells[pivot_start->col];
 
         if (cell->wc < CELL_SPACER)
@@ -1070,7 +1070,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     if (new_direction == SELECTION_RIGHT) {
         bool keep_going = true;
         while (keep_going) {
-            const struct row *row = term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)];
+            const struct row *row = grid_row_unpacked(term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)]);
             const char32_t wc = row->cells[pivot_end->col].wc;
 
             keep_going = wc >= CELL_SPACER;
@@ -1086,7 +1086,7 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
     } else {
         bool keep_going = true;
         while (keep_going) {
-            const struct row *row = term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)];
+            const struct row *row = grid_row_unpacked(term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)]);
             const char32_t wc = pivot_start->col < term->cols - 1
                 ? row->cells[pivot_start->col + 1].wc : 0;
 
@@ -1102,9 +1102,9 @@ set_pivot_point_for_block_and_char_wise(struct terminal *term,
         }
     }
 
-    xassert(term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)]->
+    xassert(grid_row_unpacked(term->grid->rows[pivot_start->row & (term->grid->num_rows - 1)])->
            cells[pivot_start->col].wc <= CELL_SPACER);
-    xassert(term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)]->
+    xassert(grid_row_unpacked(term->grid->rows[pivot_end->row & (term->grid->num_rows - 1)])->
            cells[pivot_end->col].wc <= CELL_SPACER + 1);
 }
 
@@ -1236,8 +1236,8 @@ selection_update(struct terminal *term, int col, int row)
     size_t start_row_idx = new_start.row & (term->grid->num_rows - 1);
     size_t end_row_idx = new_end.row & (term->grid->num_rows - 1);
 
-    const struct row *row_start = term->grid->rows[start_row_idx];
-    const struct row *row_end = term->grid->rows[end_row_idx];
+    const struct row *row_start = grid_row_unpacked(term->grid->rows[start_row_idx]);
+    const struct row *row_end = grid_row_unpacked(term->grid->rows[end_row_idx]);
 
     /* If an end point is in the middle of a multi-column character,
      * expand the selection to cover the entire character */
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <limits.h>
 
+#if defined(__SSE2__)
+ #include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
 #define LOG_MODULE "sixel"
 #define LOG_ENABLE_DBG 0
 #include "log.h"
@@ -14,10 +20,14 @@
 #include "xmalloc.h"
 #include "xsnprintf.h"
 
+/* Pixels per column in the band buffer; 6 used, 2 padding */
+#define SIXEL_BAND_STRIDE 8
+
 static size_t count;
 
 static void sixel_put_generic(struct terminal *term, uint8_t c);
 static void sixel_put_ar_11(struct terminal *term, uint8_t c);
+static void band_flush(struct terminal *term);
 
 /* VT330/VT340 Programmer Reference Manual  - Table 2-3 VT340 Default Color Map */
 static const uint32_t vt340_default_colors[16] = {
@@ -42,10 +52,18 @@ static const uint32_t vt340_default_colors[16] = {
 _Static_assert(sizeof(vt340_default_colors) / sizeof(vt340_default_colors[0]) == 16,
                "wrong number of elements");
 
+static void ALWAYS_INLINE inline
+memset_u32(uint32_t *data, uint32_t value, size_t count)
+{
+    static_assert(sizeof(wchar_t) == 4, "wchar_t is not 4 bytes");
+    wmemset((wchar_t *)data, (wchar_t)value, count);
+}
+
 void
 sixel_fini(struct terminal *term)
 {
     free(term->sixel.image.data);
+    free(term->sixel.band.data);
     free(term->sixel.private_palette);
     free(term->sixel.shared_palette);
 }
@@ -98,6 +116,7 @@ sixel_init(struct terminal *term, int p1, int p2, int p3)
     term->sixel.image.height = 0;
     term->sixel.image.alloc_height = 0;
     term->sixel.image.bottom_pixel = 0;
+    term->sixel.image.done_height = 0;
 
     if (term->sixel.use_private_palette) {
         xassert(term->sixel.private_palette == NULL);
@@ -162,6 +181,13 @@ sixel_init(struct terminal *term, int p1, int p2, int p3)
         ? 0x00000000u
         : bg;
 
+    /* The band buffer is kept between images; reset it to the new bg */
+    term->sixel.band.cols = 0;
+    if (term->sixel.band.data != NULL) {
+        memset_u32(term->sixel.band.data, term->sixel.default_bg,
+                   term->sixel.band.width * SIXEL_BAND_STRIDE);
+    }
+
     count = 0;
     return pan == 1 && pad == 1 ? &sixel_put_ar_11 : &sixel_put_generic;
 }
@@ -219,6 +245,10 @@ sixel_erase(struct terminal *term, struct sixel *sixel)
             continue;
         }
 
+        /* Packed rows are fully re-rendered when unpacked */
+        if (row->packed != NULL)
+            continue;
+
         row->dirty = true;
 
         for (int c = sixel->pos.col; c < min(sixel->pos.col + sixel->cols, term->cols); c++)
@@ -384,6 +414,8 @@ sixel_insert(struct terminal *term, struct sixel sixel)
     tll_push_back(term->grid->sixel_images, sixel);
 
 out:
+    grid_sixel_rows_add(term->grid, sixel.pos.row, sixel.rows);
+
 #if defined(LOG_ENABLE_DBG) && LOG_ENABLE_DBG
     LOG_DBG("sixel list after insertion:");
     tll_foreach(term->grid->sixel_images, it) {
@@ -399,6 +431,15 @@ sixel_scroll_up(struct terminal *term, int rows)
     if (likely(tll_length(term->grid->sixel_images) == 0))
         return;
 
+    /* The rows about to be recycled, i.e. the oldest scrollback rows */
+    if (!grid_sixel_rows_any(
+            term->grid, grid_row_sb_to_abs(term->grid, term->rows, 0), rows))
+    {
+        return;
+    }
+
+    bool removed = false;
+
     tll_rforeach(term->grid->sixel_images, it) {
         struct sixel *six = &it->item;
 
@@ -407,6 +448,7 @@ sixel_scroll_up(struct terminal *term, int rows)
         if (six_start < rows) {
             sixel_erase(term, six);
             tll_remove(term->grid->sixel_images, it);
+            removed = true;
         } else {
             /*
              * Unfortunately, we cannot break here.
@@ -420,9 +462,9 @@ sixel_scroll_up(struct terminal *term, int rows)
         }
     }
 
-    term->bits_affecting_ascii_printer.sixels =
-        tll_length(term->grid->sixel_images) > 0;
-    term_update_ascii_printer(term);
+    if (removed)
+        grid_sixel_rows_rebuild(term->grid);
+
     verify_sixels(term);
 }
 
@@ -434,6 +476,17 @@ sixel_scroll_down(struct terminal *term, int rows)
 
     xassert(term->grid->num_rows >= rows);
 
+    /* The rows pushed out of the bottom of the scrollback */
+    if (!grid_sixel_rows_any(
+            term->grid,
+            grid_row_sb_to_abs(term->grid, term->rows, term->grid->num_rows - rows),
+            rows))
+    {
+        return;
+    }
+
+    bool removed = false;
+
     tll_foreach(term->grid->sixel_images, it) {
         struct sixel *six = &it->item;
 
@@ -442,13 +495,14 @@ sixel_scroll_down(struct terminal *term, int rows)
         if (six_end >= term->grid->num_rows - rows) {
             sixel_erase(term, six);
             tll_remove(term->grid->sixel_images, it);
+            removed = true;
         } else
             break;
     }
 
-    term->bits_affecting_ascii_printer.sixels =
-        tll_length(term->grid->sixel_images) > 0;
-    term_update_ascii_printer(term);
+    if (removed)
+        grid_sixel_rows_rebuild(term->grid);
+
     verify_sixels(term);
 }
 
@@ -748,8 +802,11 @@ sixel_overwrite(struct terminal *term, struct sixel *six,
     pixman_region32_fini(&diff);
 }
 
-/* Row numbers are absolute */
-static void
+/*
+ * Row numbers are absolute. Returns true if an image was split, or
+ * removed; i.e. if the grid's sixel rows need to be rebuilt.
+ */
+static bool
 _sixel_overwrite_by_rectangle(
     struct terminal *term, int row, int col, int height, int width,
     pixman_image_t **pix, bool *opaque)
@@ -771,6 +828,7 @@ _sixel_overwrite_by_rectangle(
         term->grid, term->rows, start);
 
     bool UNUSED would_have_breaked = false;
+    bool removed = false;
 
     tll_foreach(term->grid->sixel_images, it) {
         struct sixel *six = &it->item;
@@ -821,6 +879,7 @@ _sixel_overwrite_by_rectangle(
                 sixel_overwrite(term, &to_be_erased, start, col, height, width,
                                 pix, opaque);
                 sixel_erase(term, &to_be_erased);
+                removed = true;
             } else
                 xassert(!collides);
         } else
@@ -835,6 +894,8 @@ _sixel_overwrite_by_rectangle(
 #if defined(_DEBUG)
     pixman_region32_fini(&overwrite_rect);
 #endif
+
+    return removed;
 }
 
 void
@@ -848,17 +909,21 @@ sixel_overwrite_by_rectangle(
     const int end = (start + height - 1) & (term->grid->num_rows - 1);
     const bool wraps = end < start;
 
+    if (!grid_sixel_rows_any(term->grid, start, height))
+        return;
+
+    bool removed;
+
     if (wraps) {
         int rows_to_wrap_around = term->grid->num_rows - start;
         xassert(height - rows_to_wrap_around > 0);
-        _sixel_overwrite_by_rectangle(term, start, col, rows_to_wrap_around, width, NULL, NULL);
-        _sixel_overwrite_by_rectangle(term, 0, col, height - rows_to_wrap_around, width, NULL, NULL);
+        removed = _sixel_overwrite_by_rectangle(term, start, col, rows_to_wrap_around, width, NULL, NULL);
+        removed |= _sixel_overwrite_by_rectangle(term, 0, col, height - rows_to_wrap_around, width, NULL, NULL);
     } else
-        _sixel_overwrite_by_rectangle(term, start, col, height, width, NULL, NULL);
+        removed = _sixel_overwrite_by_rectangle(term, start, col, height, width, NULL, NULL);
 
-    term->bits_affecting_ascii_printer.sixels =
-        tll_length(term->grid->sixel_images) > 0;
-    term_update_ascii_printer(term);
+    if (removed)
+        grid_sixel_rows_rebuild(term->grid);
 }
 
 /* Row numbers are relative to grid offset */
@@ -879,7 +944,12 @@ sixel_overwrite_by_row(struct terminal *term, int _row, int col, int width)
         width = term->grid->num_cols - col;
 
     const int row = (term->grid->offset + _row) & (term->grid->num_rows - 1);
+
+    if (likely(!grid_sixel_row(term->grid, row)))
+        return;
+
     const int scrollback_rel_row = grid_row_abs_to_sb(term->grid, term->rows, row);
+    bool removed = false;
 
     tll_foreach(term->grid->sixel_images, it) {
         struct sixel *six = &it->item;
@@ -910,13 +980,13 @@ sixel_overwrite_by_row(struct terminal *term, int _row, int col, int width)
 
                 sixel_overwrite(term, &to_be_erased, row, col, 1, width, NULL, NULL);
                 sixel_erase(term, &to_be_erased);
+                removed = true;
             }
         }
     }
 
-    term->bits_affecting_ascii_printer.sixels =
-        tll_length(term->grid->sixel_images) > 0;
-    term_update_ascii_printer(term);
+    if (removed)
+        grid_sixel_rows_rebuild(term->grid);
 }
 
 void
@@ -939,6 +1009,96 @@ sixel_cell_size_changed(struct terminal *term)
         sixel_invalidate_cache(&it->item);
 }
 
+bool
+sixel_scale_begin(const struct terminal *term, struct sixel *six)
+{
+    if (six->pix != NULL)
+        return false;
+
+    /* Cache should be invalid */
+    xassert(six->scaled.data == NULL);
+    xassert(six->scaled.pix == NULL);
+    xassert(six->scaled.width < 0);
+    xassert(six->scaled.height < 0);
+
+    if (six->cell_width == term->cell_width &&
+        six->cell_height == term->cell_height)
+    {
+        six->pix = six->original.pix;
+        six->width = six->original.width;
+        six->height = six->original.height;
+        return false;
+    }
+
+    const double width_ratio = (double)term->cell_width / six->cell_width;
+    const double height_ratio = (double)term->cell_height / six->cell_height;
+
+    int scaled_width = (double)six->original.width * width_ratio;
+    int scaled_height = (double)six->original.height * height_ratio;
+    int scaled_stride = scaled_width * sizeof(uint32_t);
+
+    LOG_DBG("scaling sixel: %dx%d -> %dx%d",
+            six->original.width, six->original.height,
+            scaled_width, scaled_height);
+
+    uint8_t *scaled_data = xmalloc(scaled_height * scaled_stride);
+    pixman_image_t *scaled_pix = pixman_image_create_bits_no_clear(
+        PIXMAN_a8r8g8b8, scaled_width, scaled_height,
+        (uint32_t *)scaled_data, scaled_stride);
+
+    six->scaled.data = scaled_data;
+    six->scaled.pix = six->pix = scaled_pix;
+    six->scaled.width = six->width = scaled_width;
+    six->scaled.height = six->height = scaled_height;
+    return true;
+}
+
+void
+sixel_scale_rows(const struct terminal *term, const struct sixel *six,
+                 int start, int end)
+{
+    xassert(start >= 0);
+    xassert(end <= six->scaled.height);
+
+    if (start >= end)
+        return;
+
+    const double width_ratio = (double)term->cell_width / six->cell_width;
+    const double height_ratio = (double)term->cell_height / six->cell_height;
+
+    struct pixman_f_transform scale;
+    pixman_f_transform_init_scale(
+        &scale, 1. / width_ratio, 1. / height_ratio);
+
+    struct pixman_transform _scale;
+    pixman_transform_from_pixman_f_transform(&_scale, &scale);
+
+    /*
+     * Use private source and destination images; pixman images may
+     * not be used by multiple threads at once, and this is called
+     * from the render worker threads.
+     */
+    pixman_image_t *src = pixman_image_create_bits_no_clear(
+        PIXMAN_a8r8g8b8, six->original.width, six->original.height,
+        pixman_image_get_data(six->original.pix),
+        pixman_image_get_stride(six->original.pix));
+    pixman_image_set_transform(src, &_scale);
+    pixman_image_set_filter(src, PIXMAN_FILTER_BILINEAR, NULL, 0);
+
+    const int stride = six->scaled.width * sizeof(uint32_t);
+    pixman_image_t *dst = pixman_image_create_bits_no_clear(
+        PIXMAN_a8r8g8b8, six->scaled.width, end - start,
+        (uint32_t *)((uint8_t *)six->scaled.data + start * stride), stride);
+
+    /* The source offset is in (scaled) destination coordinates */
+    pixman_image_composite32(
+        PIXMAN_OP_SRC, src, NULL, dst, 0, start, 0, 0,
+        0, 0, six->scaled.width, end - start);
+
+    pixman_image_unref(dst);
+    pixman_image_unref(src);
+}
+
 void
 sixel_sync_cache(const struct terminal *term, struct sixel *six)
 {
@@ -971,55 +1131,8 @@ sixel_sync_cache(const struct terminal *term, struct sixel *six)
         return;
     }
 
-    /* Cache should be invalid */
-    xassert(six->scaled.data == NULL);
-    xassert(six->scaled.pix == NULL);
-    xassert(six->scaled.width < 0);
-    xassert(six->scaled.height < 0);
-
-    if (six->cell_width == term->cell_width &&
-        six->cell_height == term->cell_height)
-    {
-        six->pix = six->original.pix;
-        six->width = six->original.width;
-        six->height = six->original.height;
-    } else {
-        const double width_ratio = (double)term->cell_width / six->cell_width;
-        const double height_ratio = (double)term->cell_height / six->cell_height;
-
-        struct pixman_f_transform scale;
-        pixman_f_transform_init_scale(
-            &scale, 1. / width_ratio, 1. / height_ratio);
-
-        struct pixman_transform _scale;
-        pixman_transform_from_pixman_f_transform(&_scale, &scale);
-        pixman_image_set_transform(six->original.pix, &_scale);
-        pixman_image_set_filter(six->original.pix, PIXMAN_FILTER_BILINEAR, NULL, 0);
-
-        int scaled_width = (double)six->original.width * width_ratio;
-        int scaled_height = (double)six->original.height * height_ratio;
-        int scaled_stride = scaled_width * sizeof(uint32_t);
-
-        LOG_DBG("scaling sixel: %dx%d -> %dx%d",
-                six->original.width, six->original.height,
-                scaled_width, scaled_height);
-
-        uint8_t *scaled_data = xmalloc(scaled_height * scaled_stride);
-        pixman_image_t *scaled_pix = pixman_image_create_bits_no_clear(
-            PIXMAN_a8r8g8b8, scaled_width, scaled_height,
-            (uint32_t *)scaled_data, scaled_stride);
-
-        pixman_image_composite32(
-            PIXMAN_OP_SRC, six->original.pix, NULL, scaled_pix, 0, 0, 0, 0,
-            0, 0, scaled_width, scaled_height);
-
-        pixman_image_set_transform(six->original.pix, NULL);
-
-        six->scaled.data = scaled_data;
-        six->scaled.pix = six->pix = scaled_pix;
-        six->scaled.width = six->width = scaled_width;
-        six->scaled.height = six->height = scaled_height;
-    }
+    if (sixel_scale_begin(term, six))
+        sixel_scale_rows(term, six, 0, six->scaled.height);
 }
 
 void
@@ -1097,6 +1210,9 @@ sixel_reflow_grid(struct terminal *term, struct grid *grid)
     }
 
     tll_free(copy);
+
+    /* Drop the rows of images we failed to re-insert */
+    grid_sixel_rows_rebuild(grid);
     term->grid = active_grid;
 }
 
@@ -1112,6 +1228,8 @@ sixel_reflow(struct terminal *term)
 void
 sixel_unhook(struct terminal *term)
 {
+    band_flush(term);
+
     if (term->sixel.pos.row < term->sixel.image.height &&
         term->sixel.pos.row + 6 * term->sixel.pan >= term->sixel.image.height)
     {
@@ -1347,7 +1465,7 @@ sixel_unhook(struct terminal *term)
 
         /* Dirty touched cells, and scroll terminal content if necessary */
         for (size_t i = 0; i < image.rows; i++) {
-            struct row *row = term->grid->rows[cur_row + i];
+            struct row *row = grid_row_unpacked(term->grid->rows[cur_row + i]);
             row->dirty = true;
 
             for (int col = image.pos.col;
@@ -1387,6 +1505,7 @@ sixel_unhook(struct terminal *term)
     term->sixel.image.p = NULL;
     term->sixel.image.width = 0;
     term->sixel.image.height = 0;
+    term->sixel.image.done_height = 0;
     term->sixel.pos = (struct coord){0, 0};
 
     free(term->sixel.private_palette);
@@ -1395,20 +1514,9 @@ sixel_unhook(struct terminal *term)
     LOG_DBG("you now have %zu sixels in current grid",
             tll_length(term->grid->sixel_images));
 
-
-    term->bits_affecting_ascii_printer.sixels =
-        tll_length(term->grid->sixel_images) > 0;
-    term_update_ascii_printer(term);
     render_refresh(term);
 }
 
-static void ALWAYS_INLINE inline
-memset_u32(uint32_t *data, uint32_t value, size_t count)
-{
-    static_assert(sizeof(wchar_t) == 4, "wchar_t is not 4 bytes");
-    wmemset((wchar_t *)data, (wchar_t)value, count);
-}
-
 static void
 resize_horizontally(struct terminal *term, int new_width_mutable)
 {
@@ -1633,6 +1741,290 @@ resize(struct terminal *term, int new_width_mutable, int new_height_mutable)
     return true;
 }
 
+/*
+ * Transposes 'cols' columns from the band buffer, into six pixel
+ * rows. 'stride' is in pixels.
+ */
+static void
+band_expand(uint32_t *dst, int stride, const uint32_t *src, int cols)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    for (; x + 4 <= cols; x += 4) {
+        const __m128i *s = (const __m128i *)&src[x * SIXEL_BAND_STRIDE];
+
+        /* Rows 0-3, of four columns; a 4x4 transpose */
+        const __m128i c0 = _mm_loadu_si128(&s[0]);
+        const __m128i c1 = _mm_loadu_si128(&s[2]);
+        const __m128i c2 = _mm_loadu_si128(&s[4]);
+        const __m128i c3 = _mm_loadu_si128(&s[6]);
+
+        const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+        const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+        const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+        const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+        _mm_storeu_si128((__m128i *)&dst[0 * stride + x], _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)&dst[1 * stride + x], _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)&dst[2 * stride + x], _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *)&dst[3 * stride + x], _mm_unpackhi_epi64(t2, t3));
+
+        /* Rows 4-5; the upper half is padding */
+        const __m128i u0 = _mm_unpacklo_epi32(
+            _mm_loadu_si128(&s[1]), _mm_loadu_si128(&s[3]));
+        const __m128i u1 = _mm_unpacklo_epi32(
+            _mm_loadu_si128(&s[5]), _mm_loadu_si128(&s[7]));
+
+        _mm_storeu_si128((__m128i *)&dst[4 * stride + x], _mm_unpacklo_epi64(u0, u1));
+        _mm_storeu_si128((__m128i *)&dst[5 * stride + x], _mm_unpackhi_epi64(u0, u1));
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    for (; x + 4 <= cols; x += 4) {
+        const uint32_t *s = &src[x * SIXEL_BAND_STRIDE];
+
+        /* Rows 0-3, of four columns; a 4x4 transpose */
+        const uint32x4_t c0 = vld1q_u32(&s[0]);
+        const uint32x4_t c1 = vld1q_u32(&s[8]);
+        const uint32x4_t c2 = vld1q_u32(&s[16]);
+        const uint32x4_t c3 = vld1q_u32(&s[24]);
+
+        const uint64x2_t t0 = vreinterpretq_u64_u32(vtrn1q_u32(c0, c1));
+        const uint64x2_t t1 = vreinterpretq_u64_u32(vtrn2q_u32(c0, c1));
+        const uint64x2_t t2 = vreinterpretq_u64_u32(vtrn1q_u32(c2, c3));
+        const uint64x2_t t3 = vreinterpretq_u64_u32(vtrn2q_u32(c2, c3));
+
+        vst1q_u32(&dst[0 * stride + x], vreinterpretq_u32_u64(vtrn1q_u64(t0, t2)));
+        vst1q_u32(&dst[1 * stride + x], vreinterpretq_u32_u64(vtrn1q_u64(t1, t3)));
+        vst1q_u32(&dst[2 * stride + x], vreinterpretq_u32_u64(vtrn2q_u64(t0, t2)));
+        vst1q_u32(&dst[3 * stride + x], vreinterpretq_u32_u64(vtrn2q_u64(t1, t3)));
+
+        /* Rows 4-5; the upper half is padding */
+        const uint32x4_t h0 = vld1q_u32(&s[4]);
+        const uint32x4_t h1 = vld1q_u32(&s[12]);
+        const uint32x4_t h2 = vld1q_u32(&s[20]);
+        const uint32x4_t h3 = vld1q_u32(&s[28]);
+
+        const uint64x2_t u0 = vreinterpretq_u64_u32(vtrn1q_u32(h0, h1));
+        const uint64x2_t u1 = vreinterpretq_u64_u32(vtrn2q_u32(h0, h1));
+        const uint64x2_t u2 = vreinterpretq_u64_u32(vtrn1q_u32(h2, h3));
+        const uint64x2_t u3 = vreinterpretq_u64_u32(vtrn2q_u32(h2, h3));
+
+        vst1q_u32(&dst[4 * stride + x], vreinterpretq_u32_u64(vtrn1q_u64(u0, u2)));
+        vst1q_u32(&dst[5 * stride + x], vreinterpretq_u32_u64(vtrn1q_u64(u1, u3)));
+    }
+#endif
+
+    for (; x < cols; x++) {
+        for (int r = 0; r < 6; r++)
+            dst[r * stride + x] = src[x * SIXEL_BAND_STRIDE + r];
+    }
+}
+
+/*
+ * Writes the current band to the image, and resets the band
+ * buffer. The image is only resized here, once per band, rather than
+ * for every sixel that extends it.
+ */
+static void
+band_flush(struct terminal *term)
+{
+    if (term->sixel.pan != 1 || term->sixel.pad != 1)
+        return;
+
+    const int cols = min(max(term->sixel.band.cols, term->sixel.pos.col),
+                         term->sixel.band.width);
+
+    term->sixel.band.cols = 0;
+
+    if (cols <= 0)
+        return;
+
+    if (cols > term->sixel.image.width)
+        resize_horizontally(term, cols);
+
+    const int width = term->sixel.image.width;
+    const int row = term->sixel.pos.row;
+
+    if (likely(row + 6 <= term->sixel.image.alloc_height)) {
+        band_expand(&term->sixel.image.data[row * width], width,
+                    term->sixel.band.data, min(cols, width));
+    }
+
+    memset_u32(term->sixel.band.data, term->sixel.default_bg,
+               cols * SIXEL_BAND_STRIDE);
+}
+
+/* Grows the band buffer, to at least 'cols' columns (if allowed) */
+static void
+band_reserve(struct terminal *term, int cols)
+{
+    if (unlikely(cols > (int)term->sixel.max_width)) {
+        LOG_WARN("maximum image dimensions exceeded, truncating");
+        cols = term->sixel.max_width;
+    }
+
+    const int old_width = term->sixel.band.width;
+    if (cols <= old_width)
+        return;
+
+    const int new_width = min(max(cols, old_width * 2),
+                              (int)term->sixel.max_width);
+
+    term->sixel.band.data = xrealloc(
+        term->sixel.band.data,
+        new_width * SIXEL_BAND_STRIDE * sizeof(term->sixel.band.data[0]));
+    term->sixel.band.width = new_width;
+
+    memset_u32(&term->sixel.band.data[old_width * SIXEL_BAND_STRIDE],
+               term->sixel.default_bg,
+               (new_width - old_width) * SIXEL_BAND_STRIDE);
+}
+
+/*
+ * Scrolls the terminal content, like sixel_unhook() will once the
+ * image has been inserted, to make room for 'height' pixel rows below
+ * the cursor. The cursor is moved up along with the content, and the
+ * image is thus still inserted at the same position.
+ *
+ * Images taller than the scroll region can't be made room for; the
+ * preview shows their tail instead (see sixel_preview()).
+ */
+static void
+preview_reserve_rows(struct terminal *term, int height)
+{
+    const int start_row = term->grid->cursor.point.row;
+
+    if (start_row < term->scroll_region.start ||
+        start_row >= term->scroll_region.end)
+    {
+        /* Outside the scroll region; sixel_unhook() won't scroll either */
+        return;
+    }
+
+    const int rows = (height + term->cell_height - 1) / term->cell_height;
+    const int count = min(start_row + rows - term->scroll_region.end,
+                          start_row - term->scroll_region.start);
+
+    if (count <= 0)
+        return;
+
+    term_scroll(term, count);
+    term_cursor_to(term, start_row - count, term->grid->cursor.point.col);
+}
+
+/*
+ * Returns the row, and the number of rows, the preview of an image
+ * 'height' pixels tall occupies, and the number of pixel rows at the
+ * top of the image that don't fit on the screen.
+ */
+static void
+preview_geometry(const struct terminal *term, int height,
+                 int *start_row, int *rows, int *skip)
+{
+    const bool do_scroll = term->sixel.scrolling;
+    const int row = do_scroll ? term->grid->cursor.point.row : 0;
+    const int rows_avail = term->rows - row;
+    const int rows_done = (height + term->cell_height - 1) / term->cell_height;
+
+    *start_row = row;
+    *rows = min(rows_done, rows_avail);
+
+    /* Once inserted, the content (including the image) is scrolled,
+     * and the bottom of the image is visible */
+    *skip = do_scroll && rows_done > rows_avail
+        ? (rows_done - rows_avail) * term->cell_height
+        : 0;
+}
+
+/*
+ * Dirties the cells beneath pixel rows completed since the last call,
+ * so that large images are displayed while they are being received
+ * (see sixel_preview()). Nothing is inserted into the grid until
+ * sixel_unhook().
+ */
+static void
+progress(struct terminal *term)
+{
+    const int width = term->sixel.image.width;
+    const int prev_height = term->sixel.image.done_height;
+    const int height = min(term->sixel.pos.row, term->sixel.image.alloc_height);
+
+    if (width == 0 || height <= prev_height)
+        return;
+
+    term->sixel.image.done_height = height;
+
+    if (term->sixel.scrolling)
+        preview_reserve_rows(term, height);
+
+    int start_row, rows, skip;
+    preview_geometry(term, height, &start_row, &rows, &skip);
+
+    const bool do_scroll = term->sixel.scrolling;
+    const int start_col = do_scroll ? term->grid->cursor.point.col : 0;
+    const int end_col = min(
+        start_col + (width + term->cell_width - 1) / term->cell_width,
+        term->cols);
+
+    /*
+     * The first row may have been partially completed last time. When
+     * showing the image's tail, everything has moved.
+     */
+    const int first_row = skip > 0
+        ? start_row
+        : start_row + prev_height / term->cell_height;
+    const int last_row = start_row + rows - 1;
+
+    for (int r = first_row; r <= last_row; r++) {
+        struct row *row = grid_row(term->grid, r);
+        row->dirty = true;
+
+        for (int col = start_col; col < end_col; col++)
+            row->cells[col].attrs.clean = 0;
+    }
+
+    if (first_row <= last_row)
+        render_refresh(term);
+}
+
+bool
+sixel_preview(const struct terminal *term, struct sixel *sixel)
+{
+    const int width = term->sixel.image.width;
+    const int done_height = term->sixel.image.done_height;
+
+    if (term->sixel.image.data == NULL || width == 0 || done_height == 0)
+        return false;
+
+    int start_row, rows, skip;
+    preview_geometry(term, done_height, &start_row, &rows, &skip);
+
+    const int height = min(done_height - skip, rows * term->cell_height);
+    if (height <= 0)
+        return false;
+
+    const int start_col = term->sixel.scrolling ? term->grid->cursor.point.col : 0;
+
+    *sixel = (struct sixel){
+        .pix = pixman_image_create_bits_no_clear(
+            PIXMAN_a8r8g8b8, width, height,
+            &term->sixel.image.data[skip * width],
+            width * sizeof(uint32_t)),
+        .width = width,
+        .height = height,
+        .rows = (height + term->cell_height - 1) / term->cell_height,
+        .cols = (width + term->cell_width - 1) / term->cell_width,
+        .pos = (struct coord){
+            start_col, grid_row_absolute(term->grid, start_row)},
+        .opaque = !term->sixel.transparent_bg,
+        .cell_width = term->cell_width,
+        .cell_height = term->cell_height,
+    };
+
+    return sixel->pix != NULL;
+}
+
 static void
 sixel_add_generic(struct terminal *term, uint32_t *data, int stride, uint32_t color,
                   uint8_t sixel)
@@ -1651,28 +2043,24 @@ sixel_add_generic(struct terminal *term, uint32_t *data, int stride, uint32_t co
 }
 
 static void ALWAYS_INLINE inline
-sixel_add_ar_11(struct terminal *term, uint32_t *data, int stride, uint32_t color,
+sixel_add_ar_11(struct terminal *term, uint32_t *data, uint32_t color,
                 uint8_t sixel)
 {
     xassert(term->sixel.pan == 1);
 
+    /* 'data' is a band buffer column; all six pixels are adjacent */
     if (sixel & 0x01)
-        *data = color;
-    data += stride;
+        data[0] = color;
     if (sixel & 0x02)
-        *data = color;
-    data += stride;
+        data[1] = color;
     if (sixel & 0x04)
-        *data = color;
-    data += stride;
+        data[2] = color;
     if (sixel & 0x08)
-        *data = color;
-    data += stride;
+        data[3] = color;
     if (sixel & 0x10)
-        *data = color;
-    data += stride;
+        data[4] = color;
     if (sixel & 0x20)
-        *data = color;
+        data[5] = color;
 }
 
 static void
@@ -1712,24 +2100,20 @@ sixel_add_one_ar_11(struct terminal *term, uint8_t c)
     xassert(term->sixel.pad == 1);
 
     int col = term->sixel.pos.col;
-    int width = term->sixel.image.width;
 
-    if (unlikely(col >= width)) {
-        resize_horizontally(term, col + count);
-        width = term->sixel.image.width;
-        count = min(count, max(width - col, 0));
+    if (unlikely(col >= term->sixel.band.width)) {
+        band_reserve(term, col + 1);
 
-        if (unlikely(count == 0))
+        if (unlikely(col >= term->sixel.band.width))
             return;
     }
 
-    uint32_t *data = term->sixel.image.p;
-
-    term->sixel.pos.col += 1;
-    term->sixel.image.p += 1;
+    term->sixel.pos.col = col + 1;
     term->sixel.image.bottom_pixel |= c;
 
-    sixel_add_ar_11(term, data, width, term->sixel.color, c);
+    sixel_add_ar_11(
+        term, &term->sixel.band.data[col * SIXEL_BAND_STRIDE],
+        term->sixel.color, c);
 }
 
 static void
@@ -1739,11 +2123,11 @@ sixel_add_many_ar_11(struct terminal *term, uint8_t c, unsigned count)
     xassert(term->sixel.pad == 1);
 
     int col = term->sixel.pos.col;
-    int width = term->sixel.image.width;
+    int width = term->sixel.band.width;
 
     if (unlikely(col + count - 1 >= width)) {
-        resize_horizontally(term, col + count);
-        width = term->sixel.image.width;
+        band_reserve(term, col + count);
+        width = term->sixel.band.width;
         count = min(count, max(width - col, 0));
 
         if (unlikely(count == 0))
@@ -1751,15 +2135,14 @@ sixel_add_many_ar_11(struct terminal *term, uint8_t c, unsigned count)
     }
 
     uint32_t color = term->sixel.color;
-    uint32_t *data = term->sixel.image.p;
-    uint32_t *end = data + count;
+    uint32_t *data = &term->sixel.band.data[col * SIXEL_BAND_STRIDE];
+    uint32_t *end = data + count * SIXEL_BAND_STRIDE;
 
     term->sixel.pos.col += count;
-    term->sixel.image.p = end;
     term->sixel.image.bottom_pixel |= c;
 
-    for (; data < end; data++)
-        sixel_add_ar_11(term, data, width, color, c);
+    for (; data < end; data += SIXEL_BAND_STRIDE)
+        sixel_add_ar_11(term, data, color, c);
 
 }
 
@@ -1797,12 +2180,15 @@ decsixel_generic(struct terminal *term, uint8_t c)
              * having to check the row vs image height in the common
              * path in sixel_add().
              */
+            term->sixel.band.cols = max(term->sixel.band.cols, term->sixel.pos.col);
             term->sixel.pos.col = 0;
             term->sixel.image.p = &term->sixel.image.data[term->sixel.pos.row * term->sixel.image.width];
         }
         break;
 
     case '-':  /* GNL - Graphical New Line */
+        band_flush(term);
+
         term->sixel.pos.row += 6 * term->sixel.pan;
         term->sixel.pos.col = 0;
         term->sixel.image.bottom_pixel = 0;
@@ -1812,6 +2198,8 @@ decsixel_generic(struct terminal *term, uint8_t c)
             if (!resize_vertically(term, term->sixel.pos.row + 6 * term->sixel.pan))
                 term->sixel.pos.col = term->sixel.max_width + 1 * term->sixel.pad;
         }
+
+        progress(term);
         break;
 
     case '?' ... '~':
@@ -1869,8 +2257,14 @@ decgra(struct terminal *term, uint8_t c)
         pan = pan > 0 ? pan : 1;
         pad = pad > 0 ? pad : 1;
 
+        /*
+         * Sixels in the current band are only written to the image
+         * when the band is flushed; they count as printed too
+         */
         if (likely(term->sixel.image.width == 0 &&
-                   term->sixel.image.height == 0))
+                   term->sixel.image.height == 0 &&
+                   term->sixel.band.cols == 0 &&
+                   term->sixel.pos.col == 0))
         {
             term->sixel.pan = pan;
             term->sixel.pad = pad;
@@ -2205,3 +2599,27 @@ sixel_geometry_report_max(struct terminal *term)
     LOG_DBG("query response for max sixel geometry: %ux%u",
             max_width, max_height);
 }
+
+UNITTEST
+{
+    /* SIMD transpose vs. the column major source, including a tail */
+    enum { cols = 11, stride = 13 };
+
+    uint32_t src[cols * SIXEL_BAND_STRIDE];
+    for (size_t i = 0; i < ALEN(src); i++)
+        src[i] = i % SIXEL_BAND_STRIDE < 6 ? i : 0xdeadbeef;
+
+    uint32_t dst[6 * stride];
+    memset_u32(dst, 0xffffffff, ALEN(dst));
+
+    band_expand(dst, stride, src, cols);
+
+    for (int r = 0; r < 6; r++) {
+        for (int x = 0; x < stride; x++) {
+            const uint32_t expected = x < cols
+                ? (uint32_t)(x * SIXEL_BAND_STRIDE + r)
+                : 0xffffffff;
+            xassert(dst[r * stride + x] == expected);
+        }
+    }
+}
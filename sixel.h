@@ -22,6 +22,26 @@ void sixel_scroll_down(struct terminal *term, int rows);
 void sixel_cell_size_changed(struct terminal *term);
 void sixel_sync_cache(const struct terminal *term, struct sixel *sixel);
 
+/*
+ * sixel_sync_cache(), split in two, to allow the scaling to be done
+ * in parallel: sixel_scale_begin() syncs the cache, but if the image
+ * needs to be scaled, only allocates the scaled image, and returns
+ * true. Its rows must then be rendered with sixel_scale_rows(), which
+ * may be called concurrently for disjoint row ranges.
+ */
+bool sixel_scale_begin(const struct terminal *term, struct sixel *sixel);
+void sixel_scale_rows(const struct terminal *term, const struct sixel *sixel,
+                      int start, int end);
+
+/*
+ * Fills in 'sixel' with the completed part of the image currently
+ * being decoded, if any, positioned where sixel_unhook() will put
+ * it. The caller must unref sixel->pix, and must not keep the image
+ * beyond the current frame; the pixel data is still owned by the
+ * decoder.
+ */
+bool sixel_preview(const struct terminal *term, struct sixel *sixel);
+
 void sixel_reflow_grid(struct terminal *term, struct grid *grid);
 
 /* Shortcut for sixel_reflow_grid(normal) + sixel_reflow_grid(alt) */
@@ -9,8 +9,11 @@
 #include <signal.h>
 #include <termios.h>
 
+#include <pthread.h>
+
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 
 #define LOG_MODULE "slave"
@@ -19,6 +22,7 @@
 
 #include "debug.h"
 #include "macros.h"
+#include "spawn.h"
 #include "tokenize.h"
 #include "util.h"
 #include "xmalloc.h"
@@ -30,63 +34,6 @@ struct environ {
     char **envp;
 };
 
-#if !defined(EXECVPE)
-static char *
-find_file_in_path(const char *file)
-{
-    if (strchr(file, '/') != NULL)
-        return xstrdup(file);
-
-    const char *env_path = getenv("PATH");
-    char *path_list = NULL;
-
-    if (env_path != NULL && env_path[0] != '\0')
-        path_list = xstrdup(env_path);
-    else {
-        size_t sc_path_len = confstr(_CS_PATH, NULL, 0);
-        if (sc_path_len > 0) {
-            path_list = xmalloc(sc_path_len);
-            confstr(_CS_PATH, path_list, sc_path_len);
-        } else
-            return xstrdup(file);
-    }
-
-    for (const char *path = strtok(path_list, ":");
-         path != NULL;
-         path = strtok(NULL, ":"))
-    {
-        char *full = xstrjoin3(path, "/", file);
-        if (access(full, F_OK) == 0) {
-            free(path_list);
-            return full;
-        }
-
-        free(full);
-    }
-
-    free(path_list);
-    return xstrdup(file);
-}
-
-static int
-foot_execvpe(const char *file, char *const argv[], char *const envp[])
-{
-    char *path = find_file_in_path(file);
-    int ret = execve(path, argv, envp);
-
-    /*
-     * Getting here is an error
-     */
-    free(path);
-    return ret;
-}
-
-#else   /* EXECVPE */
-
-#define foot_execvpe(file, argv, envp) execvpe(file, argv, envp)
-
-#endif  /* EXECVPE */
-
 static bool
 is_valid_shell(const char *shell)
 {
@@ -163,11 +110,9 @@ emit_one_notification(int fd, const struct user_notification *notif)
         write(fd, postfix, strlen(postfix)) < 0)
     {
         /*
-         * The main process is blocking and waiting for us to close
-         * the error pipe. Thus, pts data will *not* be processed
-         * until we've exec:d. This means we cannot write anymore once
-         * the kernel buffer is full. Don't treat this as a fatal
-         * error.
+         * We haven't started reading from the ptmx yet. This means
+         * we cannot write anymore once the kernel buffer is full.
+         * Don't treat this as a fatal error.
          */
         if (errno == EWOULDBLOCK || errno == EAGAIN)
             return UN_NO_MORE;
@@ -210,104 +155,44 @@ emit_notifications(int fd, const user_notifications_t *notifications)
         emit_notifications_of_kind(fd, notifications, USER_NOTIFICATION_DEPRECATED);
 }
 
+/* Written to the error pipe by the child, if it fails to start */
+struct slave_error {
+    int errno_copy;
+    bool chdir_failed;
+};
+
+/* Runs in the vfork():ed child; see slave_spawn() */
 static noreturn void
-slave_exec(int ptmx, char *argv[], char *const envp[], int err_fd,
-           bool login_shell, const user_notifications_t *notifications)
+slave_exec(int pts, const struct spawn_exec *exec, const char *cwd, int err_fd)
 {
-    int pts = -1;
-    const char *pts_name = ptsname(ptmx);
-
-    if (grantpt(ptmx) == -1) {
-        LOG_ERRNO("failed to grantpt()");
-        goto err;
-    }
-    if (unlockpt(ptmx) == -1) {
-        LOG_ERRNO("failed to unlockpt()");
-        goto err;
-    }
-
-    close(ptmx);
-    ptmx = -1;
+    bool chdir_failed = false;
 
-    if (setsid() == -1) {
-        LOG_ERRNO("failed to setsid()");
+    if (chdir(cwd) < 0) {
+        chdir_failed = true;
         goto err;
     }
 
-    pts = open(pts_name, O_RDWR);
-    if (pts == -1) {
-        LOG_ERRNO("failed to open pseudo terminal slave device");
-        goto err;
-    }
-
-    if (ioctl(pts, TIOCSCTTY, 0) < 0) {
-        LOG_ERRNO("failed to configure controlling terminal");
-        goto err;
-    }
-
-#ifdef IUTF8
-    {
-        struct termios flags;
-        if (tcgetattr(pts, &flags) < 0) {
-            LOG_ERRNO("failed to get terminal attributes");
-            goto err;
-        }
-
-        flags.c_iflag |= IUTF8;
-        if (tcsetattr(pts, TCSANOW, &flags) < 0) {
-            LOG_ERRNO("failed to set IUTF8 terminal attribute");
-            goto err;
-        }
-    }
-#endif
-
-    if (tll_length(*notifications) > 0) {
-        int flags = fcntl(pts, F_GETFL);
-        if (flags < 0)
-            goto err;
-        if (fcntl(pts, F_SETFL, flags | O_NONBLOCK) < 0)
-            goto err;
-
-        if (!emit_notifications(pts, notifications))
-            goto err;
-
-        fcntl(pts, F_SETFL, flags);
-    }
-
-    if (dup2(pts, STDIN_FILENO) == -1 ||
-        dup2(pts, STDOUT_FILENO) == -1 ||
-        dup2(pts, STDERR_FILENO) == -1)
+    if (!spawn_child_restore_signals() ||
+        setsid() < 0 ||
+        ioctl(pts, TIOCSCTTY, 0) < 0 ||
+        dup2(pts, STDIN_FILENO) < 0 ||
+        dup2(pts, STDOUT_FILENO) < 0 ||
+        dup2(pts, STDERR_FILENO) < 0)
     {
-        LOG_ERRNO("failed to dup stdin/stdout/stderr");
         goto err;
     }
 
-    close(pts);
-    pts = -1;
-
-    const char *file;
-    if (login_shell) {
-        file = xstrdup(argv[0]);
-
-        char *arg0 = xmalloc(strlen(argv[0]) + 1 + 1);
-        arg0[0] = '-';
-        arg0[1] = '\0';
-        strcat(arg0, argv[0]);
-
-        argv[0] = arg0;
-    } else
-        file = argv[0];
-
-    foot_execvpe(file, argv, envp);
+    /* 'pts' and 'err_fd' are closed by exec (O_CLOEXEC) */
+    spawn_exec(exec);
 
 err:
-    (void)!write(err_fd, &errno, sizeof(errno));
-    if (pts != -1)
-        close(pts);
-    if (ptmx != -1)
-        close(ptmx);
-    close(err_fd);
-    _exit(errno);
+    ;
+    const struct slave_error error = {
+        .errno_copy = errno,
+        .chdir_failed = chdir_failed,
+    };
+    (void)!write(err_fd, &error, sizeof(error));
+    _exit(error.errno_copy);
 }
 
 static bool
@@ -325,203 +210,293 @@ env_matches_var_name(const char *e, const char *name)
     return true;
 }
 
+static const char *
+get_from_env(const struct environ *env, const char *name)
+{
+    for (size_t i = 0; i < env->count; i++) {
+        if (env_matches_var_name(env->envp[i], name))
+            return env->envp[i] + strlen(name) + 1;
+    }
+
+    return NULL;
+}
+
 static void
 add_to_env(struct environ *env, const char *name, const char *value)
 {
-    if (env->envp == NULL)
-        setenv(name, value, 1);
-    else {
-        char *e = xstrjoin3(name, "=", value);
-
-        /* Search for existing variable. If found, replace it with the
-           new value */
-        for (size_t i = 0; i < env->count; i++) {
-            if (env_matches_var_name(env->envp[i], name)) {
-                free(env->envp[i]);
-                env->envp[i] = e;
-                return;
-            }
+    char *e = xstrjoin3(name, "=", value);
+
+    /* Search for existing variable. If found, replace it with the
+       new value */
+    for (size_t i = 0; i < env->count; i++) {
+        if (env_matches_var_name(env->envp[i], name)) {
+            free(env->envp[i]);
+            env->envp[i] = e;
+            return;
         }
-
-        /* If the variable does not already exist, add it */
-        env->envp = xrealloc(env->envp, (env->count + 2) * sizeof(env->envp[0]));
-        env->envp[env->count++] = e;
-        env->envp[env->count] = NULL;
     }
+
+    /* If the variable does not already exist, add it */
+    env->envp = xrealloc(env->envp, (env->count + 2) * sizeof(env->envp[0]));
+    env->envp[env->count++] = e;
+    env->envp[env->count] = NULL;
 }
 
 static void
 del_from_env(struct environ *env, const char *name)
 {
-    if (env->envp == NULL)
-        unsetenv(name);
-    else {
-        for (size_t i = 0; i < env->count; i++) {
-            if (env_matches_var_name(env->envp[i], name)) {
-                free(env->envp[i]);
-                memmove(&env->envp[i],
-                        &env->envp[i + 1],
-                        (env->count - i) * sizeof(env->envp[0]));
-                env->count--;
-                xassert(env->envp[env->count] == NULL);
-                break;
-            }
+    for (size_t i = 0; i < env->count; i++) {
+        if (env_matches_var_name(env->envp[i], name)) {
+            free(env->envp[i]);
+            memmove(&env->envp[i],
+                    &env->envp[i + 1],
+                    (env->count - i) * sizeof(env->envp[0]));
+            env->count--;
+            xassert(env->envp[env->count] == NULL);
+            break;
         }
     }
 }
 
-pid_t
-slave_spawn(int ptmx, int argc, const char *cwd, char *const *argv,
-            const char *const *envp, const env_var_list_t *extra_env_vars,
-            const char *term_env, const char *conf_shell, bool login_shell,
-            const user_notifications_t *notifications)
+/* Prepares the pts for the client, before it has been started */
+static bool
+configure_pts(int ptmx, int *pts, const user_notifications_t *notifications)
 {
-    int fork_pipe[2];
-    if (pipe2(fork_pipe, O_CLOEXEC) < 0) {
-        LOG_ERRNO("failed to create pipe");
-        return -1;
+    if (grantpt(ptmx) == -1) {
+        LOG_ERRNO("failed to grantpt()");
+        return false;
+    }
+    if (unlockpt(ptmx) == -1) {
+        LOG_ERRNO("failed to unlockpt()");
+        return false;
     }
 
-    pid_t pid = fork();
-    switch (pid) {
-    case -1:
-        LOG_ERRNO("failed to fork");
-        close(fork_pipe[0]);
-        close(fork_pipe[1]);
-        return -1;
+    /* Made the controlling terminal by the client, after setsid() */
+    *pts = open(ptsname(ptmx), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (*pts == -1) {
+        LOG_ERRNO("failed to open pseudo terminal slave device");
+        return false;
+    }
 
-    case 0:
-        /* Child */
-        close(fork_pipe[0]);  /* Close read end */
+#ifdef IUTF8
+    {
+        struct termios flags;
+        if (tcgetattr(*pts, &flags) < 0) {
+            LOG_ERRNO("failed to get terminal attributes");
+            return false;
+        }
 
-        if (chdir(cwd) < 0) {
-            const int errno_copy = errno;
-            LOG_ERRNO("failed to change working directory to %s", cwd);
-            (void)!write(fork_pipe[1], &errno_copy, sizeof(errno_copy));
-            _exit(errno_copy);
+        flags.c_iflag |= IUTF8;
+        if (tcsetattr(*pts, TCSANOW, &flags) < 0) {
+            LOG_ERRNO("failed to set IUTF8 terminal attribute");
+            return false;
         }
+    }
+#endif
 
-        /* Restore signal mask, and SIG_IGN'd signals */
-        struct sigaction dfl = {.sa_handler = SIG_DFL};
-        sigemptyset(&dfl.sa_mask);
-        sigset_t mask;
-        sigemptyset(&mask);
+    if (tll_length(*notifications) > 0) {
+        int flags = fcntl(*pts, F_GETFL);
+        if (flags < 0)
+            return false;
+        if (fcntl(*pts, F_SETFL, flags | O_NONBLOCK) < 0)
+            return false;
 
-        if (sigprocmask(SIG_SETMASK, &mask, NULL) < 0 ||
-            sigaction(SIGHUP, &dfl, NULL) < 0 ||
-            sigaction(SIGPIPE, &dfl, NULL) < 0)
-        {
-            const int errno_copy = errno;
-            LOG_ERRNO_P(errno, "failed to restore signals");
-            (void)!write(fork_pipe[1], &errno_copy, sizeof(errno_copy));
-            _exit(errno_copy);
-        }
+        if (!emit_notifications(*pts, notifications))
+            return false;
 
-        /* Create a mutable copy of the environment */
-        struct environ custom_env = {0};
-        if (envp != NULL) {
-            for (const char *const *e = envp; *e != NULL; e++)
-                custom_env.count++;
+        fcntl(*pts, F_SETFL, flags);
+    }
 
-            custom_env.envp = xcalloc(
-                custom_env.count + 1, sizeof(custom_env.envp[0]));
+    int fd_flags;
+    if ((fd_flags = fcntl(ptmx, F_GETFD)) < 0 ||
+        fcntl(ptmx, F_SETFD, fd_flags | FD_CLOEXEC) < 0)
+    {
+        LOG_ERRNO("failed to set FD_CLOEXEC on ptmx");
+        return false;
+    }
 
-            size_t i = 0;
-            for (const char *const *e = envp; *e != NULL; e++, i++)
-                custom_env.envp[i] = xstrdup(*e);
-            xassert(custom_env.envp[custom_env.count] == NULL);
-        }
+    return true;
+}
+
+pid_t
+slave_spawn(int ptmx, int argc, const char *cwd, char *const *argv,
+            const char *const *envp, const env_var_list_t *extra_env_vars,
+            const char *term_env, const char *conf_shell, bool login_shell,
+            const user_notifications_t *notifications)
+{
+    /*
+     * The client is started with vfork(), rather than fork(), since
+     * copying our page tables can take a long time (in server mode,
+     * with many terminals, and large scrollbacks), during which all
+     * windows are blocked.
+     *
+     * The child shares our memory until it exec:s, and may only make
+     * system calls. Thus, everything else (environment, argv, pts
+     * configuration, logging) is done here.
+     */
+    pid_t pid = -1;
+    int pts = -1;
+    int fork_pipe[2] = {-1, -1};
+    char **shell_argv = NULL;
+    char *arg0 = NULL;
+    char *login_arg0 = NULL;
+    struct spawn_exec exec = {0};
+    struct environ custom_env = {0};
+
+    if (!configure_pts(ptmx, &pts, notifications))
+        goto out;
+
+    /* Create a mutable copy of the environment */
+    if (envp == NULL)
+        envp = (const char *const *)environ;
+
+    for (const char *const *e = envp; *e != NULL; e++)
+        custom_env.count++;
+
+    custom_env.envp = xcalloc(custom_env.count + 1, sizeof(custom_env.envp[0]));
 
-        add_to_env(&custom_env, "TERM", term_env);
-        add_to_env(&custom_env, "COLORTERM", "truecolor");
-        add_to_env(&custom_env, "PWD", cwd);
+    size_t i = 0;
+    for (const char *const *e = envp; *e != NULL; e++, i++)
+        custom_env.envp[i] = xstrdup(*e);
+    xassert(custom_env.envp[custom_env.count] == NULL);
 
-        del_from_env(&custom_env, "TERM_PROGRAM");
-        del_from_env(&custom_env, "TERM_PROGRAM_VERSION");
+    add_to_env(&custom_env, "TERM", term_env);
+    add_to_env(&custom_env, "COLORTERM", "truecolor");
+    add_to_env(&custom_env, "PWD", cwd);
+
+    del_from_env(&custom_env, "TERM_PROGRAM");
+    del_from_env(&custom_env, "TERM_PROGRAM_VERSION");
 
 #if defined(FOOT_TERMINFO_PATH)
-        add_to_env(&custom_env, "TERMINFO", FOOT_TERMINFO_PATH);
+    add_to_env(&custom_env, "TERMINFO", FOOT_TERMINFO_PATH);
 #endif
 
-        if (extra_env_vars != NULL) {
-            tll_foreach(*extra_env_vars, it) {
-                const char *name = it->item.name;
-                const char *value = it->item.value;
+    if (extra_env_vars != NULL) {
+        tll_foreach(*extra_env_vars, it) {
+            const char *name = it->item.name;
+            const char *value = it->item.value;
 
-                if (strlen(value) == 0)
-                    del_from_env(&custom_env, name);
-                else
-                    add_to_env(&custom_env, name, value);
-            }
+            if (strlen(value) == 0)
+                del_from_env(&custom_env, name);
+            else
+                add_to_env(&custom_env, name, value);
         }
+    }
 
-        char **_shell_argv = NULL;
-        char **shell_argv = NULL;
-
-        if (argc == 0) {
-            if (!tokenize_cmdline(conf_shell, &_shell_argv)) {
-                (void)!write(fork_pipe[1], &errno, sizeof(errno));
-                _exit(0);
-            }
-            shell_argv = _shell_argv;
-        } else {
-            size_t count = 0;
-            for (; argv[count] != NULL; count++)
-                ;
-            shell_argv = xmalloc((count + 1) * sizeof(shell_argv[0]));
-            for (size_t i = 0; i < count; i++)
-                shell_argv[i] = argv[i];
-            shell_argv[count] = NULL;
+    if (argc == 0) {
+        if (!tokenize_cmdline(conf_shell, &shell_argv)) {
+            LOG_ERR("%s: failed to execute", conf_shell);
+            goto out;
         }
+    } else {
+        size_t count = 0;
+        for (; argv[count] != NULL; count++)
+            ;
+        shell_argv = xmalloc((count + 1) * sizeof(shell_argv[0]));
+        for (size_t j = 0; j < count; j++)
+            shell_argv[j] = xstrdup(argv[j]);
+        shell_argv[count] = NULL;
+    }
+
+    if (is_valid_shell(shell_argv[0]))
+        add_to_env(&custom_env, "SHELL", shell_argv[0]);
+
+    /*
+     * Look up the shell in the client's $PATH, which may have been
+     * changed in [environment]; execvpe() would use our own.
+     */
+    spawn_exec_init(
+        &exec, shell_argv[0], shell_argv, custom_env.envp,
+        get_from_env(&custom_env, "PATH"));
 
-        if (is_valid_shell(shell_argv[0]))
-            add_to_env(&custom_env, "SHELL", shell_argv[0]);
+    if (login_shell) {
+        arg0 = shell_argv[0];
+        login_arg0 = xstrjoin("-", arg0);
+        shell_argv[0] = login_arg0;
+    }
+
+    if (pipe2(fork_pipe, O_CLOEXEC) < 0) {
+        LOG_ERRNO("failed to create pipe");
+        goto out;
+    }
 
-        slave_exec(ptmx, shell_argv,
-                   custom_env.envp != NULL ? custom_env.envp : environ,
-                   fork_pipe[1], login_shell, notifications);
+    /* Don't run our signal handlers in the child */
+    sigset_t all, original;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &original);
+
+    pid = vfork();
+
+    if (pid == 0) {
+        /* Child */
+        slave_exec(pts, &exec, cwd, fork_pipe[1]);
         BUG("Unexpected return from slave_exec()");
-        break;
+    }
 
-    default: {
+    pthread_sigmask(SIG_SETMASK, &original, NULL);
 
-        /*
-         * Don't stay in CWD, since it may be an ephemeral path. For
-         * example, it may be a mount point of, say, a thumb drive. Us
-         * keeping it open will prevent the user from unmounting it.
-         */
-        (void)!!chdir("/");
+    if (pid < 0) {
+        LOG_ERRNO("failed to vfork");
+        goto out;
+    }
 
-        close(fork_pipe[1]); /* Close write end */
-        LOG_DBG("slave has PID %d", pid);
+    /*
+     * Don't stay in CWD, since it may be an ephemeral path. For
+     * example, it may be a mount point of, say, a thumb drive. Us
+     * keeping it open will prevent the user from unmounting it.
+     */
+    (void)!!chdir("/");
 
-        int errno_copy;
-        static_assert(sizeof(errno) == sizeof(errno_copy), "errno size mismatch");
+    close(fork_pipe[1]); /* Close write end */
+    fork_pipe[1] = -1;
+    LOG_DBG("slave has PID %d", pid);
 
-        ssize_t ret = read(fork_pipe[0], &errno_copy, sizeof(errno_copy));
-        close(fork_pipe[0]);
+    struct slave_error error;
+    static_assert(sizeof(errno) == sizeof(error.errno_copy), "errno size mismatch");
 
-        if (ret < 0) {
-            LOG_ERRNO("failed to read from pipe");
-            return -1;
-        } else if (ret == sizeof(errno_copy)) {
+    ssize_t ret = read(fork_pipe[0], &error, sizeof(error));
+
+    if (ret < 0) {
+        LOG_ERRNO("failed to read from pipe");
+        pid = -1;
+    } else if (ret == sizeof(error)) {
+        if (error.chdir_failed) {
             LOG_ERRNO_P(
-                errno_copy, "%s: failed to execute",
+                error.errno_copy, "failed to change working directory to %s",
+                cwd);
+        } else {
+            LOG_ERRNO_P(
+                error.errno_copy, "%s: failed to execute",
                 argc == 0 ? conf_shell : argv[0]);
-            return -1;
-        } else
-            LOG_DBG("%s: successfully started", conf_shell);
-
-        int fd_flags;
-        if ((fd_flags = fcntl(ptmx, F_GETFD)) < 0 ||
-            fcntl(ptmx, F_SETFD, fd_flags | FD_CLOEXEC) < 0)
-        {
-            LOG_ERRNO("failed to set FD_CLOEXEC on ptmx");
-            return -1;
         }
-        break;
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    } else
+        LOG_DBG("%s: successfully started", conf_shell);
+
+out:
+    if (fork_pipe[0] != -1)
+        close(fork_pipe[0]);
+    if (fork_pipe[1] != -1)
+        close(fork_pipe[1]);
+    if (pts != -1)
+        close(pts);
+
+    if (shell_argv != NULL) {
+        if (login_arg0 != NULL)
+            shell_argv[0] = arg0;
+        for (char **a = shell_argv; *a != NULL; a++)
+            free(*a);
+        free(shell_argv);
     }
+
+    if (custom_env.envp != NULL) {
+        for (char **e = custom_env.envp; *e != NULL; e++)
+            free(*e);
+        free(custom_env.envp);
     }
 
+    free(login_arg0);
+    spawn_exec_destroy(&exec);
     return pid;
 }
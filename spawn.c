@@ -1,9 +1,11 @@
 #include "spawn.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -15,59 +17,247 @@
 #include "debug.h"
 #include "xmalloc.h"
 
+extern char **environ;
+
+void
+spawn_exec_init(struct spawn_exec *exec, const char *file,
+                char *const argv[], char *const envp[], const char *path)
+{
+    char *path_list = NULL;
+
+    if (path != NULL && path[0] != '\0')
+        path_list = xstrdup(path);
+    else {
+        size_t sc_path_len = confstr(_CS_PATH, NULL, 0);
+        if (sc_path_len > 0) {
+            path_list = xmalloc(sc_path_len);
+            confstr(_CS_PATH, path_list, sc_path_len);
+        } else
+            path_list = xstrdup("/bin:/usr/bin");
+    }
+
+    size_t argc = 0;
+    for (; argv[argc] != NULL; argc++)
+        ;
+
+    /* No directory is longer than the whole search path */
+    char *buf = xmalloc(strlen(path_list) + 1 + strlen(file) + 1);
+
+    /* For the ENOEXEC fallback: /bin/sh <pathname> argv[1]... */
+    const size_t sh_argc = 2 + (argc > 1 ? argc - 1 : 0);
+    char **sh_argv = xmalloc((sh_argc + 1) * sizeof(sh_argv[0]));
+    sh_argv[0] = (char *)"/bin/sh";
+    sh_argv[1] = buf;
+    for (size_t i = 1; i < argc; i++)
+        sh_argv[i + 1] = argv[i];
+    sh_argv[sh_argc] = NULL;
+
+    *exec = (struct spawn_exec){
+        .file = file,
+        .argv = argv,
+        .envp = envp,
+        .path = path_list,
+        .buf = buf,
+        .sh_argv = sh_argv,
+    };
+}
+
+void
+spawn_exec_destroy(struct spawn_exec *exec)
+{
+    free(exec->path);
+    free(exec->buf);
+    free(exec->sh_argv);
+}
+
+static void
+exec_candidate(const struct spawn_exec *exec, const char *pathname)
+{
+    execve(pathname, exec->argv, exec->envp);
+
+    /* Not an executable format; like execvpe(), try it as a script */
+    if (errno == ENOEXEC) {
+        execve(exec->sh_argv[0], exec->sh_argv, exec->envp);
+        errno = ENOEXEC;
+    }
+}
+
+void
+spawn_exec(const struct spawn_exec *exec)
+{
+    const char *file = exec->file;
+
+    if (file[0] == '\0') {
+        errno = ENOENT;
+        return;
+    }
+
+    if (strchr(file, '/') != NULL) {
+        memcpy(exec->buf, file, strlen(file) + 1);
+        exec_candidate(exec, exec->buf);
+        return;
+    }
+
+    const size_t file_len = strlen(file);
+    bool got_eacces = false;
+
+    for (const char *dir = exec->path; ; ) {
+        const char *end = strchr(dir, ':');
+        const size_t dir_len = end != NULL ? (size_t)(end - dir) : strlen(dir);
+
+        /* An empty component is the current directory */
+        char *p = exec->buf;
+        if (dir_len > 0) {
+            memcpy(p, dir, dir_len);
+            p += dir_len;
+            *p++ = '/';
+        }
+        memcpy(p, file, file_len + 1);
+
+        exec_candidate(exec, exec->buf);
+
+        switch (errno) {
+        case EACCES:
+            /* Keep looking, but report EACCES if nothing else is found */
+            got_eacces = true;
+            break;
+
+        case ENOENT:
+        case ENOTDIR:
+        case ESTALE:
+        case ENODEV:
+        case ETIMEDOUT:
+            break;
+
+        default:
+            return;
+        }
+
+        if (end == NULL)
+            break;
+        dir = end + 1;
+    }
+
+    if (got_eacces)
+        errno = EACCES;
+}
+
+bool
+spawn_child_restore_signals(void)
+{
+    struct sigaction dfl = {.sa_handler = SIG_DFL};
+    sigemptyset(&dfl.sa_mask);
+
+    /*
+     * Reset caught signals; their handlers would run in our parent's
+     * memory. Restore the signals foot ignores (SIGHUP, SIGPIPE), but
+     * leave signals ignored by whoever started foot alone.
+     */
+    for (int i = 1; i <= SIGRTMAX; i++) {
+        struct sigaction old;
+        if (sigaction(i, NULL, &old) < 0)
+            continue;
+
+        if (i != SIGHUP && i != SIGPIPE &&
+            (old.sa_handler == SIG_DFL || old.sa_handler == SIG_IGN))
+        {
+            continue;
+        }
+
+        if (sigaction(i, &dfl, NULL) < 0)
+            return false;
+    }
+
+    /* Clear signal mask */
+    sigset_t mask;
+    sigemptyset(&mask);
+    return sigprocmask(SIG_SETMASK, &mask, NULL) == 0;
+}
+
+static bool
+env_is_var(const char *e, const char *name)
+{
+    const size_t len = strlen(name);
+    return strncmp(e, name, len) == 0 && e[len] == '=';
+}
+
 pid_t
 spawn(struct reaper *reaper, const char *cwd, char *const argv[],
       int stdin_fd, int stdout_fd, int stderr_fd, reaper_cb cb, void *cb_data,
       const char *xdg_activation_token)
 {
+    /*
+     * The child is created with vfork(); it shares our memory until
+     * it exec:s, and can only make system calls. Thus, prepare its
+     * environment here.
+     */
+    const char *startup_id =
+        xdg_activation_token != NULL && getenv("DISPLAY") != NULL
+            ? xdg_activation_token : NULL;
+
+    size_t env_count = 0;
+    for (char **e = environ; *e != NULL; e++)
+        env_count++;
+
+    char **envp = xmalloc((env_count + 4) * sizeof(envp[0]));
+    char *own_vars[3] = {NULL};
+    size_t own_count = 0;
+    size_t idx = 0;
+
+    for (char **e = environ; *e != NULL; e++) {
+        if ((cwd != NULL && env_is_var(*e, "PWD")) ||
+            (xdg_activation_token != NULL &&
+             env_is_var(*e, "XDG_ACTIVATION_TOKEN")) ||
+            (startup_id != NULL && env_is_var(*e, "DESKTOP_STARTUP_ID")))
+        {
+            continue;
+        }
+        envp[idx++] = *e;
+    }
+
+    if (cwd != NULL)
+        own_vars[own_count++] = xstrjoin("PWD=", cwd);
+    if (xdg_activation_token != NULL)
+        own_vars[own_count++] = xstrjoin(
+            "XDG_ACTIVATION_TOKEN=", xdg_activation_token);
+    if (startup_id != NULL)
+        own_vars[own_count++] = xstrjoin("DESKTOP_STARTUP_ID=", startup_id);
+
+    for (size_t i = 0; i < own_count; i++)
+        envp[idx++] = own_vars[i];
+    envp[idx] = NULL;
+
+    struct spawn_exec exec;
+    spawn_exec_init(&exec, argv[0], argv, envp, getenv("PATH"));
+
+    if (cwd != NULL && access(cwd, X_OK) < 0) {
+        LOG_WARN("failed to change working directory to %s: %s",
+                 cwd, strerror(errno));
+        cwd = NULL;
+    }
+
+    pid_t pid = -1;
     int pipe_fds[2] = {-1, -1};
     if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
         LOG_ERRNO("failed to create pipe");
-        goto err;
+        goto out;
     }
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        LOG_ERRNO("failed to fork");
-        goto err;
-    }
+    /* Don't run our signal handlers in the child, see above */
+    sigset_t all, original;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &original);
+
+    pid = vfork();
 
     if (pid == 0) {
         /* Child */
-        close(pipe_fds[0]);
-
-        if (setsid() < 0)
-            goto child_err;
-
-        /* Clear signal mask */
-        sigset_t mask;
-        sigemptyset(&mask);
-        if (sigprocmask(SIG_SETMASK, &mask, NULL) < 0)
-            goto child_err;
-
-        /* Restore ignored (SIG_IGN) signals */
-        struct sigaction dfl = {.sa_handler = SIG_DFL};
-        sigemptyset(&dfl.sa_mask);
-        if (sigaction(SIGHUP, &dfl, NULL) < 0 ||
-            sigaction(SIGPIPE, &dfl, NULL) < 0)
-        {
+        if (setsid() < 0 || !spawn_child_restore_signals())
             goto child_err;
-        }
-
-        if (cwd != NULL) {
-            setenv("PWD", cwd, 1);
-            if (chdir(cwd) < 0) {
-                LOG_WARN("failed to change working directory to %s: %s",
-                         cwd, strerror(errno));
-            }
-        }
 
-        if (xdg_activation_token != NULL) {
-            setenv("XDG_ACTIVATION_TOKEN", xdg_activation_token, 1);
-
-            if (getenv("DISPLAY") != NULL)
-                setenv("DESKTOP_STARTUP_ID", xdg_activation_token, 1);
-        }
+        /* Not fatal; has already been checked above */
+        if (cwd != NULL)
+            (void)!chdir(cwd);
 
         bool close_stderr = stderr_fd >= 0;
         bool close_stdout = stdout_fd >= 0 && stdout_fd != stderr_fd;
@@ -78,14 +268,13 @@ spawn(struct reaper *reaper, const char *cwd, char *const argv[],
             (stdout_fd >= 0 && (dup2(stdout_fd, STDOUT_FILENO) < 0
                                 || (close_stdout && close(stdout_fd) < 0))) ||
             (stderr_fd >= 0 && (dup2(stderr_fd, STDERR_FILENO) < 0
-                                || (close_stderr && close(stderr_fd) < 0))) ||
-            execvp(argv[0], argv) < 0)
+                                || (close_stderr && close(stderr_fd) < 0))))
         {
             goto child_err;
         }
 
-        xassert(false);
-        _exit(errno);
+        /* Only returns on failure */
+        spawn_exec(&exec);
 
     child_err:
         ;
@@ -95,33 +284,44 @@ spawn(struct reaper *reaper, const char *cwd, char *const argv[],
     }
 
     /* Parent */
+    pthread_sigmask(SIG_SETMASK, &original, NULL);
+
+    if (pid < 0) {
+        LOG_ERRNO("failed to vfork");
+        goto out;
+    }
+
     close(pipe_fds[1]);
+    pipe_fds[1] = -1;
 
     int errno_copy;
     static_assert(sizeof(errno_copy) == sizeof(errno), "errno size mismatch");
 
     ssize_t ret = read(pipe_fds[0], &errno_copy, sizeof(errno_copy));
-    close(pipe_fds[0]);
 
-    if (ret == 0) {
+    if (ret == 0)
         reaper_add(reaper, pid, cb, cb_data);
-        return pid;
-    } else if (ret < 0) {
+    else if (ret < 0) {
         LOG_ERRNO("failed to read from pipe");
-        return -1;
+        pid = -1;
     } else {
         LOG_ERRNO_P(errno_copy, "%s: failed to spawn", argv[0]);
-        errno = errno_copy;
         waitpid(pid, NULL, 0);
-        return -1;
+        errno = errno_copy;
+        pid = -1;
     }
 
-err:
+out:
     if (pipe_fds[0] != -1)
         close(pipe_fds[0]);
     if (pipe_fds[1] != -1)
         close(pipe_fds[1]);
-    return -1;
+
+    for (size_t i = 0; i < own_count; i++)
+        free(own_vars[i]);
+    free(envp);
+    spawn_exec_destroy(&exec);
+    return pid;
 }
 
 bool
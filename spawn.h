@@ -10,6 +10,42 @@ pid_t spawn(struct reaper *reaper, const char *cwd, char *const argv[],
             int stdin_fd, int stdout_fd, int stderr_fd,
             reaper_cb cb, void *cb_data, const char *xdg_activation_token);
 
+/*
+ * Helpers for vfork():ed children, which share the parent's memory
+ * until they exec, and thus may only make system calls. In
+ * particular, they must not allocate memory, log, or setenv().
+ */
+
+/* Restores the signal mask, and the signal dispositions, in the child */
+bool spawn_child_restore_signals(void);
+
+/*
+ * execvpe(), for vfork():ed children. 'file' is looked up in 'path'
+ * (a colon separated list of directories, like $PATH), rather than in
+ * our own $PATH; the default search path is used if 'path' is NULL,
+ * or empty. Like execvpe(), empty components are the current
+ * directory, the search continues past non-executable matches, and
+ * files without an executable format are run with /bin/sh.
+ *
+ * spawn_exec_init() prepares everything in the parent, since the
+ * child can't allocate. spawn_exec() only returns on failure, with
+ * errno set.
+ */
+struct spawn_exec {
+    const char *file;
+    char *const *argv;
+    char *const *envp;
+    char *path;
+    char *buf;        /* Candidate pathname */
+    char **sh_argv;   /* ENOEXEC fallback */
+};
+
+void spawn_exec_init(
+    struct spawn_exec *exec, const char *file, char *const argv[],
+    char *const envp[], const char *path);
+void spawn_exec_destroy(struct spawn_exec *exec);
+void spawn_exec(const struct spawn_exec *exec);
+
 bool spawn_expand_template(
     const struct config_spawn_template *template,
     size_t key_count, const char *key_names[static key_count],
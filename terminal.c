@@ -28,13 +28,17 @@
 #include "config.h"
 #include "debug.h"
 #include "extract.h"
+#include "glyph-tiles.h"
 #include "grid.h"
 #include "ime.h"
 #include "input.h"
 #include "notify.h"
+#include "ptmx-reader.h"
+#include "pty-record.h"
 #include "quirks.h"
 #include "reaper.h"
 #include "render.h"
+#include "scrollback-spill.h"
 #include "selection.h"
 #include "shm.h"
 #include "sixel.h"
@@ -48,6 +52,15 @@
 
 #define PTMX_TIMING 0
 
+/* Size of the ring buffer used by the PTY reader thread */
+#define PTMX_RING_SIZE (1024 * 1024)
+
+/* Size of each chunk read from the PTY (or ring buffer), and parsed */
+#define PTMX_CHUNK_SIZE (24 * 1024)
+
+/* Lower bound of the adaptive PTY parse budget */
+#define PTMX_MIN_BUDGET_NS 500000  /* 0.5ms */
+
 static void
 enqueue_data_for_slave(const void *data, size_t len, size_t offset,
                        ptmx_buffer_list_t *buffer_list)
@@ -234,6 +247,231 @@ static struct timespec last = {0};
 
 static bool cursor_blink_rearm_timer(struct terminal *term);
 
+static void
+ptmx_schedule_render(struct terminal *term)
+{
+    if (term->render.app_sync_updates.enabled)
+        return;
+
+    /*
+     * We likely need to re-render. But, we don't want to do it
+     * immediately. Often, a single client update is done through
+     * multiple writes. This could lead to us rendering one frame with
+     * "intermediate" state.
+     *
+     * For example, we might end up rendering a frame
+     * where the client just erased a line, while in the
+     * next frame, the client wrote to the same line. This
+     * causes screen "flickering".
+     *
+     * Mitigate by always incuring a small delay before
+     * rendering the next frame. This gives the client
+     * some time to finish the operation (and thus gives
+     * us time to receive the last writes before doing any
+     * actual rendering).
+     *
+     * We incur this delay *every* time we receive
+     * input. To ensure we don't delay rendering
+     * indefinitely, we start a second timer that is only
+     * reset when we render.
+     *
+     * Note that when the client is producing data at a
+     * very high pace, we're rate limited by the wayland
+     * compositor anyway. The delay we introduce here only
+     * has any effect when the renderer is idle.
+     */
+    uint64_t lower_ns = term->conf->tweak.delayed_render_lower_ns;
+    uint64_t upper_ns = term->conf->tweak.delayed_render_upper_ns;
+
+    if (lower_ns > 0 && upper_ns > 0) {
+#if PTMX_TIMING
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (last.tv_sec > 0 || last.tv_nsec > 0) {
+            struct timespec diff;
+
+            timespec_sub(&now, &last, &diff);
+            LOG_INFO("waited %lds %ldns for more input",
+                     (long)diff.tv_sec, diff.tv_nsec);
+        }
+        last = now;
+#endif
+
+        xassert(lower_ns < 1000000000);
+        xassert(upper_ns < 1000000000);
+        xassert(upper_ns > lower_ns);
+
+        timerfd_settime(
+            term->delayed_render_timer.lower_fd, 0,
+            &(struct itimerspec){.it_value = {.tv_nsec = lower_ns}},
+            NULL);
+
+        /* Second timeout - only reset when we render. Set to one
+         * frame (assuming 60Hz) */
+        if (!term->delayed_render_timer.is_armed) {
+            timerfd_settime(
+                term->delayed_render_timer.upper_fd, 0,
+                &(struct itimerspec){.it_value = {.tv_nsec = upper_ns}},
+                NULL);
+            term->delayed_render_timer.is_armed = true;
+        }
+    } else
+        render_refresh(term);
+}
+
+static uint64_t
+ns_between(const struct timespec *start, const struct timespec *end)
+{
+    struct timespec diff;
+    timespec_sub(end, start, &diff);
+    return diff.tv_sec < 0 ? 0 : diff.tv_sec * 1000000000ull + diff.tv_nsec;
+}
+
+/*
+ * Returns the amount of time we may spend parsing PTY data, before
+ * returning to the FDM.
+ *
+ * Unless configured explicitly (tweak.pty-parse-budget), the slice
+ * is sized to end before the next (predicted) vblank, minus the time
+ * it takes us to render a frame. This gives the frame callback, or
+ * delayed render timers, a chance to run in time for the next vblank.
+ */
+static uint64_t
+ptmx_parse_budget(const struct terminal *term, const struct timespec *now)
+{
+    if (term->conf->tweak.pty_parse_budget_ns > 0)
+        return term->conf->tweak.pty_parse_budget_ns;
+
+    const struct timespec *last = &term->render.frame_timing.last_presented;
+    uint64_t refresh_ns = term->render.frame_timing.refresh_ns;
+
+    if (refresh_ns == 0 || (last->tv_sec == 0 && last->tv_nsec == 0)) {
+        /* No presentation feedback; fallback to half a frame */
+        float refresh = 60.;
+        if (term->window != NULL && tll_length(term->window->on_outputs) > 0) {
+            const struct monitor *mon = tll_front(term->window->on_outputs);
+            if (mon->refresh > 0.)
+                refresh = mon->refresh;
+        }
+
+        return max(PTMX_MIN_BUDGET_NS, (uint64_t)(1000000000. / refresh / 2));
+    }
+
+    const uint64_t until_vblank =
+        refresh_ns - ns_between(last, now) % refresh_ns;
+    const uint64_t render_ns = term->render.frame_timing.render_ns;
+
+    uint64_t budget = until_vblank > render_ns
+        ? until_vblank - render_ns
+        : until_vblank + refresh_ns - render_ns;
+
+    return min(max(budget, PTMX_MIN_BUDGET_NS), refresh_ns);
+}
+
+struct ptmx_slice {
+    struct timespec start;
+    struct timespec last;
+    uint64_t budget_ns;
+};
+
+static void
+ptmx_slice_begin(struct terminal *term, struct ptmx_slice *slice, bool unlimited)
+{
+    clock_gettime(CLOCK_MONOTONIC, &slice->start);
+    slice->last = slice->start;
+
+    if (unlimited)
+        slice->budget_ns = UINT64_MAX;
+    else
+        slice->budget_ns = term->ptmx_sched.budget_ns =
+            ptmx_parse_budget(term, &slice->start);
+}
+
+/*
+ * Accounts 'count' bytes just parsed, and returns whether there's
+ * time left in the slice to parse another chunk.
+ */
+static bool
+ptmx_slice_continue(struct terminal *term, struct ptmx_slice *slice, size_t count)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    term->ptmx_sched.bytes += count;
+
+    /* Small chunks are dominated by per-call overhead; don't let
+     * them skew the throughput estimate */
+    if (count >= 4096) {
+        const uint64_t ns_per_kib = ns_between(&slice->last, &now) * 1024 / count;
+        uint64_t *avg = &term->ptmx_sched.ns_per_kib;
+        *avg = *avg == 0 ? ns_per_kib : (*avg * 7 + ns_per_kib) / 8;
+    }
+
+    slice->last = now;
+
+    if (slice->budget_ns == UINT64_MAX)
+        return true;
+
+    /* Don't start parsing a chunk we don't expect to finish in time */
+    const uint64_t elapsed = ns_between(&slice->start, &now);
+    const uint64_t expected =
+        term->ptmx_sched.ns_per_kib * (PTMX_CHUNK_SIZE / 1024);
+
+    return elapsed + expected < slice->budget_ns;
+}
+
+/* First PTY data after a traced key press; see render_latency_key_pressed() */
+static void
+ptmx_latency_echo(struct terminal *term)
+{
+    if (likely(!term->render.latency.tracing) || term->render.latency.echoed)
+        return;
+
+    clock_gettime(term->wl->presentation_clock_id, &term->render.latency.echo);
+    term->render.latency.echoed = true;
+}
+
+static void
+ptmx_reader_stop(struct terminal *term)
+{
+    if (term->ptmx_reader == NULL)
+        return;
+
+    fdm_del_no_close(term->fdm, ptmx_reader_fd(term->ptmx_reader));
+    ptmx_reader_destroy(term->ptmx_reader);
+    term->ptmx_reader = NULL;
+}
+
+static void
+ptmx_hangup(struct terminal *term)
+{
+    ptmx_reader_stop(term);
+
+    del_utmp_record(term->conf, term->reaper, term->ptmx);
+
+    if (term->ptmx_unregistered)
+        close(term->ptmx);
+    else
+        fdm_del(term->fdm, term->ptmx);
+
+    term->ptmx = -1;
+
+    /*
+     * Normally, we do *not* want to shutdown when the PTY is
+     * closed. Instead, we want to wait for the client application
+     * to exit.
+     *
+     * However, when we're using a pre-existing PTY (the --pty
+     * option), there _is_ no client application. That is, foot
+     * does *not* fork+exec anything, and thus the only way to
+     * shutdown is to wait for the PTY to be closed.
+     */
+    if (term->slave < 0 && !term->conf->hold_at_exit) {
+        term_shutdown(term);
+    }
+}
+
 /* Externally visible, but not declared in terminal.h, to enable pgo
  * to call this function directly */
 bool
@@ -250,6 +488,20 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
             return false;
     }
 
+    if (term->ptmx_reader != NULL) {
+        /*
+         * The reader thread owns reading from the PTY, and will see
+         * the hangup itself, once it has drained the PTY. Stop
+         * watching the FD, to avoid EPOLLHUP being reported over and
+         * over again.
+         */
+        if (hup) {
+            fdm_del_no_close(fdm, fd);
+            term->ptmx_unregistered = true;
+        }
+        return true;
+    }
+
     /* Prevent blinking while typing */
     if (term->cursor_blink.fd >= 0) {
         term->cursor_blink.state = CURSOR_BLINK_ON;
@@ -266,11 +518,13 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
         return true;
     }
 
-    uint8_t buf[24 * 1024];
-    const size_t max_iterations = !hup ? 10 : SIZE_MAX;
+    uint8_t buf[PTMX_CHUNK_SIZE];
+
+    /* On hangup, drain the PTY completely */
+    struct ptmx_slice slice;
+    ptmx_slice_begin(term, &slice, hup);
 
-    for (size_t i = 0; i < max_iterations && pollin; i++) {
-        xassert(pollin);
+    while (pollin) {
         ssize_t count = read(term->ptmx, buf, sizeof(buf));
 
         if (count < 0) {
@@ -290,109 +544,116 @@ fdm_ptmx(struct fdm *fdm, int fd, int events, void *data)
         }
 
         xassert(term->interactive_resizing.grid == NULL);
+
+        ptmx_latency_echo(term);
+
+        if (unlikely(term->pty_recorder != NULL))
+            pty_record_data(term->pty_recorder, buf, count);
+
         vt_from_slave(term, buf, count);
-    }
 
-    if (!term->render.app_sync_updates.enabled) {
         /*
-         * We likely need to re-render. But, we don't want to do it
-         * immediately. Often, a single client update is done through
-         * multiple writes. This could lead to us rendering one frame with
-         * "intermediate" state.
-         *
-         * For example, we might end up rendering a frame
-         * where the client just erased a line, while in the
-         * next frame, the client wrote to the same line. This
-         * causes screen "flickering".
-         *
-         * Mitigate by always incuring a small delay before
-         * rendering the next frame. This gives the client
-         * some time to finish the operation (and thus gives
-         * us time to receive the last writes before doing any
-         * actual rendering).
-         *
-         * We incur this delay *every* time we receive
-         * input. To ensure we don't delay rendering
-         * indefinitely, we start a second timer that is only
-         * reset when we render.
-         *
-         * Note that when the client is producing data at a
-         * very high pace, we're rate limited by the wayland
-         * compositor anyway. The delay we introduce here only
-         * has any effect when the renderer is idle.
+         * If we run out of time, the FDM will call us again as soon
+         * as it has dispatched other pending events, since there's
+         * still data to read.
          */
-        uint64_t lower_ns = term->conf->tweak.delayed_render_lower_ns;
-        uint64_t upper_ns = term->conf->tweak.delayed_render_upper_ns;
+        if (!ptmx_slice_continue(term, &slice, count))
+            break;
+    }
 
-        if (lower_ns > 0 && upper_ns > 0) {
-#if PTMX_TIMING
-            struct timespec now;
+    ptmx_schedule_render(term);
 
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            if (last.tv_sec > 0 || last.tv_nsec > 0) {
-                struct timespec diff;
+    if (hup)
+        ptmx_hangup(term);
 
-                timespec_sub(&now, &last, &diff);
-                LOG_INFO("waited %lds %ldns for more input",
-                         (long)diff.tv_sec, diff.tv_nsec);
-            }
-            last = now;
-#endif
+    return true;
+}
 
-            xassert(lower_ns < 1000000000);
-            xassert(upper_ns < 1000000000);
-            xassert(upper_ns > lower_ns);
+/*
+ * Parses data buffered by the PTY reader thread (tweak.pty-reader-thread).
+ *
+ * Parsing is done in time bounded slices (see ptmx_parse_budget());
+ * if there's data left when the slice ends, we re-trigger ourselves
+ * and yield to the FDM, to let it dispatch keyboard input, Wayland
+ * events and frame callbacks in between.
+ */
+static bool
+fdm_ptmx_ring(struct fdm *fdm, int fd, int events, void *data)
+{
+    struct terminal *term = data;
+    struct ptmx_reader *reader = term->ptmx_reader;
 
-            timerfd_settime(
-                term->delayed_render_timer.lower_fd, 0,
-                &(struct itimerspec){.it_value = {.tv_nsec = lower_ns}},
-                NULL);
+    if (events & EPOLLHUP)
+        return false;
 
-            /* Second timeout - only reset when we render. Set to one
-             * frame (assuming 60Hz) */
-            if (!term->delayed_render_timer.is_armed) {
-                timerfd_settime(
-                    term->delayed_render_timer.upper_fd, 0,
-                    &(struct itimerspec){.it_value = {.tv_nsec = upper_ns}},
-                    NULL);
-                term->delayed_render_timer.is_armed = true;
-            }
-        } else
-            render_refresh(term);
+    if (unlikely(term->interactive_resizing.grid != NULL)) {
+        /*
+         * See fdm_ptmx(). Don't ack; we may have been dispatched in
+         * the same epoll batch as the event that paused us, and the
+         * event FD must remain readable until we're resumed, or
+         * we'll never be woken up again.
+         */
+        return true;
     }
 
-    if (hup) {
-        del_utmp_record(term->conf, term->reaper, term->ptmx);
-        fdm_del(fdm, fd);
-        term->ptmx = -1;
+    ptmx_reader_ack(reader);
 
-        /*
-         * Normally, we do *not* want to shutdown when the PTY is
-         * closed. Instead, we want to wait for the client application
-         * to exit.
-         *
-         * However, when we're using a pre-existing PTY (the --pty
-         * option), there _is_ no client application. That is, foot
-         * does *not* fork+exec anything, and thus the only way to
-         * shutdown is to wait for the PTY to be closed.
-         */
-        if (term->slave < 0 && !term->conf->hold_at_exit) {
-            term_shutdown(term);
+    struct ptmx_slice slice;
+    ptmx_slice_begin(term, &slice, false);
+
+    bool consumed = false;
+    const uint8_t *p;
+    size_t len;
+
+    while ((p = ptmx_reader_peek(reader, &len)) != NULL) {
+        len = min(len, PTMX_CHUNK_SIZE);
+
+        ptmx_latency_echo(term);
+
+        if (unlikely(term->pty_recorder != NULL))
+            pty_record_data(term->pty_recorder, p, len);
+
+        vt_from_slave(term, p, len);
+        ptmx_reader_consume(reader, len);
+        consumed = true;
+
+        if (!ptmx_slice_continue(term, &slice, len)) {
+            /* Out of time; continue in the next FDM iteration */
+            if (ptmx_reader_peek(reader, &len) != NULL)
+                ptmx_reader_kick(reader);
+            break;
         }
     }
 
+    if (consumed) {
+        /* Prevent blinking while typing */
+        if (term->cursor_blink.fd >= 0) {
+            term->cursor_blink.state = CURSOR_BLINK_ON;
+            cursor_blink_rearm_timer(term);
+        }
+
+        ptmx_schedule_render(term);
+    }
+
+    if (ptmx_reader_eof(reader))
+        ptmx_hangup(term);
+
     return true;
 }
 
 bool
 term_ptmx_pause(struct terminal *term)
 {
+    if (term->ptmx_reader != NULL)
+        return fdm_event_del(term->fdm, ptmx_reader_fd(term->ptmx_reader), EPOLLIN);
     return fdm_event_del(term->fdm, term->ptmx, EPOLLIN);
 }
 
 bool
 term_ptmx_resume(struct terminal *term)
 {
+    if (term->ptmx_reader != NULL)
+        return fdm_event_add(term->fdm, ptmx_reader_fd(term->ptmx_reader), EPOLLIN);
     return fdm_event_add(term->fdm, term->ptmx, EPOLLIN);
 }
 
@@ -666,49 +927,21 @@ fdm_app_id_update_timeout(struct fdm *fdm, int fd, int events, void *data)
 static bool
 initialize_render_workers(struct terminal *term)
 {
-    LOG_INFO("using %hu rendering threads", term->render.workers.count);
-
-    if (sem_init(&term->render.workers.start, 0, 0) < 0 ||
-        sem_init(&term->render.workers.done, 0, 0) < 0)
-    {
-        LOG_ERRNO("failed to instantiate render worker semaphores");
-        return false;
-    }
-
     int err;
     if ((err = mtx_init(&term->render.workers.lock, mtx_plain)) != thrd_success) {
         LOG_ERR("failed to instantiate render worker mutex: %s (%d)",
                 thrd_err_as_string(err), err);
-        goto err_sem_destroy;
+        return false;
     }
 
-    term->render.workers.threads = xcalloc(
-        term->render.workers.count, sizeof(term->render.workers.threads[0]));
-
-    for (size_t i = 0; i < term->render.workers.count; i++) {
-        struct render_worker_context *ctx = xmalloc(sizeof(*ctx));
-        *ctx = (struct render_worker_context) {
-            .term = term,
-            .my_id = 1 + i,
-        };
-
-        int ret = thrd_create(
-            &term->render.workers.threads[i], &render_worker_thread, ctx);
-        if (ret != thrd_success) {
+    if (term->render.workers.count == 0)
+        return true;
 
-            LOG_ERR("failed to create render worker thread: %s (%d)",
-                    thrd_err_as_string(ret), ret);
-            term->render.workers.threads[i] = 0;
-            return false;
-        }
-    }
+    if (!render_workers_ref(term->render.workers.count))
+        return false;
 
+    term->render.workers.pool_ref = true;
     return true;
-
-err_sem_destroy:
-    sem_destroy(&term->render.workers.start);
-    sem_destroy(&term->render.workers.done);
-    return false;
 }
 
 static void
@@ -767,6 +1000,18 @@ term_line_height_update(struct terminal *term)
     term->font_line_height.pt = fmaxf(line_original_pt_size * change, 0.);
 }
 
+/* Resets glyph pointers cached by the renderer */
+static void
+reset_glyph_caches(struct terminal *term)
+{
+    for (size_t i = 0; i < ALEN(term->direct_glyphs); i++) {
+        for (size_t j = 0; j < GLYPH_DIRECT_COUNT; j++)
+            atomic_store_explicit(&term->direct_glyphs[i][j], NULL, memory_order_relaxed);
+    }
+
+    composed_reset_glyphs(&term->composed);
+}
+
 static bool
 term_set_fonts(struct terminal *term, struct fcft_font *fonts[static 4],
                bool resize_grid)
@@ -785,6 +1030,10 @@ term_set_fonts(struct terminal *term, struct fcft_font *fonts[static 4],
     free_custom_glyphs(
         &term->custom_glyphs.legacy, GLYPH_LEGACY_COUNT);
 
+    /* These reference glyphs from the old fonts */
+    reset_glyph_caches(term);
+    glyph_tiles_reset(term->render.glyph_tiles);
+
     const struct config *conf = term->conf;
 
     const struct fcft_glyph *M = fcft_rasterize_char_utf32(
@@ -1217,6 +1466,7 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         .scale_before_unmap = -1,
         .flash = {.fd = flash_fd},
         .blink = {.fd = -1},
+        .reflow_pending_fd = -1,
         .vt = {
             .state = 0,  /* STATE_GROUND */
         },
@@ -1259,7 +1509,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
         .normal = {.scroll_damage = tll_init(), .sixel_images = tll_init()},
         .alt = {.scroll_damage = tll_init(), .sixel_images = tll_init()},
         .grid = &term->normal,
-        .composed = NULL,
         .alt_scrolling = conf->mouse.alternate_scroll_mode,
         .meta = {
             .esc_prefix = true,
@@ -1289,7 +1538,6 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
             },
             .workers = {
                 .count = conf->render_worker_count,
-                .queue = tll_init(),
             },
         },
         .delayed_render_timer = {
@@ -1319,6 +1567,11 @@ term_init(const struct config *conf, struct fdm *fdm, struct reaper *reaper,
     };
 
     pixman_region32_init(&term->render.last_overlay_clip);
+    composed_init(&term->composed);
+    term->render.glyph_tiles = glyph_tiles_init();
+
+    if (conf->scrollback.spill)
+        term->scrollback_spill = scrollback_spill_init(&term->composed);
 
     term_update_ascii_printer(term);
 
@@ -1414,7 +1667,41 @@ term_window_configured(struct terminal *term)
     /* Enable ptmx FDM callback */
     if (!term->shutdown.in_progress) {
         xassert(term->window->is_configured);
-        fdm_add(term->fdm, term->ptmx, EPOLLIN, &fdm_ptmx, term);
+
+        if (term->conf->tweak.pty_record != NULL && term->pty_recorder == NULL) {
+            char *path = xasprintf(
+                "%s.%d", term->conf->tweak.pty_record,
+                (int)(term->slave > 0 ? term->slave : getpid()));
+            term->pty_recorder = pty_record_open(path);
+            free(path);
+
+            if (term->pty_recorder != NULL) {
+                pty_record_resize(
+                    term->pty_recorder, term->cols, term->rows,
+                    term->cols * term->cell_width,
+                    term->rows * term->cell_height);
+            }
+        }
+
+        if (term->conf->tweak.pty_reader_thread) {
+            term->ptmx_reader = ptmx_reader_init(term->ptmx, PTMX_RING_SIZE);
+
+            if (term->ptmx_reader != NULL &&
+                !fdm_add(term->fdm, ptmx_reader_fd(term->ptmx_reader),
+                         EPOLLIN, &fdm_ptmx_ring, term))
+            {
+                ptmx_reader_destroy(term->ptmx_reader);
+                term->ptmx_reader = NULL;
+            }
+
+            if (term->ptmx_reader == NULL)
+                LOG_WARN("falling back to reading the PTY on the main thread");
+        }
+
+        /* With a reader thread, we only need the ptmx FD for
+         * (asynchronous) writes */
+        fdm_add(term->fdm, term->ptmx,
+                term->ptmx_reader != NULL ? 0 : EPOLLIN, &fdm_ptmx, term);
     }
 }
 
@@ -1627,12 +1914,16 @@ term_shutdown(struct terminal *term)
     fdm_del(term->fdm, term->delayed_render_timer.upper_fd);
     fdm_del(term->fdm, term->blink.fd);
     fdm_del(term->fdm, term->flash.fd);
+    fdm_del(term->fdm, term->reflow_pending_fd);
 
+    ptmx_reader_stop(term);
     del_utmp_record(term->conf, term->reaper, term->ptmx);
 
-    if (term->window != NULL && term->window->is_configured)
+    if (term->window != NULL && term->window->is_configured &&
+        !term->ptmx_unregistered)
+    {
         fdm_del(term->fdm, term->ptmx);
-    else
+    } else
         close(term->ptmx);
 
     if (!term->shutdown.client_has_terminated) {
@@ -1678,6 +1969,7 @@ term_shutdown(struct terminal *term)
     term->delayed_render_timer.upper_fd = -1;
     term->blink.fd = -1;
     term->flash.fd = -1;
+    term->reflow_pending_fd = -1;
     term->ptmx = -1;
 
     int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
@@ -1733,34 +2025,34 @@ term_destroy(struct terminal *term)
     fdm_del(term->fdm, term->cursor_blink.fd);
     fdm_del(term->fdm, term->blink.fd);
     fdm_del(term->fdm, term->flash.fd);
-    fdm_del(term->fdm, term->ptmx);
+    fdm_del(term->fdm, term->reflow_pending_fd);
+
+    ptmx_reader_stop(term);
+    if (term->ptmx_unregistered)
+        close(term->ptmx);
+    else
+        fdm_del(term->fdm, term->ptmx);
+
+    pty_record_close(term->pty_recorder);
+
+    if (term->conf->presentation_timings && term->render.latency.count > 0)
+        render_latency_log(term);
+    free(term->render.latency.samples);
+
     if (term->shutdown.terminate_timeout_fd >= 0)
         fdm_del(term->fdm, term->shutdown.terminate_timeout_fd);
 
+    tll_foreach(term->render.presentation_feedbacks, it) {
+        free(wp_presentation_feedback_get_user_data(it->item));
+        wp_presentation_feedback_destroy(it->item);
+        tll_remove(term->render.presentation_feedbacks, it);
+    }
+
     if (term->window != NULL) {
         wayl_win_destroy(term->window);
         term->window = NULL;
     }
 
-    mtx_lock(&term->render.workers.lock);
-    xassert(tll_length(term->render.workers.queue) == 0);
-
-    /* Count livinig threads - we may get here when only some of the
-     * threads have been successfully started */
-    size_t worker_count = 0;
-    if (term->render.workers.threads != NULL) {
-        for (size_t i = 0; i < term->render.workers.count; i++, worker_count++) {
-            if (term->render.workers.threads[i] == 0)
-                break;
-        }
-
-        for (size_t i = 0; i < worker_count; i++) {
-            sem_post(&term->render.workers.start);
-            tll_push_back(term->render.workers.queue, -2);
-        }
-    }
-    mtx_unlock(&term->render.workers.lock);
-
     key_binding_unref(term->wl->key_binding_manager, term->conf);
 
     urls_reset(term);
@@ -1768,7 +2060,9 @@ term_destroy(struct terminal *term)
     free(term->vt.osc.data);
     free(term->vt.osc8.uri);
 
-    composed_free(term->composed);
+    composed_free(&term->composed);
+    scrollback_spill_destroy(term->scrollback_spill);
+    glyph_tiles_destroy(term->render.glyph_tiles);
 
     free(term->app_id);
     free(term->window_title);
@@ -1790,18 +2084,9 @@ term_destroy(struct terminal *term)
     free(term->search.buf);
     free(term->search.last.buf);
 
-    if (term->render.workers.threads != NULL) {
-        for (size_t i = 0; i < term->render.workers.count; i++) {
-            if (term->render.workers.threads[i] != 0)
-                thrd_join(term->render.workers.threads[i], NULL);
-        }
-    }
-    free(term->render.workers.threads);
+    if (term->render.workers.pool_ref)
+        render_workers_unref();
     mtx_destroy(&term->render.workers.lock);
-    sem_destroy(&term->render.workers.start);
-    sem_destroy(&term->render.workers.done);
-    xassert(tll_length(term->render.workers.queue) == 0);
-    tll_free(term->render.workers.queue);
 
     shm_unref(term->render.last_buf);
     shm_chain_free(term->render.chains.grid);
@@ -1842,6 +2127,10 @@ term_destroy(struct terminal *term)
     grid_free(term->interactive_resizing.grid);
     free(term->interactive_resizing.grid);
 
+    /* Don't hang on to recycled rows after a (server mode) window
+     * has been closed */
+    grid_cell_cache_flush();
+
     free(term->foot_exe);
     free(term->cwd);
     free(term->mouse_user_cursor);
@@ -2340,6 +2629,7 @@ term_font_subpixel_changed(struct terminal *term)
 #endif
 
     term->font_subpixel = subpixel;
+    reset_glyph_caches(term);
     term_damage_view(term);
     render_refresh(term);
 }
@@ -2370,8 +2660,7 @@ term_damage_rows(struct terminal *term, int start, int end)
     for (int r = start; r <= end; r++) {
         struct row *row = grid_row(term->grid, r);
         row->dirty = true;
-        for (int c = 0; c < term->grid->num_cols; c++)
-            row->cells[c].attrs.clean = 0;
+        row->all_dirty = true;
     }
 }
 
@@ -2382,8 +2671,7 @@ term_damage_rows_in_view(struct terminal *term, int start, int end)
     for (int r = start; r <= end; r++) {
         struct row *row = grid_row_in_view(term->grid, r);
         row->dirty = true;
-        for (int c = 0; c < term->grid->num_cols; c++)
-            row->cells[c].attrs.clean = 0;
+        row->all_dirty = true;
     }
 }
 
@@ -2417,8 +2705,22 @@ term_damage_color(struct terminal *term, enum color_source src, int idx)
 {
     xassert(src == COLOR_DEFAULT || src == COLOR_BASE256);
 
+    if (src == COLOR_DEFAULT) {
+        /*
+         * Practically all cells use the default foreground, or
+         * background, color (and with color inversion/reversal, a
+         * default color may end up on either side). Dirty entire
+         * rows, instead of checking each cell.
+         */
+        term_damage_view(term);
+        return;
+    }
+
     for (int r = 0; r < term->rows; r++) {
         struct row *row = grid_row_in_view(term->grid, r);
+        if (row->all_dirty)
+            continue;
+
         struct cell *cell = &row->cells[0];
         const struct cell *end = &row->cells[term->cols];
 
@@ -2428,20 +2730,11 @@ term_damage_color(struct terminal *term, enum color_source src, int idx)
             switch (cell->attrs.fg_src) {
             case COLOR_BASE16:
             case COLOR_BASE256:
-                if (src == COLOR_BASE256 && cell->attrs.fg == idx)
+                if (cell->attrs.fg == idx)
                     dirty = true;
                 break;
 
             case COLOR_DEFAULT:
-                if (src == COLOR_DEFAULT) {
-                    /* Doesn't matter whether we've updated the
-                       default foreground, or background, we still
-                       want to dirty this cell, to be sure we handle
-                       all cases of color inversion/reversal */
-                    dirty = true;
-                }
-                break;
-
             case COLOR_RGB:
                 /* Not affected */
                 break;
@@ -2450,20 +2743,11 @@ term_damage_color(struct terminal *term, enum color_source src, int idx)
             switch (cell->attrs.bg_src) {
             case COLOR_BASE16:
             case COLOR_BASE256:
-                if (src == COLOR_BASE256 && cell->attrs.bg == idx)
+                if (cell->attrs.bg == idx)
                     dirty = true;
                 break;
 
             case COLOR_DEFAULT:
-                if (src == COLOR_DEFAULT) {
-                    /* Doesn't matter whether we've updated the
-                       default foreground, or background, we still
-                       want to dirty this cell, to be sure we handle
-                       all cases of color inversion/reversal */
-                    dirty = true;
-                }
-                break;
-
             case COLOR_RGB:
                 /* Not affected */
                 break;
@@ -2637,6 +2921,11 @@ term_erase_scrollback(struct terminal *term)
 
     term->grid->view = term->grid->offset;
 
+    grid_reflow_pending_discard(term->grid, NULL);
+
+    if (term->scrollback_spill != NULL && term->grid == &term->normal)
+        scrollback_spill_reset(term->scrollback_spill);
+
 #if defined(_DEBUG)
     for (int i = 0; i < term->rows; i++) {
         xassert(grid_row_in_view(term->grid, i) != NULL);
@@ -2936,6 +3225,154 @@ selection_on_bottom_region(const struct terminal *term,
         selection_on_rows(term, region.end, term->rows - 1);
 }
 
+/*
+ * Packs (compresses) 'count' scrollback rows, starting 'distance'
+ * rows above the top of the screen, and moving up.
+ *
+ * Packed rows are unpacked again when accessed (rendered, searched,
+ * selected etc).
+ */
+static void
+pack_cold_scrollback_rows(struct terminal *term, int count)
+{
+    struct grid *grid = &term->normal;
+    const int mask = grid->num_rows - 1;
+
+    const uint64_t screens = term->conf->tweak.scrollback_compress_after;
+    if (screens == 0 || screens * term->rows >= grid->num_rows)
+        return;
+
+    const int distance = screens * term->rows;
+
+    /* Don't go past the scrollback start */
+    count = min(count, grid->num_rows - term->rows - distance + 1);
+
+    for (int i = 0; i < count; i++) {
+        const int r = (grid->offset - distance - i) & mask;
+        struct row *row = grid->rows[r];
+
+        if (row == NULL)
+            break;
+        if (row->packed != NULL)
+            continue;
+
+        /* Rows in view will be unpacked again on the next frame */
+        if (((r - grid->view) & mask) < term->rows)
+            continue;
+
+        grid_row_pack(row, grid->num_cols);
+    }
+}
+
+void
+term_pack_cold_scrollback(struct terminal *term)
+{
+    pack_cold_scrollback_rows(term, term->normal.num_rows);
+}
+
+/* Number of old rows (i.e. from before the resize) to reflow per
+ * iteration of the main loop */
+#define REFLOW_PENDING_BATCH 1024
+
+/* Packs the 'count' oldest rows in the scrollback, if they're cold */
+static void
+pack_oldest_scrollback_rows(struct terminal *term, int count)
+{
+    struct grid *grid = &term->normal;
+    const int mask = grid->num_rows - 1;
+
+    const uint64_t screens = term->conf->tweak.scrollback_compress_after;
+    if (screens == 0 || screens * term->rows >= grid->num_rows)
+        return;
+
+    const int distance = screens * term->rows;
+    const int sb_start = grid_sb_start_ignore_uninitialized(grid, term->rows);
+
+    for (int i = 0; i < count; i++) {
+        const int r = (sb_start + i) & mask;
+        struct row *row = grid->rows[r];
+
+        /* Everything below this row is even closer to the screen */
+        if (((grid->offset - r) & mask) < distance)
+            break;
+
+        if (((r - grid->view) & mask) < term->rows)
+            continue;
+
+        if (row->packed == NULL)
+            grid_row_pack(row, grid->num_cols);
+    }
+}
+
+/*
+ * Reflows (roughly) 'max_rows' rows of the normal grid's old
+ * scrollback, that was left un-reflowed by the last resize. Returns
+ * the number of rows added to the top of the scrollback.
+ */
+int
+term_reflow_pending(struct terminal *term, int max_rows)
+{
+    const int added = grid_reflow_pending(
+        &term->normal, term->rows, max_rows, term->scrollback_spill);
+    pack_oldest_scrollback_rows(term, added);
+    return added;
+}
+
+void
+term_reflow_pending_finish(struct terminal *term)
+{
+    while (grid_reflow_is_pending(&term->normal))
+        term_reflow_pending(term, REFLOW_PENDING_BATCH * 16);
+}
+
+static bool
+fdm_reflow_pending(struct fdm *fdm, int fd, int events, void *data)
+{
+    struct terminal *term = data;
+
+    /*
+     * The event FD is never reset; i.e. we're called once per
+     * iteration of the main loop, in between handling input, client
+     * output and rendering.
+     */
+    term_reflow_pending(term, REFLOW_PENDING_BATCH);
+
+    if (!grid_reflow_is_pending(&term->normal)) {
+        LOG_DBG("lazy reflow done");
+        fdm_del(fdm, term->reflow_pending_fd);
+        term->reflow_pending_fd = -1;
+    }
+
+    return true;
+}
+
+/*
+ * Called after the normal grid has been reflowed. Large scrollbacks
+ * are only partially reflowed (see grid_resize_and_reflow()); reflow
+ * the rest in the background.
+ */
+void
+term_reflow_pending_schedule(struct terminal *term)
+{
+    if (term->reflow_pending_fd >= 0 || !grid_reflow_is_pending(&term->normal))
+        return;
+
+    int fd = eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0) {
+        LOG_ERRNO("failed to create reflow event FD");
+        term_reflow_pending_finish(term);
+        return;
+    }
+
+    if (!fdm_add(term->fdm, fd, EPOLLIN, &fdm_reflow_pending, term)) {
+        close(fd);
+        term_reflow_pending_finish(term);
+        return;
+    }
+
+    term->reflow_pending_fd = fd;
+}
+
 void
 term_scroll_partial(struct terminal *term, struct scroll_region region, int rows)
 {
@@ -2991,12 +3428,34 @@ term_scroll_partial(struct terminal *term, struct scroll_region region, int rows
 
     /* Erase scrolled in lines */
     for (int r = region.end - rows; r < region.end; r++) {
+        if (unlikely(term->scrollback_spill != NULL) &&
+            term->grid == &term->normal)
+        {
+            /* When the scrollback is full, we're re-using its oldest rows */
+            const struct row *evicted =
+                term->grid->rows[grid_row_absolute(term->grid, r)];
+
+            if (evicted != NULL) {
+                /* Rows not yet reflowed after a resize are even older,
+                 * and can no longer be placed in the scrollback */
+                grid_reflow_pending_discard(
+                    term->grid, term->scrollback_spill);
+
+                scrollback_spill_row(
+                    term->scrollback_spill, evicted, term->grid->num_cols);
+            }
+        }
+
         struct row *row = grid_row_and_alloc(term->grid, r);
         erase_line(term, row);
     }
 
     term->grid->cur_row = grid_row(term->grid, term->grid->cursor.point.row);
 
+    /* Rows that just became cold */
+    if (term->grid == &term->normal)
+        pack_cold_scrollback_rows(term, rows);
+
 #if defined(_DEBUG)
     for (int r = 0; r < term->rows; r++)
         xassert(grid_row(term->grid, r) != NULL);
@@ -3795,6 +4254,78 @@ term_fill(struct terminal *term, int r, int c, uint8_t data, size_t count,
     }
 }
 
+static void
+composed_mark_rows(struct composed_table *table,
+                   struct row *const *rows, int count, int cols)
+{
+    struct cell *unpacked = NULL;
+
+    for (int r = 0; r < count; r++) {
+        const struct row *row = rows[r];
+        if (row == NULL)
+            continue;
+
+        const struct cell *cells = row->cells;
+
+        if (row->packed != NULL) {
+            /* Don't unpack cold rows just for this */
+            if (unpacked == NULL)
+                unpacked = xmalloc(cols * sizeof(unpacked[0]));
+            grid_row_unpack_into(row, unpacked, cols);
+            cells = unpacked;
+        }
+
+        for (int c = 0; c < cols; c++) {
+            const char32_t wc = cells[c].wc;
+            if (wc >= CELL_COMB_CHARS_LO && wc <= CELL_COMB_CHARS_HI)
+                composed_mark(table, wc - CELL_COMB_CHARS_LO);
+        }
+    }
+
+    free(unpacked);
+}
+
+static void
+composed_mark_grid(struct composed_table *table, const struct grid *grid)
+{
+    composed_mark_rows(table, grid->rows, grid->num_rows, grid->num_cols);
+
+    tll_foreach(grid->reflow_pending, it) {
+        composed_mark_rows(
+            table, it->item.rows, it->item.count, it->item.cols);
+    }
+}
+
+/*
+ * Frees composed characters that are no longer referenced by any
+ * cell; typically because the rows referencing them have been evicted
+ * from the scrollback, or overwritten.
+ */
+void
+term_composed_gc(struct terminal *term)
+{
+    struct composed_table *table = &term->composed;
+
+    composed_mark_grid(table, &term->normal);
+    composed_mark_grid(table, &term->alt);
+
+    if (term->interactive_resizing.grid != NULL)
+        composed_mark_grid(table, term->interactive_resizing.grid);
+    if (term->url_grid_snapshot != NULL)
+        composed_mark_grid(table, term->url_grid_snapshot);
+
+    /* Used by REP */
+    const char32_t last = term->vt.last_printed;
+    if (last >= CELL_COMB_CHARS_LO && last <= CELL_COMB_CHARS_HI)
+        composed_mark(table, last - CELL_COMB_CHARS_LO);
+
+    const size_t freed = composed_sweep(table);
+
+    LOG_DBG("composed characters: freed %zu, %zu remaining",
+            freed, table->count);
+    composed_log_statistics(table);
+}
+
 void
 term_print(struct terminal *term, char32_t wc, int width)
 {
@@ -3887,6 +4418,21 @@ term_print(struct terminal *term, char32_t wc, int width)
     grid->cursor.point.col = col;
 }
 
+/*
+ * Removes sixel data beneath the cells about to be printed. The row
+ * index makes this cheap enough to do in the fast ASCII printers,
+ * which therefore don't have to be disabled while there are images.
+ */
+static inline void
+print_sixel_overwrite(struct terminal *term, int col, int width)
+{
+    const struct grid *grid = term->grid;
+    const int row = grid->cursor.point.row;
+
+    if (unlikely(grid_sixel_row(grid, grid_row_absolute(grid, row))))
+        sixel_overwrite_by_row(term, row, col, width);
+}
+
 static void
 ascii_printer_generic(struct terminal *term, char32_t wc)
 {
@@ -3900,7 +4446,6 @@ ascii_printer_fast(struct terminal *term, char32_t wc)
 
     xassert(term->charsets.set[term->charsets.selected] == CHARSET_ASCII);
     xassert(!term->insert_mode);
-    xassert(tll_length(grid->sixel_images) == 0);
 
     print_linewrap(term);
 
@@ -3908,6 +4453,8 @@ ascii_printer_fast(struct terminal *term, char32_t wc)
     int col = grid->cursor.point.col;
     const int uri_start = col;
 
+    print_sixel_overwrite(term, col, 1);
+
     struct row *row = grid->cur_row;
     row->dirty = true;
     row->linebreak = true;
@@ -3932,6 +4479,84 @@ ascii_printer_fast(struct terminal *term, char32_t wc)
     }
 }
 
+/*
+ * Prints a run of printable ASCII characters (0x20-0x7e).
+ *
+ * Equivalent to calling term->ascii_printer() once per character,
+ * but when the fast ASCII printer is active, each row segment is
+ * written in one go, and URI/underline ranges are erased once per
+ * segment, instead of once per character.
+ */
+void
+term_print_ascii(struct terminal *term, const uint8_t *data, size_t len)
+{
+    xassert(len > 0);
+
+    /* The single-shift printer switches printer after one character */
+    while (len > 0 && term->ascii_printer != &ascii_printer_fast) {
+        term->ascii_printer(term, *data++);
+        len--;
+    }
+
+    if (len == 0)
+        return;
+
+    struct grid *grid = term->grid;
+
+    xassert(term->charsets.set[term->charsets.selected] == CHARSET_ASCII);
+    xassert(!term->insert_mode);
+
+    term->vt.last_printed = data[len - 1];
+
+    if (unlikely(grid->cursor.lcf && !term->auto_margin)) {
+        /* Every character overwrites the last column; only the last
+         * one is visible */
+        data += len - 1;
+        len = 1;
+    }
+
+    const struct attributes attrs = term->vt.attrs;
+
+    while (len > 0) {
+        print_linewrap(term);
+
+        /* *Must* get current cell *after* linewrap */
+        int col = grid->cursor.point.col;
+        const size_t count = min(len, (size_t)(term->cols - col));
+
+        print_sixel_overwrite(term, col, count);
+
+        struct row *row = grid->cur_row;
+        row->dirty = true;
+        row->linebreak = true;
+
+        struct cell *cell = &row->cells[col];
+        for (size_t i = 0; i < count; i++, cell++) {
+            cell->wc = data[i];
+            cell->attrs = attrs;
+        }
+
+        if (unlikely(row->extra != NULL)) {
+            grid_row_uri_range_erase(row, col, col + count - 1);
+            grid_row_underline_range_erase(row, col, col + count - 1);
+        }
+
+        /* Advance cursor */
+        col += count;
+        if (unlikely(col >= term->cols)) {
+            xassert(col == term->cols);
+            grid->cursor.lcf = true;
+            col--;
+        } else
+            xassert(!grid->cursor.lcf);
+
+        grid->cursor.point.col = col;
+
+        data += count;
+        len -= count;
+    }
+}
+
 static void
 ascii_printer_single_shift(struct terminal *term, char32_t wc)
 {
@@ -3998,25 +4623,49 @@ term_surface_kind(const struct terminal *term, const struct wl_surface *surface)
 }
 
 static bool
-rows_to_text(const struct terminal *term, int start, int end,
-             int col_start, int col_end, char **text, size_t *len)
+extract_rows(const struct terminal *term, struct extraction_context *ctx,
+             int start, int end, int col_start, int col_end)
 {
-    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
-    if (ctx == NULL)
-        return false;
-
     const int grid_rows = term->grid->num_rows;
+    const int cols = term->grid->num_cols;
     int r = start;
 
+    /*
+     * Packed (cold scrollback) rows are decoded into scratch rows,
+     * rather than unpacked; extracting the whole scrollback would
+     * otherwise undo all compression. Two scratch rows are needed,
+     * since the extraction context compares consecutive rows (see
+     * extract_spilled_row()).
+     */
+    struct row scratch[2] = {{.cells = NULL}};
+    struct cell *scratch_cells = NULL;
+    size_t scratch_count = 0;
+    bool ret = true;
+
     while (true) {
         const struct row *row = term->grid->rows[r];
         xassert(row != NULL);
 
+        if (row->packed != NULL) {
+            if (scratch_cells == NULL)
+                scratch_cells = xmalloc(2 * cols * sizeof(scratch_cells[0]));
+
+            const size_t idx = scratch_count++ & 1;
+            struct row *tmp = &scratch[idx];
+
+            tmp->cells = &scratch_cells[idx * cols];
+            tmp->linebreak = row->linebreak;
+            grid_row_unpack_into(row, tmp->cells, cols);
+            row = tmp;
+        }
+
         const int c_end = r == end ? col_end : term->cols;
 
         for (int c = col_start; c < c_end; c++) {
-            if (!extract_one(term, row, &row->cells[c], c, ctx))
+            if (!extract_one(term, row, &row->cells[c], c, ctx)) {
+                ret = false;
                 goto out;
+            }
         }
 
         if (r == end)
@@ -4029,9 +4678,66 @@ rows_to_text(const struct terminal *term, int start, int end,
     }
 
 out:
+    free(scratch_cells);
+    return ret;
+}
+
+static bool
+rows_to_text(const struct terminal *term, int start, int end,
+             int col_start, int col_end, char **text, size_t *len)
+{
+    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
+    if (ctx == NULL)
+        return false;
+
+    extract_rows(term, ctx, start, end, col_start, col_end);
     return extract_finish(ctx, text, len);
 }
 
+struct spill_extraction {
+    const struct terminal *term;
+    struct extraction_context *ctx;
+
+    /*
+     * The extraction context remembers the last row, and looks at its
+     * linebreak flag when the next row begins. Thus, consecutive rows
+     * must be distinct, and outlive the callback.
+     */
+    struct row rows[2];
+    size_t count;
+};
+
+static bool
+extract_spilled_row(const struct cell *cells, int cols, bool linebreak,
+                    const struct composed *composed, void *data)
+{
+    struct spill_extraction *x = data;
+    struct row *row = &x->rows[x->count++ & 1];
+
+    row->cells = (struct cell *)cells;
+    row->linebreak = linebreak;
+
+    bool ret = true;
+    for (int c = 0; c < cols; c++) {
+        const char32_t wc = cells[c].wc;
+
+        /* Spilled composed characters aren't in term->composed */
+        const struct composed *comp =
+            wc >= CELL_COMB_CHARS_LO && wc <= CELL_COMB_CHARS_HI
+                ? &composed[wc - CELL_COMB_CHARS_LO]
+                : NULL;
+
+        if (!extract_one_composed(x->term, row, &cells[c], c, comp, x->ctx)) {
+            ret = false;
+            break;
+        }
+    }
+
+    /* 'cells' is only valid during the callback */
+    row->cells = NULL;
+    return ret;
+}
+
 bool
 term_scrollback_to_text(const struct terminal *term, char **text, size_t *len)
 {
@@ -4057,7 +4763,21 @@ term_scrollback_to_text(const struct terminal *term, char **text, size_t *len)
             end += term->grid->num_rows;
     }
 
-    return rows_to_text(term, start, end, 0, term->cols, text, len);
+    struct extraction_context *ctx = extract_begin(SELECTION_NONE, true);
+    if (ctx == NULL)
+        return false;
+
+    /* Rows evicted from the scrollback come first */
+    struct spill_extraction spilled = {.term = term, .ctx = ctx};
+
+    if (term->scrollback_spill != NULL && term->grid == &term->normal) {
+        scrollback_spill_for_each(
+            term->scrollback_spill, &extract_spilled_row, &spilled);
+    }
+
+    extract_rows(term, ctx, start, end, 0, term->cols);
+
+    return extract_finish(ctx, text, len);
 }
 
 bool
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -155,12 +156,21 @@ struct row_data {
 };
 
 struct row {
-    struct cell *cells;
+    struct cell *cells;         /* NULL when packed */
     struct row_data *extra;
+    struct row_packed *packed;  /* Cold scrollback; see grid_row_pack() */
 
     bool dirty;
     bool linebreak;
 
+    /*
+     * All cells are dirty, regardless of their 'clean' bit. Set when
+     * damaging whole rows, to avoid touching every cell; the renderer
+     * clears it (and the cells' clean bits are then stale, but
+     * overwritten as the cells are rendered).
+     */
+    bool all_dirty;
+
     struct {
         bool prompt_marker;
         int cmd_start;  /* Column, -1 if unset */
@@ -226,6 +236,16 @@ enum kitty_kbd_flags {
                            KITTY_KBD_REPORT_ASSOCIATED),
 };
 
+/*
+ * Scrollback rows that have not yet been reflowed, after a resize; see
+ * grid_resize_and_reflow() and grid_reflow_pending()
+ */
+struct grid_reflow_segment {
+    struct row **rows;  /* Oldest first */
+    int count;
+    int cols;           /* Width of the rows; i.e. the grid's width before the resize */
+};
+
 struct grid {
     int num_rows;
     int num_cols;
@@ -249,6 +269,16 @@ struct grid {
     tll(struct damage) scroll_damage;
     tll(struct sixel) sixel_images;
 
+    /*
+     * Bitmap of the (absolute) rows covered by 'sixel_images'. May
+     * include rows whose images have since been removed. NULL when
+     * not yet built, or invalidated; see grid_sixel_row().
+     */
+    uint64_t *sixel_rows;
+
+    /* Older than the oldest row in 'rows'. Newest segment last */
+    tll(struct grid_reflow_segment) reflow_pending;
+
     struct {
         enum kitty_kbd_flags flags[8];
         uint8_t idx;
@@ -407,6 +437,13 @@ struct colors {
     bool use_custom_selection;
 };
 
+/* Input-to-photon latency of a single key press, in µs */
+struct latency_sample {
+    uint32_t echo;       /* Key press -> first PTY data read */
+    uint32_t commit;     /* First PTY data -> frame committed */
+    uint32_t presented;  /* Frame committed -> frame presented */
+};
+
 struct terminal {
     struct fdm *fdm;
     struct reaper *reaper;
@@ -415,7 +452,6 @@ struct terminal {
     void (*ascii_printer)(struct terminal *term, char32_t c);
     union {
         struct {
-            bool sixels:1;
             bool osc8:1;
             bool underline_style:1;
             bool underline_color:1;
@@ -428,11 +464,29 @@ struct terminal {
     pid_t slave;
     int ptmx;
 
+    /* PTY reader thread; NULL unless tweak.pty-reader-thread is enabled */
+    struct ptmx_reader *ptmx_reader;
+
+    /* NULL unless tweak.pty-record is set */
+    struct pty_recorder *pty_recorder;
+    bool ptmx_unregistered;  /* ptmx removed from FDM after hangup */
+
+    /* PTY parse slice scheduling (tweak.pty-parse-budget) */
+    struct {
+        uint64_t ns_per_kib;       /* Parse cost, moving average */
+        uint64_t budget_ns;        /* Budget of the last slice */
+        uint64_t bytes;            /* Parsed since the last frame */
+        uint64_t bytes_per_frame;  /* Parsed during the last frame */
+    } ptmx_sched;
+
     struct vt vt;
     struct grid *grid;
     struct grid normal;
     struct grid alt;
 
+    /* Rows evicted from the normal grid's scrollback; may be NULL */
+    struct scrollback_spill *scrollback_spill;
+
     int cols;   /* number of columns */
     int rows;   /* number of rows */
     struct scroll_region scroll_region;
@@ -458,8 +512,7 @@ struct terminal {
 
     tll(int) tab_stops;
 
-    size_t composed_count;
-    struct composed *composed;
+    struct composed_table composed;
 
     /* Temporary: for FDM */
     struct {
@@ -500,6 +553,16 @@ struct terminal {
             (GLYPH_LEGACY_LAST - GLYPH_LEGACY_FIRST + 1)
     } custom_glyphs;
 
+    /*
+     * Glyphs for code points below GLYPH_DIRECT_COUNT (Latin, IPA,
+     * spacing modifiers and combining diacritics), per font (indexed
+     * like 'fonts'). Filled lazily by the render threads, and read
+     * without locking. Reset whenever the fonts, or the subpixel mode,
+     * changes.
+     */
+    #define GLYPH_DIRECT_COUNT 0x370
+    _Atomic(const struct fcft_glyph *) direct_glyphs[4][GLYPH_DIRECT_COUNT];
+
     bool is_sending_paste_data;
     ptmx_buffer_list_t ptmx_buffers;
     ptmx_buffer_list_t ptmx_paste_buffers;
@@ -564,6 +627,9 @@ struct terminal {
         int fd;
     } blink;
 
+    /* Lazy reflow of old scrollback; see term_reflow_pending_schedule() */
+    int reflow_pending_fd;
+
     float scale;
     float scale_before_unmap;  /* Last scaling factor used */
     int width;  /* pixels */
@@ -682,15 +748,11 @@ struct terminal {
             int timer_fd;
         } app_sync_updates;
 
-        /* Render threads + synchronization primitives */
+        /* Render threads; these are shared by all terminals, see render.c */
         struct {
             uint16_t count;
-            sem_t start;
-            sem_t done;
-            mtx_t lock;
-            tll(int) queue;
-            thrd_t *threads;
-            struct buffer *buf;
+            bool pool_ref;  /* True if we hold a render pool reference */
+            mtx_t lock;     /* For state shared by all threads (e.g. glyph caches) */
         } workers;
 
         /* Last rendered cursor position */
@@ -702,6 +764,9 @@ struct terminal {
 
         struct buffer *last_buf;     /* Buffer we rendered to last time */
 
+        /* Pre-rendered cells; see glyph-tiles.h */
+        struct glyph_tile_cache *glyph_tiles;
+
         enum overlay_style last_overlay_style;
         struct buffer *last_overlay_buf;
         pixman_region32_t last_overlay_clip;
@@ -709,6 +774,30 @@ struct terminal {
         size_t search_glyph_offset;
 
         struct timespec input_time;
+
+        /*
+         * Key press latency tracing; see render_latency_key_pressed().
+         * Timestamps are in the presentation clock.
+         */
+        struct {
+            bool tracing;            /* Waiting for 'input's echo */
+            bool echoed;             /* Echo received; waiting for a frame */
+            struct timespec input;   /* Key press */
+            struct timespec echo;    /* First PTY data after the key press */
+
+            struct latency_sample *samples;  /* Ring buffer */
+            size_t count;            /* Total number of samples */
+            size_t discarded;        /* Traced frames never presented */
+        } latency;
+
+        /* From presentation feedback; used to predict the next vblank */
+        struct {
+            struct timespec last_presented;  /* CLOCK_MONOTONIC */
+            uint32_t refresh_ns;             /* 0 if unknown */
+            uint64_t render_ns;              /* grid_render(), moving average */
+        } frame_timing;
+
+        tll(struct wp_presentation_feedback *) presentation_feedbacks;
     } render;
 
     struct {
@@ -742,8 +831,19 @@ struct terminal {
             int height;      /* Image height, in pixels */
             int alloc_height;
             unsigned int bottom_pixel;
+            int done_height; /* Completed rows, shown while decoding */
         } image;
 
+        /*
+         * The current band (6 pixel rows) of a 1:1 image, column
+         * major. Expanded into 'image' at the end of the band.
+         */
+        struct {
+            uint32_t *data;  /* SIXEL_BAND_STRIDE pixels per column */
+            int width;       /* Allocated columns */
+            int cols;        /* Columns touched, before the last CR */
+        } band;
+
         /*
          * Pan is the vertical shape of a pixel
          * Pad is the horizontal shape of a pixel
@@ -882,6 +982,13 @@ void term_cursor_down(struct terminal *term, int count);
 void term_cursor_blink_update(struct terminal *term);
 
 void term_print(struct terminal *term, char32_t wc, int width);
+void term_composed_gc(struct terminal *term);
+void term_pack_cold_scrollback(struct terminal *term);
+
+void term_reflow_pending_schedule(struct terminal *term);
+int term_reflow_pending(struct terminal *term, int max_rows);
+void term_reflow_pending_finish(struct terminal *term);
+void term_print_ascii(struct terminal *term, const uint8_t *data, size_t len);
 void term_fill(struct terminal *term, int row, int col, uint8_t c, size_t count,
                bool use_sgr_attrs);
 
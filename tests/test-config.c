@@ -598,6 +598,8 @@ test_section_scrollback(void)
     test_uint32(&ctx, &parse_section_scrollback, "lines",
                 &conf.scrollback.lines);
     test_float(&ctx, parse_section_scrollback, "multiplier", &conf.scrollback.multiplier);
+    test_boolean(&ctx, &parse_section_scrollback, "spill",
+                 &conf.scrollback.spill);
 
     test_enum(
         &ctx, &parse_section_scrollback, "indicator-position",
@@ -1367,6 +1369,23 @@ test_section_tweak(void)
     test_uint32(&ctx, &parse_section_tweak, "delayed-render-upper",
                 &conf.tweak.delayed_render_upper_ns);
 #endif
+
+    /* Must not exceed one frame interval at 60Hz */
+    ctx.key = "pty-parse-budget";
+    ctx.value = "0";
+    xassert(parse_section_tweak(&ctx));
+    xassert(conf.tweak.pty_parse_budget_ns == 0);
+    ctx.value = "4000000";
+    xassert(parse_section_tweak(&ctx));
+    xassert(conf.tweak.pty_parse_budget_ns == 4000000);
+    ctx.value = "16666666";
+    xassert(parse_section_tweak(&ctx));
+    xassert(conf.tweak.pty_parse_budget_ns == 16666666);
+    ctx.value = "16666667";
+    xassert(!parse_section_tweak(&ctx));
+    ctx.value = "abc";
+    xassert(!parse_section_tweak(&ctx));
+
     test_boolean(&ctx, &parse_section_tweak, "damage-whole-window",
                  &conf.tweak.damage_whole_window);
 
@@ -1389,6 +1408,15 @@ test_section_tweak(void)
     test_boolean(&ctx, &parse_section_tweak, "font-monospace-warn",
                  &conf.tweak.font_monospace_warn);
 
+    test_boolean(&ctx, &parse_section_tweak, "pty-reader-thread",
+                 &conf.tweak.pty_reader_thread);
+
+    test_uint32(&ctx, &parse_section_tweak, "scrollback-compress-after",
+                &conf.tweak.scrollback_compress_after);
+
+    test_string(&ctx, &parse_section_tweak, "pty-record",
+                &conf.tweak.pty_record);
+
     test_float(&ctx, &parse_section_tweak, "bold-text-in-bright-amount",
                &conf.bold_in_bright.amount);
 
@@ -301,7 +301,7 @@ auto_detected(const struct terminal *term, enum url_action action,
 
             if (cell->wc >= CELL_COMB_CHARS_LO && cell->wc <= CELL_COMB_CHARS_HI) {
                 struct composed *composed =
-                    composed_lookup(term->composed, cell->wc - CELL_COMB_CHARS_LO);
+                    composed_lookup(&term->composed, cell->wc - CELL_COMB_CHARS_LO);
                 wcs = composed->chars;
                 wc_count = composed->count;
             } else {
@@ -745,7 +745,7 @@ tag_cells_for_url(struct terminal *term, const struct url *url, bool value)
     size_t r = start->row & (grid->num_rows - 1);
     size_t c = start->col;
 
-    struct row *row = grid->rows[r];
+    struct row *row = grid_row_unpacked(grid->rows[r]);
     row->dirty = true;
 
     while (true) {
@@ -760,7 +760,7 @@ tag_cells_for_url(struct terminal *term, const struct url *url, bool value)
             r = (r + 1) & (grid->num_rows - 1);
             c = 0;
 
-            row = grid->rows[r];
+            row = grid_row_unpacked(grid->rows[r]);
             if (row == NULL) {
                 /* Un-allocated scrollback. This most likely means a
                  * runaway OSC-8 URL. */
@@ -788,7 +788,9 @@ urls_render(struct terminal *term)
     /* Dirty the last cursor, to ensure it is erased */
     {
         struct row *cursor_row = term->render.last_cursor.row;
-        if (cursor_row != NULL) {
+
+        /* Packed rows are fully re-rendered when unpacked */
+        if (cursor_row != NULL && cursor_row->packed == NULL) {
             struct cell *cell = &cursor_row->cells[term->render.last_cursor.col];
             cell->attrs.clean = 0;
             cursor_row->dirty = true;
@@ -4,6 +4,12 @@
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+ #include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
 #if defined(FOOT_GRAPHEME_CLUSTERING)
  #include <libutf8proc/utf8proc.h>
 #endif
@@ -298,6 +304,77 @@ action_print(struct terminal *term, uint8_t c)
     term->ascii_printer(term, c);
 }
 
+static void
+action_print_ascii(struct terminal *term, const uint8_t *data, size_t len)
+{
+    term_reset_grapheme_state(term);
+    term_print_ascii(term, data, len);
+}
+
+/*
+ * Returns the number of leading bytes in 'data' that are printable
+ * ASCII (0x20-0x7e), i.e. bytes that, in the ground state, would all
+ * be handled by action_print().
+ */
+static inline size_t
+printable_ascii_run(const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i lo32 = _mm256_set1_epi8(0x20);
+    const __m256i hi32 = _mm256_set1_epi8(0x7e);
+
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+
+        /* Signed compares; bytes >= 0x80 are negative, and thus < 0x20 */
+        const __m256i non_printable = _mm256_or_si256(
+            _mm256_cmpgt_epi8(lo32, v), _mm256_cmpgt_epi8(v, hi32));
+
+        const uint32_t mask = _mm256_movemask_epi8(non_printable);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i lo16 = _mm_set1_epi8(0x20);
+    const __m128i hi16 = _mm_set1_epi8(0x7e);
+
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+
+        /* Signed compares; bytes >= 0x80 are negative, and thus < 0x20 */
+        const __m128i non_printable = _mm_or_si128(
+            _mm_cmplt_epi8(v, lo16), _mm_cmpgt_epi8(v, hi16));
+
+        const uint32_t mask = _mm_movemask_epi8(non_printable);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16_t lo16 = vdupq_n_u8(0x20);
+    const uint8x16_t hi16 = vdupq_n_u8(0x7e);
+
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8(&data[i]);
+        const uint8x16_t non_printable = vorrq_u8(
+            vcltq_u8(v, lo16), vcgtq_u8(v, hi16));
+
+        if (vmaxvq_u8(non_printable) != 0)
+            break;  /* Let the scalar loop find the exact position */
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (data[i] < 0x20 || data[i] > 0x7e)
+            break;
+    }
+
+    return i;
+}
+
 static void
 action_param_lazy_init(struct terminal *term)
 {
@@ -699,10 +776,35 @@ UNITTEST
 }
 #endif
 
+/*
+ * wcwidth() is comparatively expensive (it goes through the locale),
+ * and is called for every printed non-ASCII character. Cache the
+ * result for the BMP. The locale is never changed after startup, so
+ * the cache never has to be invalidated.
+ *
+ * Entries are stored as 'width + 2', with 0 meaning "not yet
+ * classified".
+ */
+static uint8_t bmp_width_cache[0x10000];
+
+static inline int
+utf32_width(char32_t wc)
+{
+    if (unlikely(wc > 0xffff))
+        return c32width(wc);
+
+    uint8_t width = bmp_width_cache[wc];
+    if (unlikely(width == 0)) {
+        width = c32width(wc) + 2;
+        bmp_width_cache[wc] = width;
+    }
+
+    return (int)width - 2;
+}
+
 static void
-action_utf8_print(struct terminal *term, char32_t wc)
+action_utf8_print(struct terminal *term, char32_t wc, int width)
 {
-    int width = c32width(wc);
     const bool grapheme_clustering = term->grapheme_shaping;
 
 #if !defined(FOOT_GRAPHEME_CLUSTERING)
@@ -729,7 +831,7 @@ action_utf8_print(struct terminal *term, char32_t wc)
         /* Is base cell already a cluster? */
         const struct composed *composed =
             (base >= CELL_COMB_CHARS_LO && base <= CELL_COMB_CHARS_HI)
-            ? composed_lookup(term->composed, base - CELL_COMB_CHARS_LO)
+            ? composed_lookup(&term->composed, base - CELL_COMB_CHARS_LO)
             : NULL;
 
         uint32_t key;
@@ -810,6 +912,7 @@ action_utf8_print(struct terminal *term, char32_t wc)
             xassert(wanted_count <= 255);
 
             size_t collision_count = 0;
+            term->composed.lookups++;
 
             /* Look for existing combining chain */
             while (true) {
@@ -823,7 +926,7 @@ action_utf8_print(struct terminal *term, char32_t wc)
                     return;
                 }
 
-                const struct composed *cc = composed_lookup(term->composed, key);
+                const struct composed *cc = composed_lookup(&term->composed, key);
                 if (cc == NULL)
                     break;
 
@@ -858,12 +961,17 @@ action_utf8_print(struct terminal *term, char32_t wc)
                     continue;
                 }
 
+                term->composed.hits++;
                 wc = CELL_COMB_CHARS_LO + cc->key;
                 width = cc->width;
                 goto out;
             }
 
-            if (unlikely(term->composed_count >=
+            /* Free chains no longer referenced by any cell */
+            if (unlikely(term->composed.count >= term->composed.gc_threshold))
+                term_composed_gc(term);
+
+            if (unlikely(term->composed.count >=
                          (CELL_COMB_CHARS_HI - CELL_COMB_CHARS_LO)))
             {
                 /* We reached our maximum number of allowed composed
@@ -934,7 +1042,6 @@ action_utf8_print(struct terminal *term, char32_t wc)
                 break;
             }
 
-            term->composed_count++;
             composed_insert(&term->composed, new_cc);
 
             wc = CELL_COMB_CHARS_LO + key;
@@ -965,7 +1072,7 @@ action_utf8_22(struct terminal *term, uint8_t c)
 {
     // wc = ((utf8[0] & 0x1f) << 6) | (utf8[1] & 0x3f)
     term->vt.utf8 |= c & 0x3f;
-    action_utf8_print(term, term->vt.utf8);
+    action_utf8_print(term, term->vt.utf8, utf32_width(term->vt.utf8));
 }
 
 static void
@@ -997,7 +1104,7 @@ action_utf8_33(struct terminal *term, uint8_t c)
     /* Note: the E0 range contains overlong encodings. We don't try to
        detect, as they'll still decode to valid UTF-32. */
 
-    action_utf8_print(term, term->vt.utf8);
+    action_utf8_print(term, utf32, utf32_width(utf32));
 }
 
 static void
@@ -1037,7 +1144,215 @@ action_utf8_44(struct terminal *term, uint8_t c)
     /* Note: the F0 range contains overlong encodings. We don't try to
        detect, as they'll still decode to valid UTF-32. */
 
-    action_utf8_print(term, term->vt.utf8);
+    action_utf8_print(term, utf32, utf32_width(utf32));
+}
+
+/*
+ * Returns the number of leading bytes in 'data' that have their most
+ * significant bit set, i.e. that are part of multi-byte UTF-8
+ * sequences (or are invalid UTF-8).
+ */
+static inline size_t
+non_ascii_run(const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+        const uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(v);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+        const uint32_t mask = ~(uint32_t)_mm_movemask_epi8(v) & 0xffff;
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8(&data[i]);
+        if (vminvq_u8(v) < 0x80)
+            break;  /* Let the scalar loop find the exact position */
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (data[i] < 0x80)
+            break;
+    }
+
+    return i;
+}
+
+/*
+ * Decodes a block of complete, well-formed, multi-byte UTF-8
+ * sequences into 'out'.
+ *
+ * Stops at the first byte that doesn't start a multi-byte sequence
+ * (i.e. ASCII and control characters), at malformed sequences
+ * (overlong encodings, surrogates, out-of-range code points), and at
+ * sequences truncated by the end of the buffer. These are all left to
+ * the state machine.
+ *
+ * Returns the number of decoded code points. '*consumed' is set to
+ * the number of bytes they were decoded from.
+ */
+static size_t
+utf8_decode_block(const uint8_t *data, size_t len,
+                  char32_t *out, size_t out_size, size_t *consumed)
+{
+    /* All bytes up to 'limit' have bit 7 set; continuation bytes are
+     * thus identified by bit 6 being clear */
+    const size_t limit = non_ascii_run(data, len);
+
+    size_t i = 0;
+    size_t count = 0;
+
+    while (count < out_size && i < limit) {
+        const uint8_t b0 = data[i];
+        char32_t wc;
+
+        if (b0 >= 0xc2 && b0 <= 0xdf) {
+            if (i + 2 > limit)
+                break;
+
+            const uint8_t b1 = data[i + 1];
+            if ((b1 & 0x40) != 0)
+                break;
+
+            wc = (b0 & 0x1f) << 6 | (b1 & 0x3f);
+            i += 2;
+        }
+
+        else if (b0 >= 0xe0 && b0 <= 0xef) {
+            if (i + 3 > limit)
+                break;
+
+            const uint8_t b1 = data[i + 1];
+            const uint8_t b2 = data[i + 2];
+            if (((b1 | b2) & 0x40) != 0)
+                break;
+
+            wc = (b0 & 0x0f) << 12 | (b1 & 0x3f) << 6 | (b2 & 0x3f);
+            if (wc < 0x800 || (wc >= 0xd800 && wc <= 0xdfff))
+                break;
+
+            i += 3;
+        }
+
+        else if (b0 >= 0xf0 && b0 <= 0xf4) {
+            if (i + 4 > limit)
+                break;
+
+            const uint8_t b1 = data[i + 1];
+            const uint8_t b2 = data[i + 2];
+            const uint8_t b3 = data[i + 3];
+            if (((b1 | b2 | b3) & 0x40) != 0)
+                break;
+
+            wc = (b0 & 0x07) << 18 | (b1 & 0x3f) << 12 |
+                 (b2 & 0x3f) << 6 | (b3 & 0x3f);
+            if (wc < 0x10000 || wc > 0x10ffff)
+                break;
+
+            i += 4;
+        }
+
+        else
+            break;
+
+        out[count++] = wc;
+    }
+
+    *consumed = i;
+    return count;
+}
+
+/*
+ * Prints as many complete, well-formed, multi-byte UTF-8 sequences
+ * as possible from 'data', without going through the per-byte UTF-8
+ * states. Returns the number of bytes consumed; 0 if the state
+ * machine needs to handle the first byte.
+ */
+static size_t
+action_utf8_print_block(struct terminal *term, const uint8_t *data, size_t len)
+{
+    char32_t wcs[128];
+    int8_t widths[128];
+
+    size_t total = 0;
+
+    while (total < len) {
+        size_t consumed;
+        const size_t count = utf8_decode_block(
+            &data[total], len - total, wcs, ALEN(wcs), &consumed);
+
+        if (count == 0)
+            break;
+
+        for (size_t i = 0; i < count; i++)
+            widths[i] = utf32_width(wcs[i]);
+
+        for (size_t i = 0; i < count; i++)
+            action_utf8_print(term, wcs[i], widths[i]);
+
+        total += consumed;
+
+        if (count < ALEN(wcs))
+            break;
+    }
+
+    return total;
+}
+
+UNITTEST
+{
+    char32_t wcs[8];
+    size_t consumed;
+
+    /* 'å', 'ä', '日', '本', '😀', then ASCII */
+    const uint8_t mixed[] =
+        "\xc3\xa5\xc3\xa4\xe6\x97\xa5\xe6\x9c\xac\xf0\x9f\x98\x80" "abc";
+    xassert(utf8_decode_block(
+                mixed, sizeof(mixed) - 1, wcs, ALEN(wcs), &consumed) == 5);
+    xassert(consumed == 14);
+    xassert(wcs[0] == U'å');
+    xassert(wcs[1] == U'ä');
+    xassert(wcs[2] == U'日');
+    xassert(wcs[3] == U'本');
+    xassert(wcs[4] == U'😀');
+
+    /* Truncated sequence at the end of the buffer */
+    const uint8_t truncated[] = "\xe6\x97\xa5\xe6\x9c";
+    xassert(utf8_decode_block(
+                truncated, sizeof(truncated) - 1, wcs, ALEN(wcs), &consumed) == 1);
+    xassert(consumed == 3);
+
+    /* Surrogate, overlong and out-of-range sequences are left to the
+     * state machine */
+    const uint8_t surrogate[] = "\xed\xa0\x80";
+    xassert(utf8_decode_block(
+                surrogate, sizeof(surrogate) - 1, wcs, ALEN(wcs), &consumed) == 0);
+    xassert(consumed == 0);
+
+    const uint8_t overlong[] = "\xe0\x80\xaf";
+    xassert(utf8_decode_block(
+                overlong, sizeof(overlong) - 1, wcs, ALEN(wcs), &consumed) == 0);
+
+    const uint8_t too_large[] = "\xf4\x90\x80\x80";
+    xassert(utf8_decode_block(
+                too_large, sizeof(too_large) - 1, wcs, ALEN(wcs), &consumed) == 0);
+
+    /* Output buffer limit */
+    const uint8_t many[] = "\xc3\xa5\xc3\xa5\xc3\xa5";
+    xassert(utf8_decode_block(
+                many, sizeof(many) - 1, wcs, 2, &consumed) == 2);
+    xassert(consumed == 4);
 }
 
 IGNORE_WARNING("-Wpedantic")
@@ -1406,7 +1721,32 @@ vt_from_slave(struct terminal *term, const uint8_t *data, size_t len)
     const uint8_t *p = data;
     for (size_t i = 0; i < len; i++, p++) {
         switch (current_state) {
-        case STATE_GROUND:              current_state = state_ground_switch(term, *p); break;
+        case STATE_GROUND: {
+            /* Fast path: bulk print runs of printable ASCII */
+            const size_t count = printable_ascii_run(p, len - i);
+            if (count > 0) {
+                action_print_ascii(term, p, count);
+                i += count - 1;
+                p += count - 1;
+                break;
+            }
+
+            /* Fast path: block decode multi-byte UTF-8 sequences */
+            if (*p >= 0xc2 && *p <= 0xf4) {
+                const size_t consumed =
+                    action_utf8_print_block(term, p, len - i);
+
+                if (consumed > 0) {
+                    i += consumed - 1;
+                    p += consumed - 1;
+                    break;
+                }
+            }
+
+            current_state = state_ground_switch(term, *p);
+            break;
+        }
+
         case STATE_ESCAPE:              current_state = state_escape_switch(term, *p); break;
         case STATE_ESCAPE_INTERMEDIATE: current_state = state_escape_intermediate_switch(term, *p); break;
         case STATE_CSI_ENTRY:           current_state = state_csi_entry_switch(term, *p); break;